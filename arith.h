@@ -0,0 +1,129 @@
+#pragma once
+
+#include <climits>
+#include <cstdint>
+
+#include "types_decl.h"
+
+namespace cplr {
+
+	// paraCL integers are 32-bit two's complement values which wrap around on
+	// overflow; every execution engine goes through these helpers so that they
+	// all agree on the result
+
+	inline int wrap_add(int lhs, int rhs) {
+		return static_cast<int>(
+			static_cast<unsigned>(lhs) + static_cast<unsigned>(rhs)
+		);
+	}
+
+	inline int wrap_sub(int lhs, int rhs) {
+		return static_cast<int>(
+			static_cast<unsigned>(lhs) - static_cast<unsigned>(rhs)
+		);
+	}
+
+	inline int wrap_mul(int lhs, int rhs) {
+		return static_cast<int>(
+			static_cast<unsigned>(lhs) * static_cast<unsigned>(rhs)
+		);
+	}
+
+	inline int wrap_neg(int rhs) {
+		return static_cast<int>(0u - static_cast<unsigned>(rhs));
+	}
+
+	inline int wrap_div(int lhs, int rhs) { // rhs != 0
+		return (lhs == INT_MIN && rhs == -1) ? INT_MIN : lhs / rhs;
+	}
+
+	inline int wrap_rem(int lhs, int rhs) { // rhs != 0
+		return rhs == -1 ? 0 : lhs % rhs;
+	}
+
+	// division by a constant d, |d| >= 2, done by a multiplication by a magic
+	// number taking the high half and shifts, see Hacker's Delight 10-1
+	struct divisor {
+		int d;
+		int32_t magic;
+		int shift;
+	};
+
+	inline divisor make_divisor(int d) {
+		const uint32_t two31 = 0x80000000u;
+		uint32_t ad = d < 0 ? 0u - static_cast<uint32_t>(d) : d;
+		uint32_t t = two31 + (static_cast<uint32_t>(d) >> 31);
+		uint32_t anc = t - 1 - t % ad; // absolute value of nc
+		int p = 31;
+		uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+		uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+		uint32_t delta;
+		do {
+			++p;
+			q1 *= 2;
+			r1 *= 2;
+			if (r1 >= anc) {
+				++q1;
+				r1 -= anc;
+			}
+			q2 *= 2;
+			r2 *= 2;
+			if (r2 >= ad) {
+				++q2;
+				r2 -= ad;
+			}
+			delta = ad - r2;
+		} while (q1 < delta || (q1 == delta && r1 == 0));
+		uint32_t magic = q2 + 1;
+		if (d < 0) {
+			magic = 0u - magic;
+		}
+		return {d, static_cast<int32_t>(magic), p - 32};
+	}
+
+	inline int div_by(const divisor& dv, int lhs) {
+		int32_t q = static_cast<int32_t>(
+			(static_cast<int64_t>(dv.magic) * lhs) >> 32
+		);
+		if (dv.d > 0 && dv.magic < 0) {
+			q = wrap_add(q, lhs);
+		} else if (dv.d < 0 && dv.magic > 0) {
+			q = wrap_sub(q, lhs);
+		}
+		q >>= dv.shift;
+		return q + static_cast<int32_t>(static_cast<uint32_t>(q) >> 31);
+	}
+
+	inline int rem_by(const divisor& dv, int lhs) {
+		return wrap_sub(lhs, wrap_mul(div_by(dv, lhs), dv.d));
+	}
+
+	inline int arith_unary(unOp_t op, int rhs) {
+		if (op == unOp_t::LOGICAL_NEGATION) {
+			return !rhs;
+		}
+		return wrap_neg(rhs);
+	}
+
+	// op is neither ASSIGNMENT nor a short-circuit one, division and remainder
+	// expect rhs != 0
+	inline int arith_binary(binOp_t op, int lhs, int rhs) {
+		switch (op) {
+			case binOp_t::OR: return lhs || rhs;
+			case binOp_t::AND: return lhs && rhs;
+			case binOp_t::EQUAL: return lhs == rhs;
+			case binOp_t::NOT_EQUAL: return lhs != rhs;
+			case binOp_t::LESS: return lhs < rhs;
+			case binOp_t::LESS_OR_EQUAL: return lhs <= rhs;
+			case binOp_t::GREATER_OR_EQUAL: return lhs >= rhs;
+			case binOp_t::GREATER: return lhs > rhs;
+			case binOp_t::ADDITION: return wrap_add(lhs, rhs);
+			case binOp_t::SUBSTRACTION: return wrap_sub(lhs, rhs);
+			case binOp_t::MULTIPLICATION: return wrap_mul(lhs, rhs);
+			case binOp_t::DIVISION: return wrap_div(lhs, rhs);
+			case binOp_t::REMAINDER: return wrap_rem(lhs, rhs);
+			default: return 0;
+		}
+	}
+
+}
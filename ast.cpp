@@ -0,0 +1,399 @@
+#include "ast.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cplr {
+
+	ast::ast()
+	: root_(0)
+	, frame_size_(0)
+	{
+		clear();
+	}
+
+	void ast::clear() {
+		nodes_.clear();
+		lists_.clear();
+		divisors_.clear();
+		frame_size_ = 0;
+		root_ = make_empty();
+	}
+
+	void ast::drop_nodes() {
+		nodes_.clear();
+		lists_.clear();
+		divisors_.clear();
+		root_ = make_empty();
+	}
+
+	size_t ast::size() const {
+		return nodes_.size();
+	}
+
+	const ast::node& ast::operator[](idx_t nd) const {
+		return nodes_[nd];
+	}
+
+	ast::node& ast::operator[](idx_t nd) {
+		return nodes_[nd];
+	}
+
+	ast::idx_t ast::root() const {
+		return root_;
+	}
+
+	void ast::set_root(idx_t nd) {
+		root_ = nd;
+	}
+
+	const ast::idx_t * ast::list(idx_t first) const {
+		return lists_.data() + first;
+	}
+
+	ast::idx_t * ast::list(idx_t first) {
+		return lists_.data() + first;
+	}
+
+	ast::idx_t ast::add(const node& nd) {
+		nodes_.push_back(nd);
+		return static_cast<idx_t>(nodes_.size() - 1);
+	}
+
+	ast::idx_t ast::make_empty() {
+		return make_leaf(node_t::EMPTY);
+	}
+
+	ast::idx_t ast::make_leaf(node_t type) {
+		node nd = {};
+		nd.type_ = type;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_id(size_t id) {
+		node nd = {};
+		nd.type_ = node_t::IDENTIFIER;
+		nd.op_ = static_cast<unsigned char>(bind_t::UNKNOWN);
+		nd.val_ = static_cast<int>(id);
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_int(int int_lit) {
+		node nd = {};
+		nd.type_ = node_t::INTEGER_LITERAL;
+		nd.val_ = int_lit;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_print(idx_t val) {
+		node nd = {};
+		nd.type_ = node_t::PRINT;
+		nd.rhs_ = val;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_unop(unOp_t op, idx_t rhs) {
+		node nd = {};
+		nd.type_ = node_t::UNARY_OPERATION;
+		nd.op_ = static_cast<unsigned char>(op);
+		nd.rhs_ = rhs;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_binop(binOp_t op, idx_t lhs, idx_t rhs) {
+		node nd = {};
+		nd.type_ = node_t::BINARY_OPERATION;
+		nd.op_ = static_cast<unsigned char>(op);
+		nd.lhs_ = lhs;
+		nd.rhs_ = rhs;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_if(idx_t cond, idx_t if_body, idx_t else_body) {
+		node nd = {};
+		nd.type_ = node_t::IF;
+		nd.cond_ = cond;
+		nd.body_ = if_body;
+		nd.else_ = else_body;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_while(node_t type, idx_t cond, idx_t body) {
+		node nd = {};
+		nd.type_ = type;
+		nd.cond_ = cond;
+		nd.body_ = body;
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_scope(const std::vector<idx_t>& stmts) {
+		node nd = {};
+		nd.type_ = node_t::SCOPE;
+		nd.first_ = static_cast<idx_t>(lists_.size());
+		nd.count_ = static_cast<idx_t>(stmts.size());
+		lists_.insert(lists_.end(), stmts.begin(), stmts.end());
+		return add(nd);
+	}
+
+	ast::idx_t ast::make_copy(idx_t nd) {
+		node copy = nodes_[nd];
+		return add(copy);
+	}
+
+	// temporaries go after the identifiers, so they can't be made while more
+	// of the program is still to be resolved
+	ast::idx_t ast::make_temp() {
+		binds_.resize(frame_size_ + 1, bind_t::UNDEFINED);
+		return static_cast<idx_t>(frame_size_++);
+	}
+
+	void ast::set_scope(idx_t nd, const std::vector<idx_t>& stmts) {
+		node scope = {};
+		scope.type_ = node_t::SCOPE;
+		scope.first_ = static_cast<idx_t>(lists_.size());
+		scope.count_ = static_cast<idx_t>(stmts.size());
+		lists_.insert(lists_.end(), stmts.begin(), stmts.end());
+		nodes_[nd] = scope;
+	}
+
+	void ast::set_divisor(idx_t nd, int d) {
+		divisors_.push_back(make_divisor(d));
+		nodes_[nd].divisor_ = static_cast<idx_t>(divisors_.size());
+	}
+
+	const divisor& ast::divisor_of(idx_t nd) const {
+		return divisors_[nodes_[nd].divisor_ - 1];
+	}
+
+	// the nodes reachable from the root are copied in post-order, children
+	// before their parent in the order they are run, the others are dropped
+	void ast::reorder() {
+		const idx_t none = ~static_cast<idx_t>(0);
+		std::vector<idx_t> at(nodes_.size(), none); // by old node, the new one
+		std::vector<node> nodes;
+		std::vector<idx_t> lists;
+		nodes.reserve(nodes_.size());
+		lists.reserve(lists_.size());
+		std::vector<std::pair<idx_t, idx_t>> stack = {{root_, 0}}; // and children seen
+		while (!stack.empty()) {
+			idx_t nd = stack.back().first;
+			idx_t next = child(nd, stack.back().second++);
+			if (next != none) {
+				if (at[next] == none) {
+					stack.push_back({next, 0});
+				}
+				continue;
+			}
+			stack.pop_back();
+			node copy = nodes_[nd];
+			switch (copy.type_) {
+				case node_t::SCOPE:
+					copy.first_ = static_cast<idx_t>(lists.size());
+					for (idx_t i = 0; i < copy.count_; ++i) {
+						lists.push_back(at[lists_[nodes_[nd].first_ + i]]);
+					}
+					break;
+				case node_t::IF:
+					copy.else_ = at[copy.else_];
+					// fall through
+				case node_t::DO:
+					copy.cond_ = at[copy.cond_];
+					copy.body_ = at[copy.body_];
+					break;
+				case node_t::WHILE:
+					copy.cond_ = at[copy.cond_];
+					copy.body_ = at[copy.body_];
+					copy.tracked_ = static_cast<idx_t>(lists.size());
+					lists.insert(
+						lists.end(), lists_.begin() + nodes_[nd].tracked_,
+						lists_.begin() + nodes_[nd].tracked_ + copy.val_
+					);
+					break;
+				case node_t::BINARY_OPERATION:
+					copy.lhs_ = at[copy.lhs_];
+					// fall through
+				case node_t::PRINT: case node_t::UNARY_OPERATION:
+					copy.rhs_ = at[copy.rhs_];
+					break;
+				default:
+					break;
+			}
+			at[nd] = static_cast<idx_t>(nodes.size());
+			nodes.push_back(copy);
+		}
+		root_ = at[root_];
+		nodes_.swap(nodes);
+		lists_.swap(lists);
+	}
+
+	// the k-th node run of the ones nd is made of, ~0 past the last
+	ast::idx_t ast::child(idx_t nd, idx_t k) const {
+		const node& node = nodes_[nd];
+		switch (node.type_) {
+			case node_t::SCOPE:
+				return k < node.count_ ? lists_[node.first_ + k] : ~static_cast<idx_t>(0);
+			case node_t::IF:
+				return k == 0 ? node.cond_ : k == 1 ? node.body_ : \
+					k == 2 ? node.else_ : ~static_cast<idx_t>(0);
+			case node_t::WHILE:
+				return k == 0 ? node.cond_ : k == 1 ? node.body_ : ~static_cast<idx_t>(0);
+			case node_t::DO:
+				return k == 0 ? node.body_ : k == 1 ? node.cond_ : ~static_cast<idx_t>(0);
+			case node_t::BINARY_OPERATION:
+				return k == 0 ? node.lhs_ : k == 1 ? node.rhs_ : ~static_cast<idx_t>(0);
+			case node_t::PRINT: case node_t::UNARY_OPERATION:
+				return k == 0 ? node.rhs_ : ~static_cast<idx_t>(0);
+			default:
+				return ~static_cast<idx_t>(0);
+		}
+	}
+
+	unOp_t ast::unop(idx_t nd) const {
+		return static_cast<unOp_t>(nodes_[nd].op_);
+	}
+
+	binOp_t ast::binop(idx_t nd) const {
+		return static_cast<binOp_t>(nodes_[nd].op_);
+	}
+
+	ast::bind_t ast::bind(idx_t nd) const {
+		return static_cast<bind_t>(nodes_[nd].op_);
+	}
+
+	bool ast::is_assignment(idx_t nd) const {
+		return nodes_[nd].type_ == node_t::BINARY_OPERATION && \
+			binop(nd) == binOp_t::ASSIGNMENT;
+	}
+
+	size_t ast::frame_size() const {
+		return frame_size_;
+	}
+
+	size_t ast::footprint() const {
+		return nodes_.capacity() * sizeof(node) + lists_.capacity() * sizeof(idx_t) + \
+			divisors_.capacity() * sizeof(divisor);
+	}
+
+	//--------identifiers resolution--------
+	//
+	//	An identifier always lives in the frame slot equal to its id: a name is
+	//	defined in at most one scope at a time, since the lookup goes from the
+	//	outermost scope and a new one is created only when the lookup fails.
+	//	Scopes only decide when the slot becomes undefined again, and everything
+	//	defined inside of if, while, do or block is undefined after it, so
+	//	whether an identifier is defined is known statically at every point.
+	//	The only exception is the condition of while with a non-block body: the
+	//	body defines identifiers in the scope of while which are seen by the
+	//	next evaluation of the condition, such identifiers are checked at run
+	//	time and are listed by the while node.
+
+	void ast::resolve() {
+		resolve_begin();
+		resolve_more(root_);
+	}
+
+	void ast::resolve_begin() {
+		binds_.clear();
+		defined_.clear();
+		maybe_read_.clear();
+		frame_size_ = 0;
+	}
+
+	void ast::resolve_more(idx_t nd) {
+		resolve_stmt(nd);
+	}
+
+	void ast::undefine_to(size_t mark) {
+		while (defined_.size() > mark) {
+			binds_[defined_.back()] = bind_t::UNDEFINED;
+			defined_.pop_back();
+		}
+	}
+
+	ast::bind_t& ast::bind_of(size_t id) {
+		if (id >= binds_.size()) {
+			binds_.resize(id + 1, bind_t::UNDEFINED);
+			frame_size_ = id + 1;
+		}
+		return binds_[id];
+	}
+
+	void ast::resolve_stmt(idx_t nd) {
+		size_t mark = defined_.size();
+		node_t type = nodes_[nd].type_;
+		if (type == node_t::SCOPE) {
+			idx_t first = nodes_[nd].first_; // whiles inside may move lists_
+			for (idx_t i = 0, ie = nodes_[nd].count_; i < ie; ++i) {
+				resolve_stmt(lists_[first + i]);
+			}
+		} else if (type == node_t::IF) {
+			resolve_expr(nodes_[nd].cond_);
+			resolve_stmt(nodes_[nd].body_);
+			undefine_to(mark);
+			resolve_stmt(nodes_[nd].else_);
+		} else if (type == node_t::DO) {
+			resolve_stmt(nodes_[nd].body_);
+			undefine_to(mark);
+			resolve_expr(nodes_[nd].cond_);
+		} else if (type == node_t::WHILE) {
+			resolve_stmt(nodes_[nd].body_);
+			for (size_t i = mark; i < defined_.size(); ++i) {
+				binds_[defined_[i]] = bind_t::UNKNOWN;
+			}
+			maybe_read_.clear();
+			resolve_expr(nodes_[nd].cond_);
+			nodes_[nd].tracked_ = static_cast<idx_t>(lists_.size());
+			nodes_[nd].val_ = static_cast<int>(maybe_read_.size());
+			lists_.insert(lists_.end(), maybe_read_.begin(), maybe_read_.end());
+		} else if (type == node_t::PRINT) {
+			resolve_right(nodes_[nd].rhs_);
+			return; // simple statements define identifiers in the enclosing scope
+		} else if (type != node_t::EMPTY) {
+			resolve_right(nd);
+			return;
+		}
+		undefine_to(mark);
+	}
+
+	void ast::resolve_right(idx_t nd) {
+		if (nodes_[nd].type_ == node_t::IDENTIFIER) {
+			resolve_lval(nd);
+		} else if (is_assignment(nd)) {
+			resolve_lval(nodes_[nd].lhs_);
+			resolve_expr(nodes_[nd].rhs_);
+		} else {
+			resolve_expr(nd);
+		}
+	}
+
+	void ast::resolve_lval(idx_t nd) {
+		bind_t& bind = bind_of(nodes_[nd].val_);
+		nodes_[nd].op_ = static_cast<unsigned char>(bind);
+		if (bind != bind_t::DEFINED) {
+			bind = bind_t::DEFINED;
+			defined_.push_back(nodes_[nd].val_);
+		}
+	}
+
+	void ast::resolve_expr(idx_t nd) {
+		node_t type = nodes_[nd].type_;
+		if (type == node_t::UNARY_OPERATION) {
+			resolve_expr(nodes_[nd].rhs_);
+		} else if (type == node_t::BINARY_OPERATION) {
+			resolve_expr(nodes_[nd].lhs_);
+			resolve_expr(nodes_[nd].rhs_);
+		} else if (type == node_t::IDENTIFIER) {
+			idx_t id = nodes_[nd].val_;
+			bind_t bind = bind_of(id);
+			nodes_[nd].op_ = static_cast<unsigned char>(bind);
+			if (
+				bind == bind_t::UNKNOWN && \
+				std::find(maybe_read_.begin(), maybe_read_.end(), id) \
+				== maybe_read_.end()
+			) {
+				maybe_read_.push_back(id);
+			}
+		}
+	}
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "arith.h"
+#include "types_decl.h"
+
+namespace cplr {
+
+	// abstract syntax tree kept in one buffer: nodes refer to each other by
+	// 32-bit indices and are built in post-order, so children go before their
+	// parent and the root is the last node; the optimizer adds nodes at the
+	// end and puts a scope in place of a loop, and reorder puts them back
+	class ast final {
+	public:
+		using idx_t = uint32_t;
+
+		enum class bind_t : unsigned char { // what is known about an identifier
+			DEFINED, // defined on every path
+			UNDEFINED, // undefined on every path
+			UNKNOWN // has to be checked at run time
+		};
+
+		struct node {
+			node_t type_;
+			unsigned char op_; // unOp_t, binOp_t or bind_t of an identifier
+			union {
+				idx_t lhs_; // binary operation
+				idx_t cond_; // if, while, do
+				idx_t first_; // scope: first statement in lists_
+			};
+			union {
+				idx_t rhs_; // unary and binary operation, value of print
+				idx_t body_; // if, while, do
+				idx_t count_; // scope: number of statements
+			};
+			union {
+				idx_t else_; // if
+				idx_t tracked_; // while: first id checked at run time in lists_
+				idx_t divisor_; // / and % by a constant: 1 + index in divisors_
+			};
+			int val_; // int literal, id of an identifier, number of tracked ids
+		};
+
+		ast();
+
+		void clear(); // drops the whole tree at once
+		void drop_nodes(); // the same, but what resolution knows is kept
+		size_t size() const;
+		const node& operator[](idx_t nd) const;
+		node& operator[](idx_t nd);
+		idx_t root() const;
+		void set_root(idx_t nd);
+		const idx_t * list(idx_t first) const; // statements of scope, tracked ids
+		idx_t * list(idx_t first);
+
+		idx_t make_empty();
+		idx_t make_leaf(node_t type); // ?, true, false
+		idx_t make_id(size_t id);
+		idx_t make_int(int int_lit);
+		idx_t make_print(idx_t val);
+		idx_t make_unop(unOp_t op, idx_t rhs);
+		idx_t make_binop(binOp_t op, idx_t lhs, idx_t rhs);
+		idx_t make_if(idx_t cond, idx_t if_body, idx_t else_body);
+		idx_t make_while(node_t type, idx_t cond, idx_t body);
+		idx_t make_scope(const std::vector<idx_t>& stmts);
+		idx_t make_copy(idx_t nd);
+		idx_t make_temp(); // a frame slot of no identifier, see optimizer
+		void set_scope(idx_t nd, const std::vector<idx_t>& stmts); // in place of nd
+		void set_divisor(idx_t nd, int d); // |d| >= 2
+		const divisor& divisor_of(idx_t nd) const; // if divisor_ is set
+		void reorder(); // in post-order again after the tree is rewritten
+
+		unOp_t unop(idx_t nd) const;
+		binOp_t binop(idx_t nd) const;
+		bind_t bind(idx_t nd) const;
+		bool is_assignment(idx_t nd) const;
+
+		void resolve();
+		void resolve_begin(); // resolve is resolve_begin and resolve_more(root)
+		void resolve_more(idx_t nd); // the next top-level statement
+		size_t frame_size() const; // identifiers live in slots 0 .. frame_size - 1
+		size_t footprint() const; // bytes taken by the tree
+
+	private:
+		idx_t add(const node& nd);
+		idx_t child(idx_t nd, idx_t k) const;
+
+		void undefine_to(size_t mark);
+		bind_t& bind_of(size_t id);
+		void resolve_stmt(idx_t nd);
+		void resolve_right(idx_t nd);
+		void resolve_lval(idx_t nd);
+		void resolve_expr(idx_t nd);
+
+		std::vector<node> nodes_;
+		std::vector<idx_t> lists_;
+		std::vector<divisor> divisors_;
+		idx_t root_;
+		size_t frame_size_;
+
+		std::vector<bind_t> binds_; // resolution state of every identifier
+		std::vector<size_t> defined_; // ids defined by the resolution so far
+		std::vector<idx_t> maybe_read_;
+	};
+
+}
@@ -0,0 +1,923 @@
+#include "compiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+
+namespace cplr {
+
+	bytecode::bytecode()
+	: stack_size_(0)
+	, id_count_(0)
+	{}
+
+	// identifiers are shown by name when names are given, temporaries of
+	// optimizer have no names
+	void bytecode::dump(std::ostream& os, const symbol_table *names) const {
+		static const char *op_names[] = {
+			"halt", "push", "pop", "dup", "load", "loadc", "store", "define", "decl",
+			"kill", "undef", "scan", "print", "not", "neg", "eq", "ne", "lt", "le",
+			"ge", "gt", "add", "sub", "mul", "div", "rem", "divn", "remn", "and", "or",
+			"mulk", "shlk", "divk", "remk", "jmp", "jz", "jnz", "jeq", "jne", "jlt",
+			"jle", "jge", "jgt"
+		};
+		static_assert(
+			sizeof(op_names) / sizeof(*op_names) == static_cast<size_t>(opcode::JGT) + 1,
+			"a name for every opcode, and JGT is the last one"
+		);
+		for (size_t i = 0; i < code_.size(); ++i) {
+			const instr& in = code_[i];
+			os << i << '\t' << op_names[static_cast<size_t>(in.op)];
+			switch (in.op) {
+				case opcode::LOAD: case opcode::LOADC: case opcode::STORE:
+				case opcode::DEFINE: case opcode::DECL: case opcode::KILL:
+				case opcode::UNDEF:
+					os << ' ' << in.arg;
+					if (
+						names != nullptr && static_cast<size_t>(in.arg) < names->size()
+					) {
+						os << "\t; " << names->name(in.arg);
+					}
+					break;
+				case opcode::PUSH: case opcode::MULK: case opcode::SHLK:
+				case opcode::JMP: case opcode::JZ: case opcode::JNZ:
+				case opcode::JEQ: case opcode::JNE: case opcode::JLT:
+				case opcode::JLE: case opcode::JGE: case opcode::JGT:
+					os << ' ' << in.arg;
+					break;
+				case opcode::DIVK: case opcode::REMK:
+					os << ' ' << in.arg << "\t; " << divisors_[in.arg].d;
+					break;
+				default:
+					break;
+			}
+			os << '\n';
+		}
+	}
+
+	compiler::compiler(const parser& prsr)
+	: prsr_(prsr)
+	, tree_(prsr.get_ast())
+	, bc_(nullptr)
+	, depth_(0)
+	{}
+
+	int compiler::compile(bytecode& bc) {
+		if (prsr_.get_err_ctr() > 0) {
+			return -1;
+		}
+		bc_ = &bc;
+		bc.code_.clear();
+		bc.divisors_.clear();
+		bc.stack_size_ = 0;
+		bc.id_count_ = tree_.frame_size();
+		depth_ = 0;
+		compile_stmt(tree_.root());
+		emit(opcode::HALT);
+		bc_ = nullptr;
+		return 0;
+	}
+
+	// the loop starts at the check of its condition, or at the top of the body
+	// of a do, as parser::run_while and run_do are left there when the loop
+	// is taken over by a faster tier
+	int compiler::compile_loop(idx_t nd, bytecode& bc) {
+		if (prsr_.get_err_ctr() > 0) {
+			return -1;
+		}
+		bc_ = &bc;
+		bc.code_.clear();
+		bc.divisors_.clear();
+		bc.stack_size_ = 0;
+		bc.id_count_ = tree_.frame_size();
+		depth_ = 0;
+		if (tree_[nd].type_ == node_t::WHILE) {
+			compile_while(nd, false);
+		} else {
+			compile_stmt(nd);
+		}
+		emit(opcode::HALT);
+		bc_ = nullptr;
+		return 0;
+	}
+
+	// the trailing halt of bc is replaced, so a program parsed statement by
+	// statement is compiled into one piece of code
+	int compiler::append(bytecode& bc) {
+		if (prsr_.get_err_ctr() > 0) {
+			return -1;
+		}
+		bc_ = &bc;
+		if (!bc.code_.empty() && bc.code_.back().op == opcode::HALT) {
+			bc.code_.pop_back();
+		}
+		if (tree_.frame_size() > bc.id_count_) {
+			bc.id_count_ = tree_.frame_size();
+		}
+		depth_ = 0;
+		compile_stmt(tree_.root());
+		emit(opcode::HALT);
+		bc_ = nullptr;
+		return 0;
+	}
+
+	// keeps track of the depth of the operand stack, which sizes the stack
+	static size_t emit_to(bytecode& bc, size_t& depth, opcode op, int arg) {
+		switch (op) {
+			case opcode::PUSH: case opcode::DUP: case opcode::LOAD:
+			case opcode::LOADC: case opcode::UNDEF: case opcode::SCAN:
+				++depth;
+				break;
+			case opcode::POP: case opcode::STORE: case opcode::PRINT:
+			case opcode::JZ: case opcode::JNZ:
+			case opcode::EQ: case opcode::NE: case opcode::LT: case opcode::LE:
+			case opcode::GE: case opcode::GT: case opcode::ADD: case opcode::SUB:
+			case opcode::MUL: case opcode::DIV: case opcode::REM:
+			case opcode::DIVN: case opcode::REMN: case opcode::AND: case opcode::OR:
+				--depth;
+				break;
+			case opcode::JEQ: case opcode::JNE: case opcode::JLT: case opcode::JLE:
+			case opcode::JGE: case opcode::JGT:
+				depth -= 2;
+				break;
+			default:
+				break;
+		}
+		if (depth > bc.stack_size_) {
+			bc.stack_size_ = depth;
+		}
+		bc.code_.push_back({op, arg});
+		return bc.code_.size() - 1;
+	}
+
+	// a comparison jumping when it is false is the opposite one jumping when
+	// it is true
+	static opcode compare_and_jump(size_t at, bool when) { // at from EQ
+		static const opcode jumps[] = {
+			opcode::JEQ, opcode::JNE, opcode::JLT, opcode::JLE, opcode::JGE, opcode::JGT
+		};
+		static const size_t opposite[] = {1, 0, 4, 5, 2, 3};
+		return jumps[when ? at : opposite[at]];
+	}
+
+	size_t compiler::emit(opcode op, int arg) {
+		return emit_to(*bc_, depth_, op, arg);
+	}
+
+	void compiler::patch(size_t at, size_t target) {
+		bc_->code_[at].arg = static_cast<int>(target);
+	}
+
+	size_t compiler::here() const {
+		return bc_->code_.size();
+	}
+
+	// scopes are resolved by ast::resolve, so only identifiers which whiles
+	// check at run time need any care: they are killed whenever
+	// parser::run_while does
+	void compiler::compile_stmt(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[nd].first_);
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				compile_stmt(it[i]);
+			}
+		} else if (type == node_t::IF) {
+			std::vector<size_t> to_else;
+			compile_branch(tree_[nd].cond_, false, to_else);
+			compile_stmt(tree_[nd].body_);
+			if (tree_[tree_[nd].else_].type_ != node_t::EMPTY) {
+				size_t to_end = emit(opcode::JMP);
+				for (auto it : to_else) {
+					patch(it, here());
+				}
+				compile_stmt(tree_[nd].else_);
+				patch(to_end, here());
+			} else {
+				for (auto it : to_else) {
+					patch(it, here());
+				}
+			}
+		} else if (type == node_t::WHILE) {
+			compile_while(nd, true);
+		} else if (type == node_t::DO) {
+			std::vector<size_t> to_top;
+			size_t top = here();
+			compile_stmt(tree_[nd].body_);
+			compile_branch(tree_[nd].cond_, true, to_top);
+			for (auto it : to_top) {
+				patch(it, top);
+			}
+		} else if (type != node_t::EMPTY) {
+			compile_prnt(nd);
+		}
+	}
+
+	// entered is false when the loop is taken over in the middle, after
+	// the tracked identifiers were killed before its first check
+	void compiler::compile_while(idx_t nd, bool entered) {
+		std::vector<size_t> to_exit;
+		const idx_t *tracked = tree_.list(tree_[nd].tracked_);
+		int tracked_cnt = tree_[nd].val_;
+		for (int i = 0; i < tracked_cnt && entered; ++i) {
+			emit(opcode::KILL, tracked[i]);
+		}
+		size_t top = here();
+		if (tracked_cnt == 0) {
+			compile_branch(tree_[nd].cond_, false, to_exit);
+		} else {
+			compile_expr(tree_[nd].cond_);
+			for (int i = 0; i < tracked_cnt; ++i) {
+				emit(opcode::KILL, tracked[i]);
+			}
+			to_exit.push_back(emit(opcode::JZ));
+		}
+		compile_stmt(tree_[nd].body_);
+		emit(opcode::JMP, static_cast<int>(top));
+		for (auto it : to_exit) {
+			patch(it, here());
+		}
+	}
+
+	void compiler::compile_prnt(idx_t nd) {
+		if (tree_[nd].type_ == node_t::PRINT) {
+			compile_right(tree_[nd].rhs_);
+			emit(opcode::PRINT);
+		} else if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			compile_lval(nd);
+		} else if (tree_.is_assignment(nd)) {
+			compile_lval(tree_[nd].lhs_);
+			compile_expr(tree_[nd].rhs_);
+			emit(opcode::STORE, tree_[tree_[nd].lhs_].val_);
+		} else {
+			compile_expr(nd);
+			emit(opcode::POP);
+		}
+	}
+
+	void compiler::compile_right(idx_t nd) { // leaves value on stack
+		if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			compile_lval(nd);
+			emit(opcode::LOAD, tree_[nd].val_);
+		} else if (tree_.is_assignment(nd)) {
+			compile_lval(tree_[nd].lhs_);
+			compile_expr(tree_[nd].rhs_);
+			emit(opcode::DUP);
+			emit(opcode::STORE, tree_[tree_[nd].lhs_].val_);
+		} else {
+			compile_expr(nd);
+		}
+	}
+
+	void compiler::compile_lval(idx_t nd) {
+		if (tree_.bind(nd) == ast::bind_t::UNDEFINED) {
+			emit(opcode::DEFINE, tree_[nd].val_);
+		} else if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+			emit(opcode::DECL, tree_[nd].val_);
+		}
+	}
+
+	void compiler::compile_expr(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::UNARY_OPERATION) {
+			compile_expr(tree_[nd].rhs_);
+			emit(
+				tree_.unop(nd) == unOp_t::LOGICAL_NEGATION ? opcode::NOT : opcode::NEG
+			);
+		} else if (type == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			if (op == binOp_t::OR || op == binOp_t::AND) {
+				compile_logical(nd);
+				return;
+			} else if (op == binOp_t::ASSIGNMENT) { // to a temporary, see optimizer
+				compile_right(nd);
+				return;
+			} else if (compile_by_const(nd)) {
+				return;
+			}
+			compile_expr(tree_[nd].lhs_);
+			compile_expr(tree_[nd].rhs_);
+			switch (op) {
+				case binOp_t::EQUAL: emit(opcode::EQ); break;
+				case binOp_t::NOT_EQUAL: emit(opcode::NE); break;
+				case binOp_t::LESS: emit(opcode::LT); break;
+				case binOp_t::LESS_OR_EQUAL: emit(opcode::LE); break;
+				case binOp_t::GREATER_OR_EQUAL: emit(opcode::GE); break;
+				case binOp_t::GREATER: emit(opcode::GT); break;
+				case binOp_t::ADDITION: emit(opcode::ADD); break;
+				case binOp_t::SUBSTRACTION: emit(opcode::SUB); break;
+				case binOp_t::MULTIPLICATION: emit(opcode::MUL); break;
+				case binOp_t::DIVISION: emit(opcode::DIV); break;
+				case binOp_t::REMAINDER: emit(opcode::REM); break;
+				default: break;
+			}
+		} else if (type == node_t::IDENTIFIER) {
+			if (tree_.bind(nd) == ast::bind_t::DEFINED) {
+				emit(opcode::LOAD, tree_[nd].val_);
+			} else if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+				emit(opcode::LOADC, tree_[nd].val_);
+			} else {
+				emit(opcode::UNDEF, tree_[nd].val_);
+			}
+		} else if (type == node_t::INTEGER_LITERAL) {
+			emit(opcode::PUSH, tree_[nd].val_);
+		} else if (type == node_t::SCAN) {
+			emit(opcode::SCAN);
+		} else if (type == node_t::BOOL_TRUE) {
+			emit(opcode::PUSH, 1);
+		} else { // type == node_t::BOOL_FALSE
+			emit(opcode::PUSH, 0);
+		}
+	}
+
+	// * by a literal on either side and / or % by one on the right take the
+	// constant as the argument: a power of 2 is a shift and a divisor other
+	// than 0, 1 and -1 gets its magic number
+	bool compiler::compile_by_const(idx_t nd) {
+		binOp_t op = tree_.binop(nd);
+		idx_t lhs = tree_[nd].lhs_, rhs = tree_[nd].rhs_;
+		bool rhs_lit = tree_[rhs].type_ == node_t::INTEGER_LITERAL;
+		if (op == binOp_t::MULTIPLICATION) {
+			if (!rhs_lit && tree_[lhs].type_ != node_t::INTEGER_LITERAL) {
+				return false;
+			} else if (!rhs_lit) { // the literal has no side effects to keep in order
+				std::swap(lhs, rhs);
+			}
+			compile_expr(lhs);
+			int k = tree_[rhs].val_;
+			if (k > 1 && (k & (k - 1)) == 0) {
+				emit(opcode::SHLK, __builtin_ctz(k));
+			} else {
+				emit(opcode::MULK, k);
+			}
+			return true;
+		} else if (op == binOp_t::DIVISION || op == binOp_t::REMAINDER) {
+			int d = rhs_lit ? tree_[rhs].val_ : 0;
+			if (d >= -1 && d <= 1) {
+				return false;
+			}
+			compile_expr(lhs);
+			bc_->divisors_.push_back(make_divisor(d));
+			int at = static_cast<int>(bc_->divisors_.size() - 1);
+			emit(op == binOp_t::DIVISION ? opcode::DIVK : opcode::REMK, at);
+			return true;
+		}
+		return false;
+	}
+
+	void compiler::compile_logical(idx_t nd) {
+		size_t base = depth_;
+		std::vector<size_t> to_false;
+		compile_branch(nd, false, to_false);
+		emit(opcode::PUSH, 1);
+		size_t to_end = emit(opcode::JMP);
+		for (auto it : to_false) {
+			patch(it, here());
+		}
+		depth_ = base;
+		emit(opcode::PUSH, 0);
+		patch(to_end, here());
+	}
+
+	// emits code which jumps away when the value of nd converted to bool equals
+	// to when and falls through otherwise, the jumps are left for the caller to
+	// patch; && and || never materialize their operands this way, nor do
+	// comparisons, which jump by themselves
+	void compiler::compile_branch(
+		idx_t nd, bool when, std::vector<size_t>& jumps
+	) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::UNARY_OPERATION) {
+			if (tree_.unop(nd) == unOp_t::LOGICAL_NEGATION) {
+				compile_branch(tree_[nd].rhs_, !when, jumps);
+				return;
+			}
+		} else if (type == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			bool is_and = op == binOp_t::AND;
+			if (op >= binOp_t::EQUAL && op <= binOp_t::GREATER) {
+				compile_expr(tree_[nd].lhs_);
+				compile_expr(tree_[nd].rhs_);
+				size_t at = static_cast<size_t>(op) - static_cast<size_t>(binOp_t::EQUAL);
+				jumps.push_back(emit(compare_and_jump(at, when)));
+				return;
+			} else if (is_and || op == binOp_t::OR) {
+				if (is_and != when) { // && jumping on false, || jumping on true
+					compile_branch(tree_[nd].lhs_, when, jumps);
+					compile_branch(tree_[nd].rhs_, when, jumps);
+				} else {
+					std::vector<size_t> to_skip;
+					compile_branch(tree_[nd].lhs_, !when, to_skip);
+					compile_branch(tree_[nd].rhs_, when, jumps);
+					for (auto it : to_skip) {
+						patch(it, here());
+					}
+				}
+				return;
+			}
+		} else if (
+			type == node_t::INTEGER_LITERAL || type == node_t::BOOL_TRUE || \
+			type == node_t::BOOL_FALSE
+		) {
+			bool value = type == node_t::BOOL_TRUE || (
+				type == node_t::INTEGER_LITERAL && tree_[nd].val_ != 0
+			);
+			if (value == when) {
+				jumps.push_back(emit(opcode::JMP));
+			}
+			return;
+		}
+		compile_expr(nd);
+		jumps.push_back(emit(when ? opcode::JNZ : opcode::JZ));
+	}
+
+
+	//--------ir_compiler--------
+	//
+	//	A value used once, later in its block, is computed right where it is
+	//	used, so expressions of the tree are put on the operand stack again.
+	//	Only the order of ?, and of division which may fail, has to be kept:
+	//	such a value moves only over instructions with no side effects, not
+	//	even over ones moving to the same place, which are put there in the
+	//	order of the operands rather than of the program. Any value may be
+	//	computed on an edge, since the values of phis are all read before any
+	//	is set.
+
+	static const size_t at_branch = SIZE_MAX - 1; // the condition of the block
+	static const size_t on_edge = SIZE_MAX; // copies into phis of a successor
+
+	ir_compiler::ir_compiler(const ir& code)
+	: code_(code)
+	, bc_(nullptr)
+	, depth_(0)
+	{}
+
+	int ir_compiler::compile(bytecode& bc) {
+		bc_ = &bc;
+		bc.code_.clear();
+		bc.divisors_.clear();
+		bc.stack_size_ = 0;
+		depth_ = 0;
+		jumps_.clear();
+		std::vector<block_t> order = code_.order();
+		plan(order);
+		starts_.assign(code_.blocks_.size(), 0);
+		for (size_t i = 0; i < order.size(); ++i) {
+			compile_block(order[i], i + 1 < order.size() ? order[i + 1] : ir::none);
+		}
+		if (order.empty()) {
+			emit(opcode::HALT);
+		}
+		for (auto& it : jumps_) {
+			bc.code_[it.first].arg = static_cast<int>(starts_[it.second]);
+		}
+		bc_ = nullptr;
+		return 0;
+	}
+
+	size_t ir_compiler::emit(opcode op, int arg) {
+		return emit_to(*bc_, depth_, op, arg);
+	}
+
+	void ir_compiler::plan(const std::vector<block_t>& order) {
+		size_t n = code_.instrs_.size();
+		uses_.assign(n, 0);
+		site_blocks_.assign(n, ir::none);
+		sites_.assign(n, 0);
+		roots_.assign(n, 0);
+		folded_.assign(n, 0);
+		slots_.assign(n, -1);
+		auto use = [&](value_t v, block_t b, size_t at) {
+			++uses_[v];
+			site_blocks_[v] = b;
+			sites_[v] = at;
+		};
+		for (auto b : order) {
+			const ir::block& blk = code_.blocks_[b];
+			for (auto phi : blk.phis_) {
+				const std::vector<value_t>& args = code_.instrs_[phi].args_;
+				for (size_t i = 0; i < args.size(); ++i) {
+					use(args[i], blk.preds_[i], on_edge);
+				}
+			}
+			for (size_t j = 0; j < blk.code_.size(); ++j) {
+				for (auto arg : code_.instrs_[blk.code_[j]].args_) {
+					use(arg, b, j);
+				}
+			}
+			if (blk.term_ == ir::term_t::BR) {
+				use(blk.cond_, b, at_branch);
+			}
+		}
+		for (auto b : order) {
+			plan_block(b);
+		}
+		coalesce(order);
+		int slot = 0;
+		for (auto b : order) {
+			const ir::block& blk = code_.blocks_[b];
+			for (int part = 0; part < 2; ++part) {
+				for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+					if (!has_slot(v)) {
+						continue;
+					}
+					value_t cls = find_class(v);
+					if (slots_[cls] < 0) {
+						slots_[cls] = slot++;
+					}
+					slots_[v] = slots_[cls];
+				}
+			}
+		}
+		bc_->id_count_ = slot;
+	}
+
+	// goes backwards, so the place of the user is known before its arguments
+	void ir_compiler::plan_block(block_t b) {
+		const std::vector<value_t>& code = code_.blocks_[b].code_;
+		for (size_t j = code.size(); j-- > 0;) {
+			value_t v = code[j];
+			roots_[v] = j;
+			if (uses_[v] != 1 || site_blocks_[v] != b) {
+				continue;
+			}
+			size_t site = sites_[v];
+			size_t root = site < code.size() ? roots_[code[site]] : site;
+			if (!code_.is_pure(v)) {
+				if (root == on_edge) {
+					continue;
+				}
+				bool moves = true;
+				for (size_t k = j + 1; k < root && k < code.size(); ++k) {
+					value_t w = code[k];
+					if (!code_.is_pure(w)) {
+						moves = false;
+						break;
+					}
+				}
+				if (!moves) {
+					continue;
+				}
+			}
+			folded_[v] = 1;
+			roots_[v] = root;
+		}
+	}
+
+	bool ir_compiler::has_slot(value_t v) const {
+		const ir::instr& in = code_.instrs_[v];
+		return in.op_ == ir::op_t::PHI || (
+			in.op_ != ir::op_t::CONST && in.op_ != ir::op_t::PRINT && \
+			!folded_[v] && uses_[v] > 0
+		);
+	}
+
+	// a phi and its argument share a slot, so the copy on the edge is gone,
+	// unless their classes interfere: some value of one is still read where
+	// a value of the other is set
+	void ir_compiler::coalesce(const std::vector<block_t>& order) {
+		size_t n = code_.instrs_.size();
+		classes_.resize(n);
+		members_.assign(n, {});
+		for (value_t v = 0; v < n; ++v) {
+			classes_[v] = v;
+		}
+		find_liveness(order);
+		for (auto b : order) {
+			for (auto phi : code_.blocks_[b].phis_) {
+				for (auto arg : code_.instrs_[phi].args_) {
+					if (!has_slot(arg)) {
+						continue;
+					}
+					value_t lhs = find_class(arg), rhs = find_class(phi);
+					if (lhs == rhs) {
+						continue;
+					}
+					bool free = true;
+					for (size_t i = 0; free && i < members_[lhs].size(); ++i) {
+						for (auto other : members_[rhs]) {
+							value_t v = members_[lhs][i];
+							if (live_at(v, other) || live_at(other, v)) {
+								free = false;
+								break;
+							}
+						}
+					}
+					if (free) {
+						classes_[lhs] = rhs;
+						members_[rhs].insert(
+							members_[rhs].end(), members_[lhs].begin(), members_[lhs].end()
+						);
+						members_[lhs].clear();
+					}
+				}
+			}
+		}
+	}
+
+	// a value is read where its user is computed, and an argument of a phi
+	// at the end of the predecessor
+	void ir_compiler::find_liveness(const std::vector<block_t>& order) {
+		size_t n = code_.instrs_.size(), blocks = code_.blocks_.size();
+		positions_.assign(n, 0);
+		last_uses_.clear();
+		std::vector<std::vector<value_t>> reads(blocks); // set before the block
+		auto read = [&](value_t v, block_t b, size_t at) {
+			if (!has_slot(v)) {
+				return;
+			}
+			uint64_t key = (static_cast<uint64_t>(b) << 32) | v;
+			auto it = last_uses_.find(key);
+			if (it == last_uses_.end()) {
+				last_uses_.emplace(key, at);
+				if (code_.instrs_[v].block_ != b) {
+					reads[b].push_back(v);
+				}
+			} else if (it->second < at) {
+				it->second = at;
+			}
+		};
+		for (auto b : order) {
+			const ir::block& blk = code_.blocks_[b];
+			for (auto v : blk.phis_) {
+				members_[v].push_back(v);
+			}
+			for (size_t j = 0; j < blk.code_.size(); ++j) {
+				value_t v = blk.code_[j];
+				positions_[v] = j;
+				if (has_slot(v)) {
+					members_[v].push_back(v);
+				}
+				for (auto arg : code_.instrs_[v].args_) {
+					read(arg, b, folded_[v] ? roots_[v] : j);
+				}
+			}
+			if (blk.term_ == ir::term_t::BR) {
+				read(blk.cond_, b, at_branch);
+			}
+			for (size_t i = 0; i < code_.successors(b); ++i) {
+				const ir::block& succ = code_.blocks_[blk.succ_[i]];
+				size_t k = 0;
+				while (succ.preds_[k] != b) {
+					++k;
+				}
+				for (auto phi : succ.phis_) {
+					read(code_.instrs_[phi].args_[k], b, on_edge);
+				}
+			}
+			std::sort(reads[b].begin(), reads[b].end());
+		}
+
+		live_in_.assign(blocks, {});
+		live_out_.assign(blocks, {});
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto it = order.rbegin(); it != order.rend(); ++it) {
+				const ir::block& blk = code_.blocks_[*it];
+				std::vector<value_t> out, in;
+				for (size_t i = 0; i < code_.successors(*it); ++i) {
+					const std::vector<value_t>& next = live_in_[blk.succ_[i]];
+					std::vector<value_t> both;
+					std::set_union(
+						out.begin(), out.end(), next.begin(), next.end(),
+						std::back_inserter(both)
+					);
+					out.swap(both);
+				}
+				for (auto v : out) {
+					if (code_.instrs_[v].block_ != *it) {
+						in.push_back(v);
+					}
+				}
+				std::vector<value_t> both;
+				std::set_union(
+					in.begin(), in.end(), reads[*it].begin(), reads[*it].end(),
+					std::back_inserter(both)
+				);
+				if (both != live_in_[*it]) {
+					live_in_[*it].swap(both);
+					changed = true;
+				}
+				live_out_[*it].swap(out);
+			}
+		}
+	}
+
+	// whether v is still to be read right after def is set
+	bool ir_compiler::live_at(value_t v, value_t def) const {
+		block_t b = code_.instrs_[def].block_;
+		const std::vector<value_t>& in = live_in_[b];
+		bool live_in = std::binary_search(in.begin(), in.end(), v);
+		const ir::instr& vin = code_.instrs_[v];
+		if (code_.instrs_[def].op_ == ir::op_t::PHI) { // phis are set at once
+			return live_in || (vin.block_ == b && vin.op_ == ir::op_t::PHI);
+		} else if (
+			!live_in && (vin.block_ != b || (
+				vin.op_ != ir::op_t::PHI && positions_[v] > positions_[def]
+			))
+		) {
+			return false; // not set yet
+		}
+		uint64_t key = (static_cast<uint64_t>(b) << 32) | v;
+		auto it = last_uses_.find(key);
+		if (it != last_uses_.end() && it->second > positions_[def]) {
+			return true;
+		}
+		const std::vector<value_t>& out = live_out_[b];
+		return std::binary_search(out.begin(), out.end(), v);
+	}
+
+	ir_compiler::value_t ir_compiler::find_class(value_t v) {
+		while (classes_[v] != v) {
+			classes_[v] = classes_[classes_[v]];
+			v = classes_[v];
+		}
+		return v;
+	}
+
+	void ir_compiler::compile_block(block_t b, block_t next) {
+		const ir::block& blk = code_.blocks_[b];
+		starts_[b] = bc_->code_.size();
+		for (auto v : blk.code_) {
+			if (folded_[v]) {
+				continue;
+			} else if (code_.instrs_[v].op_ == ir::op_t::PRINT) {
+				compile_value(code_.instrs_[v].args_[0]);
+				emit(opcode::PRINT);
+				continue;
+			}
+			compile_op(v);
+			if (uses_[v] > 0) {
+				emit(opcode::STORE, slots_[v]);
+			} else {
+				emit(opcode::POP);
+			}
+		}
+
+		if (blk.term_ == ir::term_t::JMP) {
+			compile_edge(b, blk.succ_[0]);
+			if (blk.succ_[0] != next) {
+				compile_jump(opcode::JMP, blk.succ_[0]);
+			}
+		} else if (blk.term_ == ir::term_t::BR) {
+			block_t then_b = blk.succ_[0], else_b = blk.succ_[1];
+			if (!has_copies(b, else_b) && (then_b == next || has_copies(b, then_b))) {
+				jumps_.push_back({compile_branch(blk.cond_, false), else_b});
+				compile_edge(b, then_b);
+				if (then_b != next) {
+					compile_jump(opcode::JMP, then_b);
+				}
+				return;
+			}
+			if (!has_copies(b, then_b)) {
+				jumps_.push_back({compile_branch(blk.cond_, true), then_b});
+			} else {
+				size_t to_else = compile_branch(blk.cond_, false);
+				compile_edge(b, then_b);
+				compile_jump(opcode::JMP, then_b);
+				bc_->code_[to_else].arg = static_cast<int>(bc_->code_.size());
+			}
+			compile_edge(b, else_b);
+			if (else_b != next) {
+				compile_jump(opcode::JMP, else_b);
+			}
+		} else if (blk.term_ == ir::term_t::HALT) {
+			emit(opcode::HALT);
+		} else { // ir::term_t::UNDEF
+			emit(opcode::UNDEF, static_cast<int>(blk.id_));
+		}
+	}
+
+	bool ir_compiler::has_copies(block_t from, block_t to) const {
+		const ir::block& blk = code_.blocks_[to];
+		for (size_t i = 0; i < blk.preds_.size(); ++i) {
+			if (blk.preds_[i] != from) {
+				continue;
+			}
+			for (auto phi : blk.phis_) {
+				if (slots_[code_.instrs_[phi].args_[i]] != slots_[phi]) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void ir_compiler::compile_edge(block_t from, block_t to) {
+		const ir::block& blk = code_.blocks_[to];
+		size_t i = 0;
+		while (i < blk.preds_.size() && blk.preds_[i] != from) {
+			++i;
+		}
+		std::vector<value_t> set;
+		for (auto phi : blk.phis_) {
+			value_t arg = code_.instrs_[phi].args_[i];
+			if (slots_[arg] != slots_[phi]) {
+				compile_value(arg);
+				set.push_back(phi);
+			}
+		}
+		for (size_t k = set.size(); k-- > 0;) {
+			emit(opcode::STORE, slots_[set[k]]);
+		}
+	}
+
+	void ir_compiler::compile_jump(opcode op, block_t to) {
+		jumps_.push_back({emit(op), to});
+	}
+
+	// a condition computed right here jumps by itself when it is a comparison
+	// and its ! is the opposite jump, otherwise it is taken from the stack;
+	// the jump is left to patch
+	size_t ir_compiler::compile_branch(value_t cond, bool when) {
+		const ir::instr& in = code_.instrs_[cond];
+		if (code_.is_const(cond) || !folded_[cond]) {
+			compile_value(cond);
+			return emit(when ? opcode::JNZ : opcode::JZ);
+		} else if (in.op_ == ir::op_t::NOT) {
+			return compile_branch(in.args_[0], !when);
+		} else if (in.op_ < ir::op_t::EQ || in.op_ > ir::op_t::GT) {
+			compile_op(cond);
+			return emit(when ? opcode::JNZ : opcode::JZ);
+		}
+		compile_value(in.args_[0]);
+		compile_value(in.args_[1]);
+		size_t at = static_cast<size_t>(in.op_) - static_cast<size_t>(ir::op_t::EQ);
+		return emit(compare_and_jump(at, when));
+	}
+
+	void ir_compiler::compile_value(value_t v) {
+		if (code_.is_const(v)) {
+			emit(opcode::PUSH, code_.instrs_[v].val_);
+		} else if (folded_[v]) {
+			compile_op(v);
+		} else {
+			emit(opcode::LOAD, slots_[v]);
+		}
+	}
+
+	// takes constants as arguments as compiler::compile_by_const does
+	void ir_compiler::compile_op(value_t v) {
+		const ir::instr& in = code_.instrs_[v];
+		switch (in.op_) {
+			case ir::op_t::SCAN:
+				emit(opcode::SCAN);
+				return;
+			case ir::op_t::NOT: case ir::op_t::NEG:
+				compile_value(in.args_[0]);
+				emit(in.op_ == ir::op_t::NOT ? opcode::NOT : opcode::NEG);
+				return;
+			default:
+				break;
+		}
+
+		value_t lhs = in.args_[0], rhs = in.args_[1];
+		if (in.op_ == ir::op_t::MUL && (code_.is_const(lhs) || code_.is_const(rhs))) {
+			if (!code_.is_const(rhs)) {
+				std::swap(lhs, rhs);
+			}
+			compile_value(lhs);
+			int k = code_.instrs_[rhs].val_;
+			if (k > 1 && (k & (k - 1)) == 0) {
+				emit(opcode::SHLK, __builtin_ctz(k));
+			} else {
+				emit(opcode::MULK, k);
+			}
+			return;
+		} else if (
+			(in.op_ >= ir::op_t::DIV && in.op_ <= ir::op_t::REMN) && \
+			code_.is_const(rhs) && (code_.instrs_[rhs].val_ < -1 || \
+			code_.instrs_[rhs].val_ > 1)
+		) {
+			compile_value(lhs);
+			bc_->divisors_.push_back(make_divisor(code_.instrs_[rhs].val_));
+			int at = static_cast<int>(bc_->divisors_.size() - 1);
+			bool is_div = in.op_ == ir::op_t::DIV || in.op_ == ir::op_t::DIVN;
+			emit(is_div ? opcode::DIVK : opcode::REMK, at);
+			return;
+		}
+		compile_value(lhs);
+		compile_value(rhs);
+		switch (in.op_) {
+			case ir::op_t::EQ: emit(opcode::EQ); break;
+			case ir::op_t::NE: emit(opcode::NE); break;
+			case ir::op_t::LT: emit(opcode::LT); break;
+			case ir::op_t::LE: emit(opcode::LE); break;
+			case ir::op_t::GE: emit(opcode::GE); break;
+			case ir::op_t::GT: emit(opcode::GT); break;
+			case ir::op_t::ADD: emit(opcode::ADD); break;
+			case ir::op_t::SUB: emit(opcode::SUB); break;
+			case ir::op_t::MUL: emit(opcode::MUL); break;
+			case ir::op_t::DIV: emit(opcode::DIV); break;
+			case ir::op_t::REM: emit(opcode::REM); break;
+			case ir::op_t::DIVN: emit(opcode::DIVN); break;
+			case ir::op_t::REMN: emit(opcode::REMN); break;
+			case ir::op_t::AND: emit(opcode::AND); break;
+			case ir::op_t::OR: emit(opcode::OR); break;
+			default: break;
+		}
+	}
+
+}
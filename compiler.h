@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "arith.h"
+#include "ast.h"
+#include "ir.h"
+#include "parser.h"
+#include "symbols.h"
+#include "types_decl.h"
+
+namespace cplr {
+
+	enum class opcode : unsigned char {
+		HALT,
+		PUSH, // push arg
+		POP,
+		DUP,
+		LOAD, // push value of identifier arg
+		LOADC, // the same, but check that the identifier is defined
+		STORE, // pop value into identifier arg
+		DEFINE, // define identifier arg as 0
+		DECL, // define identifier arg as 0 unless it's defined
+		KILL, // undefine identifier arg
+		UNDEF, // fail on reading an undefined identifier
+		SCAN, // ?
+		PRINT,
+		NOT, // !
+		NEG, // unary -
+		EQ,
+		NE,
+		LT,
+		LE,
+		GE,
+		GT,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		REM, // %
+		DIVN, // / by a divisor known to be safe, see range_analysis
+		REMN,
+		AND, // of booleans, 0 or 1
+		OR,
+		MULK, // multiply by arg
+		SHLK, // shift left by arg, multiplies by a power of 2
+		DIVK, // divide by divisors_[arg]
+		REMK, // remainder of division by divisors_[arg]
+		JMP, // jump to arg
+		JZ, // pop, jump to arg if zero
+		JNZ, // pop, jump to arg if nonzero
+		JEQ, // pop two, jump to arg if they are equal
+		JNE,
+		JLT,
+		JLE,
+		JGE,
+		JGT
+	};
+
+	// the jumps are the last opcodes, from JMP to JGT
+	inline bool is_jump(opcode op) {
+		return op >= opcode::JMP;
+	}
+
+	struct instr {
+		opcode op;
+		int arg;
+	};
+
+	class bytecode final {
+	public:
+		bytecode();
+		void dump(std::ostream& os, const symbol_table *names = nullptr) const;
+
+		std::vector<instr> code_;
+		std::vector<divisor> divisors_; // constants divided by
+		size_t stack_size_; // max depth of the operand stack
+		size_t id_count_; // frame slots are numbered 0 .. id_count_ - 1
+	};
+
+	class compiler final { // lowers the tree built by parser into bytecode
+	public:
+		compiler(const parser& prsr);
+		int compile(bytecode& bc);
+		int append(bytecode& bc); // the tree is added to the end of bc
+		int compile_loop(ast::idx_t nd, bytecode& bc); // the while or do alone
+
+	private:
+		using idx_t = ast::idx_t;
+
+		size_t emit(opcode op, int arg = 0);
+		void patch(size_t at, size_t target);
+		size_t here() const;
+
+		void compile_stmt(idx_t nd);
+		void compile_while(idx_t nd, bool entered);
+		void compile_prnt(idx_t nd);
+		void compile_right(idx_t nd);
+		void compile_lval(idx_t nd);
+		void compile_expr(idx_t nd);
+		bool compile_by_const(idx_t nd);
+		void compile_logical(idx_t nd);
+		void compile_branch(idx_t nd, bool when, std::vector<size_t>& jumps);
+
+		const parser& prsr_;
+		const ast& tree_;
+		bytecode *bc_;
+		size_t depth_; // current depth of the operand stack
+	};
+
+	// takes ir out of SSA into bytecode: a value gets a frame slot unless its
+	// only use is in the same block and it can be computed there, phis share
+	// slots with their arguments when they can, and the rest of them are set
+	// on the edges to their block, all of the values pushed before any is
+	// stored, so they are copied at once
+	class ir_compiler final {
+	public:
+		explicit ir_compiler(const ir& code);
+		int compile(bytecode& bc);
+
+	private:
+		using value_t = ir::value_t;
+		using block_t = ir::block_t;
+
+		size_t emit(opcode op, int arg = 0);
+		void plan(const std::vector<block_t>& order);
+		void plan_block(block_t b);
+		bool has_slot(value_t v) const;
+		void coalesce(const std::vector<block_t>& order);
+		void find_liveness(const std::vector<block_t>& order);
+		bool live_at(value_t v, value_t def) const;
+		value_t find_class(value_t v);
+		void compile_block(block_t b, block_t next);
+		bool has_copies(block_t from, block_t to) const;
+		void compile_edge(block_t from, block_t to);
+		void compile_jump(opcode op, block_t to);
+		size_t compile_branch(value_t cond, bool when);
+		void compile_value(value_t v);
+		void compile_op(value_t v);
+
+		const ir& code_;
+		bytecode *bc_;
+		size_t depth_;
+		std::vector<uint32_t> uses_; // by value
+		std::vector<block_t> site_blocks_; // by value, of its last use
+		std::vector<size_t> sites_; // the same, position in the block
+		std::vector<size_t> roots_; // by value, where it is computed
+		std::vector<unsigned char> folded_; // computed where it is used
+		std::vector<int> slots_; // by value
+		std::vector<size_t> positions_; // by value, in its block
+		std::vector<value_t> classes_; // by value, sharing a slot with
+		std::vector<std::vector<value_t>> members_; // by class
+		std::unordered_map<uint64_t, size_t> last_uses_; // by block and value
+		std::vector<std::vector<value_t>> live_in_; // by block, sorted
+		std::vector<std::vector<value_t>> live_out_;
+		std::vector<size_t> starts_; // by block
+		std::vector<std::pair<size_t, block_t>> jumps_; // to patch
+	};
+
+}
@@ -0,0 +1,469 @@
+#include "elf.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "jit.h"
+
+namespace cplr {
+
+	//--------elf_image--------
+	//
+	//	The file is loaded at a fixed address as one read and execute segment:
+	//	the headers, the messages of errors, the runtime and the code of jit.
+	//	A second segment of zeros next to it holds the state of the runtime
+	//	and the frame of the code, whose first quadword is the address of the
+	//	state, so the runtime gets it in rdi as jit::scan gets the jit. The
+	//	runtime keeps the state in r8 and uses only registers which the code
+	//	of jit doesn't keep its values in.
+
+	using namespace x86;
+
+	static const uint64_t base = 0x400000; // where the file is loaded
+	static const uint64_t page = 0x1000;
+	static const size_t header_size = sizeof(Elf64_Ehdr) + 3 * sizeof(Elf64_Phdr);
+	static const int32_t block = 1 << 16; // of input and output
+	static const int32_t max_item_size = 12; // -2147483648 and a newline
+	static const int32_t eintr = -4; // returned by an interrupted system call
+
+	enum state_t : int32_t { // the runtime state, by offset
+		OUT_USED = 0, // bytes in out_buf
+		IN_POS = 8, // the next byte of in_buf to read
+		IN_END = 16,
+		IN_EOF = 24, // nothing more comes from read
+		IN_FAILED = 25, // like failbit of std::cin: nothing is read after it
+		SCRATCH = 32, // print puts digits here, from the end
+		SCRATCH_END = SCRATCH + 16,
+		OUT_BUF = 64,
+		IN_BUF = OUT_BUF + block,
+		STATE_SIZE = IN_BUF + block
+	};
+
+	static const char *messages[] = { // by jit::error_t
+		"Undefined identifier\n", "Division by zero\n"
+	};
+
+	static operand reg(int r) {
+		return {false, r, 0};
+	}
+
+	static operand state(int32_t at) {
+		return {true, R8, at};
+	}
+
+	static void syscall(assembler& as) {
+		as.byte(0x0F);
+		as.byte(0x05);
+	}
+
+	static void ret(assembler& as) {
+		as.byte(0xC3);
+	}
+
+	elf_image::elf_image()
+	: start_(0)
+	, flush_(0)
+	, refill_(0)
+	, scan_(0)
+	, print_(0)
+	, fail_(0)
+	, messages_{0, 0}
+	, to_program_(0)
+	{}
+
+	int elf_image::build(const bytecode& bc) {
+		if (bc.code_.empty()) {
+			return -1;
+		}
+		as_.clear();
+		to_state_.clear();
+		to_frame_.clear();
+		for (int i = jit::UNDEFINED; i <= jit::DIVISION_BY_ZERO; ++i) {
+			messages_[i] = as_.size();
+			for (const char *it = messages[i]; *it != '\0'; ++it) {
+				as_.byte(static_cast<unsigned char>(*it));
+			}
+		}
+		while (as_.size() % 16 != 0) {
+			as_.byte(0xCC); // int3
+		}
+		compile_flush();
+		compile_refill();
+		compile_scan();
+		compile_print();
+		compile_fail();
+		compile_start();
+
+		input in; // never read nor written, the code calls the runtime above
+		output out;
+		jit code(in, out);
+		code.link({address(scan_), address(print_), address(fail_)});
+		code.generate(bc);
+		as_.patch(to_program_, as_.size());
+		for (auto it : code.code()) {
+			as_.byte(it);
+		}
+
+		size_t text_size = header_size + as_.size();
+		uint64_t state_at = (base + text_size + page - 1) & ~(page - 1);
+		uint64_t frame_at = state_at + STATE_SIZE;
+
+		Elf64_Ehdr eh = {};
+		std::memcpy(eh.e_ident, ELFMAG, SELFMAG);
+		eh.e_ident[EI_CLASS] = ELFCLASS64;
+		eh.e_ident[EI_DATA] = ELFDATA2LSB;
+		eh.e_ident[EI_VERSION] = EV_CURRENT;
+		eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+		eh.e_type = ET_EXEC;
+		eh.e_machine = EM_X86_64;
+		eh.e_version = EV_CURRENT;
+		eh.e_entry = address(start_);
+		eh.e_phoff = sizeof(eh);
+		eh.e_ehsize = sizeof(eh);
+		eh.e_phentsize = sizeof(Elf64_Phdr);
+		eh.e_phnum = 3;
+
+		Elf64_Phdr ph[3] = {};
+		ph[0].p_type = PT_LOAD;
+		ph[0].p_flags = PF_R | PF_X;
+		ph[0].p_vaddr = ph[0].p_paddr = base;
+		ph[0].p_filesz = ph[0].p_memsz = text_size;
+		ph[0].p_align = page;
+		ph[1].p_type = PT_LOAD; // zeros only, nothing of the file
+		ph[1].p_flags = PF_R | PF_W;
+		ph[1].p_vaddr = ph[1].p_paddr = state_at;
+		ph[1].p_memsz = STATE_SIZE + code.frame_size();
+		ph[1].p_align = page;
+		ph[2].p_type = PT_GNU_STACK; // which isn't executable
+		ph[2].p_flags = PF_R | PF_W;
+
+		file_.resize(text_size);
+		std::memcpy(file_.data(), &eh, sizeof(eh));
+		std::memcpy(file_.data() + sizeof(eh), ph, sizeof(ph));
+		std::memcpy(file_.data() + header_size, as_.code().data(), as_.size());
+		for (auto at : to_state_) {
+			uint32_t addr = static_cast<uint32_t>(state_at);
+			std::memcpy(file_.data() + header_size + at, &addr, 4);
+		}
+		for (auto at : to_frame_) {
+			uint32_t addr = static_cast<uint32_t>(frame_at);
+			std::memcpy(file_.data() + header_size + at, &addr, 4);
+		}
+		return 0;
+	}
+
+	int elf_image::write(const char *path) const {
+		int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+		if (fd < 0) {
+			return -1;
+		}
+		const unsigned char *pos = file_.data();
+		size_t left = file_.size();
+		while (left > 0) {
+			ssize_t put = ::write(fd, pos, left);
+			if (put < 0 && errno == EINTR) {
+				continue;
+			}
+			if (put <= 0) {
+				break;
+			}
+			pos += put;
+			left -= put;
+		}
+		bool done = left == 0 && fchmod(fd, 0755) == 0;
+		return close(fd) == 0 && done ? 0 : -1;
+	}
+
+	size_t elf_image::size() const {
+		return file_.size();
+	}
+
+	uint64_t elf_image::address(size_t at) const {
+		return base + header_size + at;
+	}
+
+	//--------runtime--------
+
+	// sets the frame up, runs the program and exits with 0 after writing out
+	// what it printed, as main does after an error too
+	void elf_image::compile_start() {
+		start_ = as_.size();
+		as_.mov_imm(reg(RDI), 0);
+		to_frame_.push_back(as_.size() - 4);
+		as_.mov_imm(reg(RSI), 0);
+		to_state_.push_back(as_.size() - 4);
+		as_.op_rm(0x89, RSI, {true, RDI, 0}, true); // mov [rdi], rsi
+		to_program_ = as_.call();
+		as_.mov_imm(reg(R8), 0);
+		to_state_.push_back(as_.size() - 4);
+		as_.patch(as_.call(), flush_);
+		as_.mov_imm(reg(RAX), 231); // exit_group
+		as_.op_rm(0x33, RDI, reg(RDI)); // xor edi, edi
+		syscall(as_);
+	}
+
+	// as output::flush; rax, rcx, rdx, rsi, rdi and r11 are lost
+	void elf_image::compile_flush() {
+		flush_ = as_.size();
+		as_.op_rm(0x8D, RSI, state(OUT_BUF), true); // lea rsi, out_buf
+		as_.op_rm(0x8B, RDX, state(OUT_USED), true);
+		size_t top = as_.size();
+		as_.op_rm(0x85, RDX, reg(RDX), true); // test rdx, rdx
+		size_t empty = as_.jump(E);
+		as_.mov_imm(reg(RAX), 1); // write
+		as_.mov_imm(reg(RDI), 1); // stdout
+		syscall(as_);
+		as_.op_rm(0x83, 7, reg(RAX), true); // cmp rax, -EINTR
+		as_.byte(static_cast<unsigned char>(eintr));
+		as_.patch(as_.jump(E), top);
+		as_.op_rm(0x85, RAX, reg(RAX), true);
+		size_t dropped = as_.jump(LE); // nobody reads it anymore
+		as_.op_rm(0x03, RSI, reg(RAX), true);
+		as_.op_rm(0x2B, RDX, reg(RAX), true);
+		as_.patch(as_.jump(ALWAYS), top);
+		as_.bind(empty);
+		as_.bind(dropped);
+		as_.op_rm(0xC7, 0, state(OUT_USED), true); // mov qword out_used, 0
+		as_.imm32(0);
+		ret(as_);
+	}
+
+	// as input::refill, eax is 0 if nothing is left; what is written is seen
+	// before waiting for input
+	void elf_image::compile_refill() {
+		refill_ = as_.size();
+		as_.op_rm(0x80, 7, state(IN_EOF)); // cmp byte in_eof, 0
+		as_.byte(0);
+		size_t over = as_.jump(NE);
+		as_.patch(as_.call(), flush_);
+		size_t top = as_.size();
+		as_.op_rm(0x33, RAX, reg(RAX)); // read
+		as_.op_rm(0x33, RDI, reg(RDI)); // stdin
+		as_.op_rm(0x8D, RSI, state(IN_BUF), true);
+		as_.mov_imm(reg(RDX), block);
+		syscall(as_);
+		as_.op_rm(0x83, 7, reg(RAX), true);
+		as_.byte(static_cast<unsigned char>(eintr));
+		as_.patch(as_.jump(E), top);
+		as_.op_rm(0x85, RAX, reg(RAX), true);
+		size_t eof = as_.jump(LE);
+		as_.op_rm(0x89, RSI, state(IN_POS), true);
+		as_.op_rm(0x03, RSI, reg(RAX), true);
+		as_.op_rm(0x89, RSI, state(IN_END), true);
+		as_.mov_imm(reg(RAX), 1);
+		ret(as_);
+		as_.bind(eof);
+		as_.op_rm(0xC6, 0, state(IN_EOF)); // mov byte in_eof, 1
+		as_.byte(1);
+		as_.bind(over);
+		as_.op_rm(0x33, RAX, reg(RAX));
+		ret(as_);
+	}
+
+	// as input::read_text, a digit at a time: r9 has bit 0 set for a minus
+	// and bit 1 once a digit is read, r10 is the magnitude, kept up to
+	// INT_MAX + 2 so it doesn't overflow
+	void elf_image::compile_scan() {
+		scan_ = as_.size();
+		as_.op_rm(0x89, RDI, reg(R8), true); // mov r8, rdi
+		as_.op_rm(0x80, 7, state(IN_FAILED));
+		as_.byte(0);
+		size_t failed_before = as_.jump(NE);
+
+		size_t skip = as_.size();
+		as_.op_rm(0x8B, RSI, state(IN_POS), true);
+		as_.op_rm(0x3B, RSI, state(IN_END), true);
+		size_t have = as_.jump(NE);
+		as_.patch(as_.call(), refill_);
+		as_.op_rm(0x85, RAX, reg(RAX));
+		size_t none = as_.jump(E);
+		as_.patch(as_.jump(ALWAYS), skip);
+		as_.bind(have);
+		as_.op_rm2(0xB6, RAX, {true, RSI, 0}); // movzx eax, byte [rsi]
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte(' ');
+		size_t space = as_.jump(E);
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte('\t');
+		size_t below = as_.jump(B);
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte('\r');
+		size_t above = as_.jump(A);
+		as_.bind(space);
+		as_.op_rm(0xFF, 0, reg(RSI), true); // inc rsi
+		as_.op_rm(0x89, RSI, state(IN_POS), true);
+		as_.patch(as_.jump(ALWAYS), skip);
+
+		as_.bind(below);
+		as_.bind(above);
+		as_.op_rm(0x33, R9, reg(R9));
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte('-');
+		size_t plus = as_.jump(NE);
+		as_.mov_imm(reg(R9), 1);
+		size_t sign = as_.jump(ALWAYS);
+		as_.bind(plus);
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte('+');
+		size_t digits = as_.jump(NE);
+		as_.bind(sign);
+		as_.op_rm(0xFF, 0, reg(RSI), true);
+		as_.op_rm(0x89, RSI, state(IN_POS), true);
+		as_.bind(digits);
+		as_.op_rm(0x33, R10, reg(R10));
+
+		size_t next = as_.size();
+		as_.op_rm(0x8B, RSI, state(IN_POS), true);
+		as_.op_rm(0x3B, RSI, state(IN_END), true);
+		size_t got = as_.jump(NE);
+		as_.patch(as_.call(), refill_);
+		as_.op_rm(0x85, RAX, reg(RAX));
+		size_t ended = as_.jump(E);
+		as_.patch(as_.jump(ALWAYS), next);
+		as_.bind(got);
+		as_.op_rm2(0xB6, RAX, {true, RSI, 0});
+		as_.op_rm(0x83, 5, reg(RAX)); // sub eax, '0'
+		as_.byte('0');
+		as_.op_rm(0x83, 7, reg(RAX));
+		as_.byte(9);
+		size_t not_digit = as_.jump(A);
+		as_.op_rm(0xFF, 0, reg(RSI), true);
+		as_.op_rm(0x89, RSI, state(IN_POS), true);
+		as_.op_rm(0x83, 1, reg(R9)); // or r9d, 2
+		as_.byte(2);
+		as_.op_rm(0x6B, R10, reg(R10), true); // imul r10, r10, 10
+		as_.byte(10);
+		as_.op_rm(0x03, R10, reg(RAX), true);
+		as_.mov_imm(reg(RCX), INT_MIN); // rcx is INT_MAX + 1
+		as_.op_rm(0x3B, R10, reg(RCX), true);
+		as_.patch(as_.jump(BE), next);
+		as_.op_rm(0xFF, 0, reg(RCX), true);
+		as_.op_rm(0x8B, R10, reg(RCX), true);
+		as_.patch(as_.jump(ALWAYS), next);
+
+		as_.bind(ended);
+		as_.bind(not_digit);
+		as_.op_rm(0xF7, 0, reg(R9)); // test r9d, 2
+		as_.imm32(2);
+		size_t no_digits = as_.jump(E);
+		as_.mov_imm(reg(RCX), INT_MIN);
+		as_.op_rm(0x3B, R10, reg(RCX), true);
+		size_t out_of_range = as_.jump(A);
+		size_t in_range = as_.jump(B);
+		as_.op_rm(0xF7, 0, reg(R9)); // INT_MAX + 1 fits only with a minus
+		as_.imm32(1);
+		size_t too_big = as_.jump(E);
+		as_.bind(in_range);
+		as_.op_rm(0x8B, RAX, reg(R10)); // mov eax, r10d
+		as_.op_rm(0xF7, 0, reg(R9));
+		as_.imm32(1);
+		size_t positive = as_.jump(E);
+		as_.op_rm(0xF7, 3, reg(RAX)); // neg eax
+		as_.bind(positive);
+		ret(as_);
+
+		as_.bind(out_of_range);
+		as_.bind(too_big);
+		as_.op_rm(0xC6, 0, state(IN_FAILED));
+		as_.byte(1);
+		as_.mov_imm(reg(RAX), INT_MAX);
+		as_.op_rm(0xF7, 0, reg(R9));
+		as_.imm32(1);
+		size_t saturated = as_.jump(E);
+		as_.mov_imm(reg(RAX), INT_MIN);
+		as_.bind(saturated);
+		ret(as_);
+
+		as_.bind(none);
+		as_.bind(no_digits);
+		as_.op_rm(0xC6, 0, state(IN_FAILED));
+		as_.byte(1);
+		as_.bind(failed_before);
+		as_.op_rm(0x33, RAX, reg(RAX));
+		ret(as_);
+	}
+
+	// as output::write_text, digits go from the end of the scratch, r10
+	void elf_image::compile_print() {
+		print_ = as_.size();
+		as_.op_rm(0x89, RDI, reg(R8), true);
+		as_.op_rm(0x8B, R9, reg(RSI)); // mov r9d, esi
+		as_.op_rm(0x8B, RAX, state(OUT_USED), true);
+		as_.op_rm(0x81, 7, reg(RAX), true); // cmp rax, block - max_item_size
+		as_.imm32(block - max_item_size);
+		size_t room = as_.jump(BE);
+		as_.patch(as_.call(), flush_);
+		as_.bind(room);
+		as_.op_rm(0x8D, R10, state(SCRATCH_END), true);
+		as_.op_rm(0x8B, RDI, reg(R10), true);
+		as_.op_rm(0xFF, 1, reg(RDI), true); // dec rdi
+		as_.op_rm(0xC6, 0, {true, RDI, 0}); // mov byte [rdi], '\n'
+		as_.byte('\n');
+		as_.op_rm(0x8B, RAX, reg(R9));
+		as_.op_rm(0x85, RAX, reg(RAX));
+		size_t positive = as_.jump(NS);
+		as_.op_rm(0xF7, 3, reg(RAX)); // the magnitude of INT_MIN too, unsigned
+		as_.bind(positive);
+		as_.mov_imm(reg(RCX), 10);
+		size_t digit = as_.size();
+		as_.op_rm(0x33, RDX, reg(RDX));
+		as_.op_rm(0xF7, 6, reg(RCX)); // div ecx
+		as_.op_rm(0x83, 0, reg(RDX)); // add edx, '0'
+		as_.byte('0');
+		as_.op_rm(0xFF, 1, reg(RDI), true);
+		as_.op_rm(0x88, RDX, {true, RDI, 0}); // mov [rdi], dl
+		as_.op_rm(0x85, RAX, reg(RAX));
+		as_.patch(as_.jump(NE), digit);
+		as_.op_rm(0x85, R9, reg(R9));
+		size_t copy = as_.jump(NS);
+		as_.op_rm(0xFF, 1, reg(RDI), true);
+		as_.op_rm(0xC6, 0, {true, RDI, 0});
+		as_.byte('-');
+		as_.bind(copy);
+		as_.op_rm(0x8D, RDX, state(OUT_BUF), true);
+		as_.op_rm(0x03, RDX, state(OUT_USED), true);
+		size_t next = as_.size();
+		as_.op_rm(0x8A, RCX, {true, RDI, 0}); // mov cl, [rdi]
+		as_.op_rm(0x88, RCX, {true, RDX, 0});
+		as_.op_rm(0xFF, 0, reg(RDI), true);
+		as_.op_rm(0xFF, 0, reg(RDX), true);
+		as_.op_rm(0x3B, RDI, reg(R10), true);
+		as_.patch(as_.jump(B), next);
+		as_.op_rm(0x8D, RAX, state(OUT_BUF), true);
+		as_.op_rm(0x2B, RDX, reg(RAX), true);
+		as_.op_rm(0x89, RDX, state(OUT_USED), true);
+		ret(as_);
+	}
+
+	// writes out what was printed, then the message of jit::error_t in esi
+	void elf_image::compile_fail() {
+		fail_ = as_.size();
+		as_.op_rm(0x89, RDI, reg(R8), true);
+		as_.op_rm(0x8B, R9, reg(RSI));
+		as_.patch(as_.call(), flush_);
+		as_.mov_imm(reg(RAX), 1); // write
+		as_.mov_imm(reg(RDI), 2); // stderr
+		as_.mov_imm(reg(RSI), static_cast<int32_t>(address(messages_[jit::UNDEFINED])));
+		as_.mov_imm(reg(RDX), static_cast<int32_t>(std::strlen(messages[jit::UNDEFINED])));
+		as_.op_rm(0x85, R9, reg(R9));
+		size_t undefined = as_.jump(E);
+		as_.mov_imm(
+			reg(RSI), static_cast<int32_t>(address(messages_[jit::DIVISION_BY_ZERO]))
+		);
+		as_.mov_imm(
+			reg(RDX), static_cast<int32_t>(std::strlen(messages[jit::DIVISION_BY_ZERO]))
+		);
+		as_.bind(undefined);
+		syscall(as_);
+		as_.mov_imm(reg(RAX), -2);
+		ret(as_);
+	}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "compiler.h"
+#include "x86.h"
+
+namespace cplr {
+
+	// a static x86-64 Linux executable of bytecode which needs no libc nor any
+	// compiler: the machine code of jit is linked to a runtime of its own doing
+	// ? and print by raw system calls, decimal text only, so the whole file
+	// takes a few kilobytes and starts at once
+	class elf_image final {
+	public:
+		elf_image();
+		int build(const bytecode& bc); // -1 if there is no code to make
+		int write(const char *path) const; // an executable file; 0 on success
+		size_t size() const; // bytes of the file
+
+	private:
+		void compile_start();
+		void compile_flush();
+		void compile_refill();
+		void compile_scan();
+		void compile_print();
+		void compile_fail();
+		uint64_t address(size_t at) const; // of the byte at in the text
+
+		x86::assembler as_; // the text after the headers
+		size_t start_; // entry points in the text
+		size_t flush_;
+		size_t refill_;
+		size_t scan_;
+		size_t print_;
+		size_t fail_;
+		size_t messages_[2]; // by jit::error_t
+		std::vector<size_t> to_state_; // imm32 set to the address of the state
+		std::vector<size_t> to_frame_; // and of the frame
+		size_t to_program_; // the call of the program
+		std::vector<unsigned char> file_;
+	};
+
+}
@@ -0,0 +1,317 @@
+#include "io.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cplr {
+
+	static const size_t input_block_size = 1 << 16;
+
+	//--------input--------
+
+	input::input()
+	: fd_(STDIN_FILENO)
+	, own_fd_(false)
+	, format_(format_t::TEXT)
+	, pos_(nullptr)
+	, end_(nullptr)
+	, map_(nullptr)
+	, map_size_(0)
+	, eof_(false)
+	, failed_(false)
+	, tied_(nullptr)
+	{}
+
+	input::~input() {
+		close();
+	}
+
+	void input::close() {
+		if (map_ != nullptr) {
+			munmap(map_, map_size_);
+		}
+		if (own_fd_) {
+			::close(fd_);
+		}
+		fd_ = STDIN_FILENO;
+		own_fd_ = false;
+		pos_ = end_ = nullptr;
+		map_ = nullptr;
+		map_size_ = 0;
+		eof_ = false;
+		failed_ = false;
+	}
+
+	int input::open(const char *path) {
+		close();
+		if (path != nullptr && strcmp(path, "-") != 0) {
+			fd_ = ::open(path, O_RDONLY);
+			if (fd_ < 0) {
+				fd_ = STDIN_FILENO;
+				return -1;
+			}
+			own_fd_ = true;
+		}
+
+		struct stat st;
+		if (fstat(fd_, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+			if (addr != MAP_FAILED) {
+				madvise(addr, st.st_size, MADV_SEQUENTIAL);
+				map_ = addr;
+				map_size_ = st.st_size;
+				pos_ = static_cast<const char *>(addr);
+				end_ = pos_ + st.st_size;
+				eof_ = true; // all of it is there already
+			}
+		}
+		return 0;
+	}
+
+	void input::set_format(format_t format) {
+		format_ = format;
+	}
+
+	void input::tie(output *out) {
+		tied_ = out;
+	}
+
+	bool input::refill() {
+		if (eof_) {
+			return false;
+		}
+		buffer_.resize(input_block_size);
+		if (tied_ != nullptr) {
+			tied_->flush(); // as cin tied to cout does, prompts are seen first
+		}
+		while (1) {
+			ssize_t got = read(fd_, buffer_.data(), buffer_.size());
+			if (got < 0 && errno == EINTR) {
+				continue;
+			}
+			if (got <= 0) {
+				eof_ = true;
+				return false;
+			}
+			pos_ = buffer_.data();
+			end_ = pos_ + got;
+			return true;
+		}
+	}
+
+	int input::read_int() {
+		if (failed_) {
+			return 0;
+		}
+		if (format_ == format_t::TEXT) {
+			return read_text();
+		}
+
+		if (format_ == format_t::I32) {
+			int32_t value = 0;
+			if (!read_raw(reinterpret_cast<unsigned char *>(&value), sizeof(value))) {
+				return 0;
+			}
+			return value;
+		}
+		int64_t value = 0;
+		if (!read_raw(reinterpret_cast<unsigned char *>(&value), sizeof(value))) {
+			return 0;
+		}
+		return static_cast<int>(static_cast<uint64_t>(value));
+	}
+
+	bool input::read_raw(unsigned char *dst, size_t size) {
+		if (static_cast<size_t>(end_ - pos_) >= size) {
+			memcpy(dst, pos_, size);
+			pos_ += size;
+			return true;
+		}
+		for (size_t i = 0; i < size; ++i) { // the value is split between blocks
+			if (pos_ == end_ && !refill()) {
+				failed_ = true;
+				return false;
+			}
+			dst[i] = *pos_++;
+		}
+		return true;
+	}
+
+	// bytes of the first 8 which are decimal digits, counted from the lowest
+	static inline size_t digit_cnt(uint64_t word) {
+		const uint64_t high = 0xF0F0F0F0F0F0F0F0ull, zeros = 0x3030303030303030ull;
+		// a byte is a digit if it is 0x3? and doesn't get out of 0x3? plus 6
+		uint64_t bad = ((word & high) ^ zeros) | \
+			(((word + 0x0606060606060606ull) & high) ^ zeros);
+		return bad == 0 ? 8 : __builtin_ctzll(bad) / 8;
+	}
+
+	// value of the cnt lowest digits of word, the first digit is the lowest byte
+	static inline uint32_t swar_digits(uint64_t word, size_t cnt) {
+		uint64_t mask = cnt == 8 ? ~0ull : (1ull << (8 * cnt)) - 1;
+		uint64_t val = ((word & mask) - (0x3030303030303030ull & mask)) << (8 * (8 - cnt));
+		val = val * 10 + (val >> 8); // pairs of digits
+		val = (
+			((val & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) + \
+			(((val >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))
+		) >> 32;
+		return static_cast<uint32_t>(val);
+	}
+
+	static const uint64_t pow10[] = {
+		1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+	};
+
+	int input::read_text() {
+		while (1) {
+			if (pos_ == end_ && !refill()) {
+				failed_ = true;
+				return 0;
+			}
+			char c = *pos_;
+			if (c != ' ' && (c < '\t' || c > '\r')) {
+				break;
+			}
+			++pos_;
+		}
+
+		bool neg = false;
+		if (*pos_ == '-' || *pos_ == '+') {
+			neg = *pos_ == '-';
+			++pos_;
+		}
+		// the magnitude is kept up to INT_MAX + 1, anything bigger overflows
+		const uint64_t limit = static_cast<uint64_t>(INT_MAX) + 1;
+		uint64_t acc = 0;
+		size_t digits = 0;
+		bool more = true;
+		while (more) {
+			size_t cnt;
+			if (end_ - pos_ >= 8) {
+				uint64_t word;
+				memcpy(&word, pos_, 8);
+				cnt = digit_cnt(word);
+				if (cnt > 0) {
+					acc = acc * pow10[cnt] + swar_digits(word, cnt);
+				}
+				more = cnt == 8;
+			} else if (pos_ == end_ && !refill()) {
+				break;
+			} else {
+				cnt = *pos_ >= '0' && *pos_ <= '9';
+				if (cnt > 0) {
+					acc = acc * 10 + (*pos_ - '0');
+				}
+				more = cnt == 1;
+			}
+			pos_ += cnt;
+			digits += cnt;
+			if (acc > limit) {
+				acc = limit + 1; // stays out of range, but doesn't overflow
+			}
+		}
+
+		if (digits == 0) {
+			failed_ = true;
+			return 0;
+		}
+		if (acc > limit || (!neg && acc == limit)) {
+			failed_ = true;
+			return neg ? INT_MIN : INT_MAX;
+		}
+		return neg ? static_cast<int>(0 - acc) : static_cast<int>(acc);
+	}
+
+	//--------output--------
+
+	output::output()
+	: fd_(STDOUT_FILENO)
+	, format_(format_t::TEXT)
+	, used_(0)
+	{}
+
+	output::~output() {
+		flush();
+	}
+
+	void output::set_format(format_t format) {
+		format_ = format;
+	}
+
+	void output::flush() {
+		const char *pos = buffer_;
+		while (used_ > 0) {
+			ssize_t put = write(fd_, pos, used_);
+			if (put < 0 && errno == EINTR) {
+				continue;
+			}
+			if (put <= 0) {
+				break; // nobody reads it anymore, what is left is dropped
+			}
+			pos += put;
+			used_ -= put;
+		}
+		used_ = 0;
+	}
+
+	void output::write_int(int value) {
+		if (buffer_size - used_ < max_item_size) {
+			flush();
+		}
+		if (format_ == format_t::TEXT) {
+			write_text(value);
+		} else if (format_ == format_t::I32) {
+			int32_t raw = value;
+			memcpy(buffer_ + used_, &raw, sizeof(raw));
+			used_ += sizeof(raw);
+		} else {
+			int64_t raw = value;
+			memcpy(buffer_ + used_, &raw, sizeof(raw));
+			used_ += sizeof(raw);
+		}
+	}
+
+	static const char digit_pairs[] =
+		"00010203040506070809"
+		"10111213141516171819"
+		"20212223242526272829"
+		"30313233343536373839"
+		"40414243444546474849"
+		"50515253545556575859"
+		"60616263646566676869"
+		"70717273747576777879"
+		"80818283848586878889"
+		"90919293949596979899";
+
+	// digits are put from the end of a scratch, two at a time
+	void output::write_text(int value) {
+		char scratch[max_item_size];
+		char *end = scratch + max_item_size, *cur = end;
+		*--cur = '\n';
+		uint32_t mag = value < 0 ? 0u - static_cast<uint32_t>(value) : value;
+		while (mag >= 100) {
+			uint32_t pair = mag % 100;
+			mag /= 100;
+			cur -= 2;
+			memcpy(cur, digit_pairs + 2 * pair, 2);
+		}
+		if (mag >= 10) {
+			cur -= 2;
+			memcpy(cur, digit_pairs + 2 * mag, 2);
+		} else {
+			*--cur = static_cast<char>('0' + mag);
+		}
+		if (value < 0) {
+			*--cur = '-';
+		}
+		memcpy(buffer_ + used_, cur, end - cur);
+		used_ += end - cur;
+	}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cplr {
+
+	class output;
+
+	// integers read by ?: stdin or a file is mapped into memory when it is a
+	// regular file and read by big blocks otherwise; text is parsed like
+	// std::cin >> int does, binary input is raw native-endian integers
+	class input final {
+	public:
+		enum class format_t : unsigned char {
+			TEXT,
+			I32,
+			I64 // wraps around into int
+		};
+
+		input();
+		~input();
+		input(const input&) = delete;
+		input& operator=(const input&) = delete;
+
+		int open(const char *path); // nullptr or - for stdin; 0 on success
+		void set_format(format_t format);
+		int read_int(); // 0 once the input is over or malformed
+		void tie(output *out); // out is flushed before waiting for more input
+
+	private:
+		bool refill(); // false if nothing is left
+		int read_text();
+		bool read_raw(unsigned char *dst, size_t size);
+		void close();
+
+		int fd_;
+		bool own_fd_;
+		format_t format_;
+		const char *pos_;
+		const char *end_;
+		void *map_;
+		size_t map_size_;
+		std::vector<char> buffer_;
+		bool eof_;
+		bool failed_; // like failbit of std::cin: nothing is read after it
+		output *tied_;
+	};
+
+	// integers written by print go to stdout through a buffer of its own; it
+	// is written out when it is full, by flush and when output is destroyed,
+	// so the owner flushes it before reporting errors
+	class output final {
+	public:
+		using format_t = input::format_t; // binary integers have no separators
+
+		output();
+		~output();
+		output(const output&) = delete;
+		output& operator=(const output&) = delete;
+
+		void set_format(format_t format);
+		void write_int(int value);
+		void flush();
+
+	private:
+		static const size_t buffer_size = 1 << 16;
+		static const size_t max_item_size = 12; // -2147483648 and a newline
+
+		void write_text(int value);
+
+		int fd_;
+		format_t format_;
+		size_t used_;
+		char buffer_[buffer_size];
+	};
+
+}
@@ -0,0 +1,547 @@
+#include "ir.h"
+
+#include <utility>
+
+namespace cplr {
+
+	//--------ir--------
+
+	const uint32_t ir::none;
+
+	ir::ir() {}
+
+	void ir::clear() {
+		instrs_.clear();
+		blocks_.clear();
+		consts_.clear();
+	}
+
+	ir::block_t ir::make_block() {
+		block blk;
+		blk.term_ = term_t::HALT;
+		blk.cond_ = none;
+		blk.succ_[0] = blk.succ_[1] = none;
+		blk.id_ = 0;
+		blocks_.push_back(std::move(blk));
+		return static_cast<block_t>(blocks_.size() - 1);
+	}
+
+	// constants are shared, so they are equal exactly when their values are
+	ir::value_t ir::make_const(int val) {
+		auto it = consts_.find(val);
+		if (it != consts_.end()) {
+			return it->second;
+		}
+		instrs_.push_back({op_t::CONST, none, val, {}});
+		value_t v = static_cast<value_t>(instrs_.size() - 1);
+		consts_.emplace(val, v);
+		return v;
+	}
+
+	ir::value_t ir::add(block_t b, op_t op, std::vector<value_t> args) {
+		instrs_.push_back({op, b, 0, std::move(args)});
+		value_t v = static_cast<value_t>(instrs_.size() - 1);
+		blocks_[b].code_.push_back(v);
+		return v;
+	}
+
+	ir::value_t ir::add_phi(block_t b, std::vector<value_t> args) {
+		instrs_.push_back({op_t::PHI, b, 0, std::move(args)});
+		value_t v = static_cast<value_t>(instrs_.size() - 1);
+		blocks_[b].phis_.push_back(v);
+		return v;
+	}
+
+	void ir::jump(block_t from, block_t to) {
+		blocks_[from].term_ = term_t::JMP;
+		blocks_[from].succ_[0] = to;
+		blocks_[to].preds_.push_back(from);
+	}
+
+	void ir::branch(block_t from, value_t cond, block_t then_b, block_t else_b) {
+		blocks_[from].term_ = term_t::BR;
+		blocks_[from].cond_ = cond;
+		blocks_[from].succ_[0] = then_b;
+		blocks_[from].succ_[1] = else_b;
+		blocks_[then_b].preds_.push_back(from);
+		blocks_[else_b].preds_.push_back(from);
+	}
+
+	void ir::remove_pred(block_t b, size_t i) {
+		block& blk = blocks_[b];
+		blk.preds_.erase(blk.preds_.begin() + i);
+		for (auto phi : blk.phis_) {
+			if (instrs_[phi].op_ == op_t::PHI) { // not one a pass has removed yet
+				instrs_[phi].args_.erase(instrs_[phi].args_.begin() + i);
+			}
+		}
+	}
+
+	void ir::retarget(block_t from, block_t to) {
+		block& blk = blocks_[from];
+		block_t other = blk.succ_[0] == to ? blk.succ_[1] : blk.succ_[0];
+		blk.term_ = term_t::JMP;
+		blk.cond_ = none;
+		blk.succ_[0] = to;
+		blk.succ_[1] = none;
+		const std::vector<block_t>& preds = blocks_[other].preds_;
+		for (size_t i = 0; i < preds.size(); ++i) {
+			if (preds[i] == from) {
+				remove_pred(other, i);
+				break;
+			}
+		}
+	}
+
+	bool ir::is_const(value_t v) const {
+		return instrs_[v].op_ == op_t::CONST;
+	}
+
+	// division is pure only by a nonzero constant, otherwise it may stop the
+	// program and has to stay where it is; divn and remn can be dropped but
+	// not moved above the branches their divisor is known safe by
+	bool ir::is_pure(value_t v) const {
+		const instr& in = instrs_[v];
+		if (in.op_ == op_t::SCAN || in.op_ == op_t::PRINT) {
+			return false;
+		} else if (in.op_ == op_t::DIV || in.op_ == op_t::REM) {
+			return is_const(in.args_[1]) && instrs_[in.args_[1]].val_ != 0;
+		}
+		return true;
+	}
+
+	size_t ir::successors(block_t b) const {
+		if (blocks_[b].term_ == term_t::JMP) {
+			return 1;
+		}
+		return blocks_[b].term_ == term_t::BR ? 2 : 0;
+	}
+
+	// the else successor is visited first, so the then one and a loop body
+	// come right after their block and the code after a loop after the body
+	std::vector<ir::block_t> ir::order() const {
+		std::vector<block_t> post;
+		if (blocks_.empty()) {
+			return post;
+		}
+		std::vector<unsigned char> seen(blocks_.size(), 0);
+		std::vector<std::pair<block_t, size_t>> stack; // block, successors left
+		stack.push_back({0, successors(0)});
+		seen[0] = 1;
+		while (!stack.empty()) {
+			auto& top = stack.back();
+			if (top.second == 0) {
+				post.push_back(top.first);
+				stack.pop_back();
+				continue;
+			}
+			block_t next = blocks_[top.first].succ_[--top.second];
+			if (!seen[next]) {
+				seen[next] = 1;
+				stack.push_back({next, successors(next)});
+			}
+		}
+		return std::vector<block_t>(post.rbegin(), post.rend());
+	}
+
+	// values are shown as v and the index, constants by their values
+	void ir::dump(std::ostream& os) const {
+		static const char *op_names[] = {
+			"const", "phi", "scan", "print", "not", "neg", "eq", "ne", "lt", "le",
+			"ge", "gt", "add", "sub", "mul", "div", "rem", "divn", "remn", "and", "or",
+			"nop"
+		};
+		auto show = [&](value_t v) {
+			if (is_const(v)) {
+				os << instrs_[v].val_;
+			} else {
+				os << 'v' << v;
+			}
+		};
+		for (auto b : order()) {
+			const block& blk = blocks_[b];
+			os << 'b' << b << ':';
+			if (!blk.preds_.empty()) {
+				os << "\t; preds";
+				for (auto p : blk.preds_) {
+					os << " b" << p;
+				}
+			}
+			os << '\n';
+			for (int part = 0; part < 2; ++part) {
+				for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+					const instr& in = instrs_[v];
+					os << '\t';
+					if (in.op_ != op_t::PRINT) {
+						os << 'v' << v << " = ";
+					}
+					os << op_names[static_cast<size_t>(in.op_)];
+					for (size_t i = 0; i < in.args_.size(); ++i) {
+						os << (i == 0 ? " " : ", ");
+						show(in.args_[i]);
+					}
+					os << '\n';
+				}
+			}
+			switch (blk.term_) {
+				case term_t::JMP:
+					os << "\tjmp b" << blk.succ_[0] << '\n';
+					break;
+				case term_t::BR:
+					os << "\tbr ";
+					show(blk.cond_);
+					os << ", b" << blk.succ_[0] << ", b" << blk.succ_[1] << '\n';
+					break;
+				case term_t::HALT:
+					os << "\thalt\n";
+					break;
+				case term_t::UNDEF:
+					os << "\tundef " << blk.id_ << '\n';
+					break;
+			}
+		}
+	}
+
+	//--------ir_builder--------
+
+	ir_builder::ir_builder(const ast& tree, ir& code)
+	: tree_(tree)
+	, code_(code)
+	, cur_(0)
+	, declined_(false)
+	{}
+
+	int ir_builder::build() {
+		code_.clear();
+		defs_.clear();
+		incomplete_.clear();
+		sealed_.clear();
+		replaced_.clear();
+		declined_ = false;
+		cur_ = make_block(true);
+		lower_stmt(tree_.root());
+		code_.blocks_[cur_].term_ = ir::term_t::HALT;
+		finish();
+		return declined_ ? -1 : 0;
+	}
+
+	ir_builder::block_t ir_builder::make_block(bool sealed) {
+		defs_.emplace_back();
+		incomplete_.emplace_back();
+		sealed_.push_back(sealed);
+		return code_.make_block();
+	}
+
+	void ir_builder::seal(block_t b) {
+		sealed_[b] = 1;
+		auto pending = std::move(incomplete_[b]);
+		incomplete_[b].clear();
+		for (auto& it : pending) {
+			add_phi_args(it.first, it.second);
+		}
+	}
+
+	void ir_builder::write(size_t id, block_t b, value_t v) {
+		defs_[b][id] = v;
+	}
+
+	ir_builder::value_t ir_builder::read(size_t id, block_t b) {
+		auto it = defs_[b].find(id);
+		if (it != defs_[b].end()) {
+			return find(it->second);
+		}
+		return read_recursive(id, b);
+	}
+
+	// a block with no predecessors is the entry or follows an undefined read,
+	// nothing read there is ever seen, see ast::resolve
+	ir_builder::value_t ir_builder::read_recursive(size_t id, block_t b) {
+		value_t v;
+		if (!sealed_[b]) {
+			v = code_.add_phi(b, {});
+			incomplete_[b].push_back({id, v});
+		} else if (code_.blocks_[b].preds_.empty()) {
+			v = code_.make_const(0);
+		} else if (code_.blocks_[b].preds_.size() == 1) {
+			v = read(id, code_.blocks_[b].preds_[0]);
+		} else {
+			v = code_.add_phi(b, {});
+			write(id, b, v); // breaks cycles through loops
+			v = add_phi_args(id, v);
+		}
+		write(id, b, v);
+		return v;
+	}
+
+	ir_builder::value_t ir_builder::add_phi_args(size_t id, value_t phi) {
+		block_t b = code_.instrs_[phi].block_;
+		for (size_t i = 0; i < code_.blocks_[b].preds_.size(); ++i) {
+			value_t arg = read(id, code_.blocks_[b].preds_[i]);
+			code_.instrs_[phi].args_.push_back(arg);
+		}
+		return remove_trivial(phi);
+	}
+
+	// phis using a dropped one are left for finish
+	ir_builder::value_t ir_builder::remove_trivial(value_t phi) {
+		value_t same = ir::none;
+		for (auto arg : code_.instrs_[phi].args_) {
+			arg = find(arg);
+			if (arg == same || arg == phi) {
+				continue;
+			} else if (same != ir::none) {
+				return phi;
+			}
+			same = arg;
+		}
+		if (same == ir::none) { // only reached from itself
+			same = code_.make_const(0);
+		}
+		if (replaced_.size() <= phi) {
+			replaced_.resize(code_.instrs_.size(), ir::none);
+		}
+		replaced_[phi] = same;
+		return same;
+	}
+
+	ir_builder::value_t ir_builder::find(value_t v) {
+		while (v < replaced_.size() && replaced_[v] != ir::none) {
+			v = replaced_[v];
+		}
+		return v;
+	}
+
+	// drops phis which became trivial when their arguments were dropped and
+	// puts what is left in place of the dropped ones
+	void ir_builder::finish() {
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto& blk : code_.blocks_) {
+				for (auto phi : blk.phis_) {
+					if (find(phi) == phi && remove_trivial(phi) != phi) {
+						changed = true;
+					}
+				}
+			}
+		}
+		for (auto& blk : code_.blocks_) {
+			size_t kept = 0;
+			for (auto phi : blk.phis_) {
+				if (find(phi) == phi) {
+					blk.phis_[kept++] = phi;
+				} else {
+					code_.instrs_[phi].op_ = ir::op_t::NOP;
+					code_.instrs_[phi].args_.clear();
+				}
+			}
+			blk.phis_.resize(kept);
+			if (blk.cond_ != ir::none) {
+				blk.cond_ = find(blk.cond_);
+			}
+		}
+		for (auto& in : code_.instrs_) {
+			for (auto& arg : in.args_) {
+				arg = find(arg);
+			}
+		}
+	}
+
+	// scopes are resolved by ast::resolve, so identifiers only get values:
+	// every one is defined where it is read; whiles checking identifiers at
+	// run time are left for compiler
+	void ir_builder::lower_stmt(idx_t nd) {
+		const ast::node& node = tree_[nd];
+		if (node.type_ == node_t::SCOPE) {
+			const idx_t *it = tree_.list(node.first_);
+			for (idx_t i = 0, ie = node.count_; i < ie; ++i) {
+				lower_stmt(it[i]);
+			}
+		} else if (node.type_ == node_t::IF) {
+			block_t then_b = make_block(false), else_b = make_block(false);
+			lower_branch(node.cond_, then_b, else_b);
+			seal(then_b);
+			cur_ = then_b;
+			lower_stmt(node.body_);
+			if (tree_[node.else_].type_ == node_t::EMPTY) {
+				code_.jump(cur_, else_b);
+				seal(else_b);
+				cur_ = else_b;
+			} else {
+				seal(else_b);
+				block_t then_end = cur_;
+				cur_ = else_b;
+				lower_stmt(node.else_);
+				block_t join = make_block(false);
+				code_.jump(then_end, join);
+				code_.jump(cur_, join);
+				seal(join);
+				cur_ = join;
+			}
+		} else if (node.type_ == node_t::WHILE) {
+			if (node.val_ > 0) {
+				declined_ = true;
+			}
+			block_t top = make_block(false);
+			code_.jump(cur_, top);
+			cur_ = top;
+			block_t body = make_block(false), exit = make_block(false);
+			lower_branch(node.cond_, body, exit);
+			seal(body);
+			seal(exit);
+			cur_ = body;
+			lower_stmt(node.body_);
+			code_.jump(cur_, top);
+			seal(top);
+			cur_ = exit;
+		} else if (node.type_ == node_t::DO) {
+			block_t top = make_block(false);
+			code_.jump(cur_, top);
+			cur_ = top;
+			lower_stmt(node.body_);
+			block_t exit = make_block(false);
+			lower_branch(node.cond_, top, exit);
+			seal(top);
+			seal(exit);
+			cur_ = exit;
+		} else if (node.type_ != node_t::EMPTY) {
+			lower_prnt(nd);
+		}
+	}
+
+	void ir_builder::lower_prnt(idx_t nd) {
+		if (tree_[nd].type_ == node_t::PRINT) {
+			value_t v = lower_right(tree_[nd].rhs_);
+			code_.add(cur_, ir::op_t::PRINT, {v});
+		} else if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			lower_lval(nd);
+		} else {
+			lower_right(nd);
+		}
+	}
+
+	ir_builder::value_t ir_builder::lower_right(idx_t nd) {
+		if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			lower_lval(nd);
+			return read(tree_[nd].val_, cur_);
+		} else if (tree_.is_assignment(nd)) {
+			idx_t lhs = tree_[nd].lhs_;
+			lower_lval(lhs);
+			value_t v = lower_expr(tree_[nd].rhs_);
+			write(tree_[lhs].val_, cur_, v);
+			return v;
+		}
+		return lower_expr(nd);
+	}
+
+	void ir_builder::lower_lval(idx_t nd) {
+		if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+			declined_ = true;
+		} else if (tree_.bind(nd) == ast::bind_t::UNDEFINED) {
+			write(tree_[nd].val_, cur_, code_.make_const(0));
+		}
+	}
+
+	ir_builder::value_t ir_builder::lower_expr(idx_t nd) {
+		const ast::node& node = tree_[nd];
+		if (node.type_ == node_t::UNARY_OPERATION) {
+			value_t v = lower_expr(node.rhs_);
+			bool is_not = tree_.unop(nd) == unOp_t::LOGICAL_NEGATION;
+			return code_.add(cur_, is_not ? ir::op_t::NOT : ir::op_t::NEG, {v});
+		} else if (node.type_ == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			if (op == binOp_t::OR || op == binOp_t::AND) {
+				return lower_logical(nd);
+			} else if (op == binOp_t::ASSIGNMENT) { // to a temporary, see optimizer
+				return lower_right(nd);
+			}
+			value_t lhs = lower_expr(node.lhs_);
+			value_t rhs = lower_expr(node.rhs_);
+			ir::op_t ir_op = ir::op_t::NOP;
+			switch (op) {
+				case binOp_t::EQUAL: ir_op = ir::op_t::EQ; break;
+				case binOp_t::NOT_EQUAL: ir_op = ir::op_t::NE; break;
+				case binOp_t::LESS: ir_op = ir::op_t::LT; break;
+				case binOp_t::LESS_OR_EQUAL: ir_op = ir::op_t::LE; break;
+				case binOp_t::GREATER_OR_EQUAL: ir_op = ir::op_t::GE; break;
+				case binOp_t::GREATER: ir_op = ir::op_t::GT; break;
+				case binOp_t::ADDITION: ir_op = ir::op_t::ADD; break;
+				case binOp_t::SUBSTRACTION: ir_op = ir::op_t::SUB; break;
+				case binOp_t::MULTIPLICATION: ir_op = ir::op_t::MUL; break;
+				case binOp_t::DIVISION: ir_op = ir::op_t::DIV; break;
+				case binOp_t::REMAINDER: ir_op = ir::op_t::REM; break;
+				default: break;
+			}
+			return code_.add(cur_, ir_op, {lhs, rhs});
+		} else if (node.type_ == node_t::IDENTIFIER) {
+			if (tree_.bind(nd) == ast::bind_t::DEFINED) {
+				return read(node.val_, cur_);
+			} else if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+				declined_ = true;
+			} else { // the program stops here, what follows is never reached
+				code_.blocks_[cur_].term_ = ir::term_t::UNDEF;
+				code_.blocks_[cur_].id_ = node.val_;
+				cur_ = make_block(true);
+			}
+			return code_.make_const(0);
+		} else if (node.type_ == node_t::INTEGER_LITERAL) {
+			return code_.make_const(node.val_);
+		} else if (node.type_ == node_t::SCAN) {
+			return code_.add(cur_, ir::op_t::SCAN, {});
+		}
+		return code_.make_const(node.type_ == node_t::BOOL_TRUE);
+	}
+
+	// the value of && and || is chosen by a phi at the join of its branches
+	ir_builder::value_t ir_builder::lower_logical(idx_t nd) {
+		block_t then_b = make_block(false), else_b = make_block(false);
+		lower_branch(nd, then_b, else_b);
+		seal(then_b);
+		seal(else_b);
+		block_t join = make_block(false);
+		code_.jump(then_b, join);
+		code_.jump(else_b, join);
+		seal(join);
+		cur_ = join;
+		return code_.add_phi(join, {code_.make_const(1), code_.make_const(0)});
+	}
+
+	// ends the current block by jumps to then_b when the value of nd converted
+	// to bool is true and to else_b otherwise, && and || become branches
+	void ir_builder::lower_branch(idx_t nd, block_t then_b, block_t else_b) {
+		const ast::node& node = tree_[nd];
+		if (
+			node.type_ == node_t::UNARY_OPERATION && \
+			tree_.unop(nd) == unOp_t::LOGICAL_NEGATION
+		) {
+			lower_branch(node.rhs_, else_b, then_b);
+			return;
+		} else if (node.type_ == node_t::BINARY_OPERATION) {
+			bool is_and = tree_.binop(nd) == binOp_t::AND;
+			if (is_and || tree_.binop(nd) == binOp_t::OR) {
+				block_t next = make_block(false);
+				if (is_and) {
+					lower_branch(node.lhs_, next, else_b);
+				} else {
+					lower_branch(node.lhs_, then_b, next);
+				}
+				seal(next);
+				cur_ = next;
+				lower_branch(node.rhs_, then_b, else_b);
+				return;
+			}
+		} else if (
+			node.type_ == node_t::INTEGER_LITERAL || node.type_ == node_t::BOOL_TRUE || \
+			node.type_ == node_t::BOOL_FALSE
+		) {
+			bool value = node.type_ == node_t::BOOL_TRUE || (
+				node.type_ == node_t::INTEGER_LITERAL && node.val_ != 0
+			);
+			code_.jump(cur_, value ? then_b : else_b);
+			return;
+		}
+		value_t cond = lower_expr(nd);
+		code_.branch(cur_, cond, then_b, else_b);
+	}
+
+}
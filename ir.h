@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast.h"
+#include "types_decl.h"
+
+namespace cplr {
+
+	// a program as a control flow graph of basic blocks in SSA form: every
+	// value is defined by one instruction, values of an identifier meeting at
+	// joins of if, while and do are chosen by phis, and ? and print are
+	// instructions of their own, so passes see every side effect in order
+	class ir final {
+	public:
+		using value_t = uint32_t; // index of the defining instruction
+		using block_t = uint32_t;
+		static const uint32_t none = UINT32_MAX;
+
+		enum class op_t : unsigned char {
+			CONST, // val_, belongs to no block
+			PHI, // an argument by predecessor, in the order of preds_
+			SCAN, // ?
+			PRINT, // has no value
+			NOT, // !
+			NEG, // unary -
+			EQ,
+			NE,
+			LT,
+			LE,
+			GE,
+			GT,
+			ADD,
+			SUB,
+			MUL,
+			DIV, // fails on division by zero
+			REM,
+			DIVN, // the divisor is known to be safe, see range_analysis
+			REMN,
+			AND, // of booleans, 0 or 1
+			OR,
+			NOP // removed by a pass
+		};
+
+		enum class term_t : unsigned char {
+			JMP, // to succ_[0]
+			BR, // to succ_[0] if cond_ is nonzero and to succ_[1] otherwise
+			HALT,
+			UNDEF // reads undefined identifier id_, stops the program
+		};
+
+		struct instr {
+			op_t op_;
+			block_t block_;
+			int val_; // CONST
+			std::vector<value_t> args_;
+		};
+
+		struct block {
+			std::vector<value_t> phis_;
+			std::vector<value_t> code_; // the rest of the instructions, in order
+			std::vector<block_t> preds_;
+			term_t term_;
+			value_t cond_; // BR
+			block_t succ_[2];
+			size_t id_; // UNDEF
+		};
+
+		ir();
+		void clear();
+		block_t make_block();
+		value_t make_const(int val);
+		value_t add(block_t b, op_t op, std::vector<value_t> args);
+		value_t add_phi(block_t b, std::vector<value_t> args);
+		void jump(block_t from, block_t to);
+		void branch(block_t from, value_t cond, block_t then_b, block_t else_b);
+		void remove_pred(block_t b, size_t i); // with the phi arguments
+		void retarget(block_t from, block_t to); // BR becomes JMP to to
+
+		bool is_const(value_t v) const;
+		bool is_pure(value_t v) const; // can be dropped or moved
+		size_t successors(block_t b) const;
+		std::vector<block_t> order() const; // reachable blocks, in reverse postorder
+		void dump(std::ostream& os) const;
+
+		std::vector<instr> instrs_;
+		std::vector<block> blocks_; // the entry is the first one
+
+	private:
+		std::unordered_map<int, value_t> consts_;
+	};
+
+	// lowers a resolved tree, see ast::resolve, building SSA at once as in
+	// Braun et al., "Simple and Efficient Construction of Static Single
+	// Assignment Form": an identifier read in a block with several
+	// predecessors gets a phi, which is dropped when it chooses one value only
+	class ir_builder final {
+	public:
+		ir_builder(const ast& tree, ir& code);
+		int build(); // -1 if an identifier has to be checked at run time
+
+	private:
+		using idx_t = ast::idx_t;
+		using value_t = ir::value_t;
+		using block_t = ir::block_t;
+
+		block_t make_block(bool sealed);
+		void seal(block_t b);
+		void write(size_t id, block_t b, value_t v);
+		value_t read(size_t id, block_t b);
+		value_t read_recursive(size_t id, block_t b);
+		value_t add_phi_args(size_t id, value_t phi);
+		value_t remove_trivial(value_t phi);
+		value_t find(value_t v);
+		void finish();
+
+		void lower_stmt(idx_t nd);
+		void lower_prnt(idx_t nd);
+		value_t lower_right(idx_t nd);
+		void lower_lval(idx_t nd);
+		value_t lower_expr(idx_t nd);
+		value_t lower_logical(idx_t nd);
+		void lower_branch(idx_t nd, block_t then_b, block_t else_b);
+
+		const ast& tree_;
+		ir& code_;
+		block_t cur_;
+		bool declined_;
+		std::vector<std::unordered_map<size_t, value_t>> defs_; // by block
+		std::vector<std::vector<std::pair<size_t, value_t>>> incomplete_;
+		std::vector<unsigned char> sealed_; // all predecessors are known
+		std::vector<value_t> replaced_; // by value, phis dropped for another
+	};
+
+}
@@ -0,0 +1,481 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include <sys/mman.h>
+
+namespace cplr {
+
+	//--------jit--------
+	//
+	//	The generated function takes the frame in rdi and keeps it in rbx: the
+	//	jit object at [rbx], identifiers, one byte by identifier telling if it
+	//	is defined and the operand stack below the registers. The top values of
+	//	the stack are in callee-saved registers, so calls into the runtime keep
+	//	them, and rax, rcx and rdx are scratch. A division by zero or reading
+	//	an undefined identifier jumps to an exit which reports it.
+
+	using namespace x86;
+
+	static const int slot_regs[] = {RBP, R12, R13, R14, R15};
+	static const size_t reg_slots = sizeof(slot_regs) / sizeof(slot_regs[0]);
+
+	static int stack_effect(opcode op) {
+		switch (op) {
+			case opcode::PUSH: case opcode::DUP: case opcode::LOAD:
+			case opcode::LOADC: case opcode::SCAN:
+				return 1;
+			case opcode::POP: case opcode::STORE: case opcode::PRINT:
+			case opcode::JZ: case opcode::JNZ:
+			case opcode::EQ: case opcode::NE: case opcode::LT: case opcode::LE:
+			case opcode::GE: case opcode::GT: case opcode::ADD: case opcode::SUB:
+			case opcode::MUL: case opcode::DIV: case opcode::REM: case opcode::DIVN:
+			case opcode::REMN: case opcode::AND: case opcode::OR:
+				return -1;
+			case opcode::JEQ: case opcode::JNE: case opcode::JLT: case opcode::JLE:
+			case opcode::JGE: case opcode::JGT:
+				return -2;
+			default:
+				return 0;
+		}
+	}
+
+	static int cc_of(opcode op) {
+		switch (op) {
+			case opcode::EQ: case opcode::JEQ: return E;
+			case opcode::NE: case opcode::JNE: return NE;
+			case opcode::LT: case opcode::JLT: return L;
+			case opcode::LE: case opcode::JLE: return LE;
+			case opcode::GE: case opcode::JGE: return GE;
+			default: return G; // opcode::GT, opcode::JGT
+		}
+	}
+
+	jit::jit(input& in, output& out)
+	: in_(in)
+	, out_(out)
+	, entries_{
+		reinterpret_cast<uint64_t>(&jit::scan),
+		reinterpret_cast<uint64_t>(&jit::print),
+		reinterpret_cast<uint64_t>(&jit::fail)
+	}
+	, vars_at_(0)
+	, live_at_(0)
+	, deep_at_(0)
+	, mem_(nullptr)
+	, mem_size_(0)
+	{}
+
+	jit::~jit() {
+		if (mem_ != nullptr) {
+			munmap(mem_, mem_size_);
+		}
+	}
+
+	void jit::link(const entries& calls) {
+		entries_ = calls;
+	}
+
+	int jit::compile(const bytecode& bc) {
+#ifndef __x86_64__
+		return -1; // the code is for x86-64 only
+#endif
+		generate(bc);
+		if (mem_ != nullptr) {
+			munmap(mem_, mem_size_);
+		}
+		const std::vector<unsigned char>& code = as_.code();
+		mem_size_ = code.size();
+		mem_ = mmap(
+			nullptr, mem_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+		);
+		if (mem_ == MAP_FAILED) {
+			mem_ = nullptr;
+			return -1;
+		}
+		std::memcpy(mem_, code.data(), mem_size_);
+		if (mprotect(mem_, mem_size_, PROT_READ | PROT_EXEC) != 0) {
+			munmap(mem_, mem_size_);
+			mem_ = nullptr;
+			return -1;
+		}
+		return 0;
+	}
+
+	// the code depends on where it is put only through the entries it calls
+	void jit::generate(const bytecode& bc) {
+		size_t n = bc.code_.size();
+		std::vector<size_t> depths(n, SIZE_MAX); // of the stack, SIZE_MAX if unreached
+		std::vector<size_t> work;
+		if (n > 0) {
+			depths[0] = 0;
+			work.push_back(0);
+		}
+		while (!work.empty()) {
+			size_t at = work.back();
+			work.pop_back();
+			const instr& in = bc.code_[at];
+			size_t depth = depths[at] + stack_effect(in.op);
+			size_t next[2] = {SIZE_MAX, SIZE_MAX};
+			if (is_jump(in.op)) {
+				next[0] = static_cast<size_t>(in.arg);
+			}
+			bool stops = in.op == opcode::HALT || in.op == opcode::UNDEF;
+			if (!stops && in.op != opcode::JMP) {
+				next[1] = at + 1;
+			}
+			for (auto it : next) {
+				if (it < n && depths[it] == SIZE_MAX) {
+					depths[it] = depth;
+					work.push_back(it);
+				}
+			}
+		}
+
+		size_t ids = bc.id_count_;
+		size_t deep = bc.stack_size_ > reg_slots ? bc.stack_size_ - reg_slots : 0;
+		vars_at_ = 8;
+		live_at_ = static_cast<int32_t>(vars_at_ + 4 * ids);
+		deep_at_ = static_cast<int32_t>((live_at_ + ids + 3) & ~size_t(3));
+		frame_.assign((deep_at_ + 4 * deep + 7) / 8, 0);
+		frame_[0] = reinterpret_cast<uint64_t>(this);
+
+		as_.clear();
+		labels_.assign(n, 0);
+		jumps_.clear();
+		undefs_.clear();
+		zeros_.clear();
+		as_.push_reg(RBX, false);
+		for (auto reg : slot_regs) {
+			as_.push_reg(reg, false);
+		}
+		as_.op_rm(0x83, 5, {false, RSP, 0}, true); // sub rsp, 8 aligns the stack
+		as_.byte(8);
+		as_.op_rm(0x8B, RBX, {false, RDI, 0}, true);
+		for (size_t at = 0; at < n; ++at) {
+			labels_[at] = as_.size();
+			if (depths[at] != SIZE_MAX) {
+				compile_instr(bc, at, depths[at]);
+			}
+		}
+		for (int error = UNDEFINED; error <= DIVISION_BY_ZERO; ++error) {
+			const std::vector<size_t>& from = error == UNDEFINED ? undefs_ : zeros_;
+			if (from.empty()) {
+				continue;
+			}
+			for (auto at : from) {
+				as_.bind(at);
+			}
+			as_.mov_imm({false, RSI, 0}, error);
+			compile_call(entries_.fail);
+			compile_exit();
+		}
+		for (auto& it : jumps_) {
+			as_.patch(it.first, labels_[it.second]);
+		}
+	}
+
+	int jit::run() {
+		if (mem_ == nullptr) {
+			return -1;
+		}
+		using entry_t = int (*)(uint64_t *frame);
+		return reinterpret_cast<entry_t>(mem_)(frame_.data());
+	}
+
+	// the identifiers are copied into the frame and back
+	int jit::run(std::vector<int>& vars, std::vector<unsigned char>& live) {
+		if (mem_ == nullptr) {
+			return -1;
+		}
+		unsigned char *frame = reinterpret_cast<unsigned char *>(frame_.data());
+		size_t ids = std::min(vars.size(), static_cast<size_t>(live_at_ - vars_at_) / 4);
+		std::memcpy(frame + vars_at_, vars.data(), 4 * ids);
+		std::memcpy(frame + live_at_, live.data(), ids);
+		int result = run();
+		std::memcpy(vars.data(), frame + vars_at_, 4 * ids);
+		std::memcpy(live.data(), frame + live_at_, ids);
+		return result;
+	}
+
+	size_t jit::code_size() const {
+		return as_.size();
+	}
+
+	const std::vector<unsigned char>& jit::code() const {
+		return as_.code();
+	}
+
+	size_t jit::frame_size() const {
+		return 8 * frame_.size();
+	}
+
+	//--------runtime--------
+
+	int jit::scan(jit *self) {
+		return self->in_.read_int();
+	}
+
+	void jit::print(jit *self, int value) {
+		self->out_.write_int(value);
+	}
+
+	int jit::fail(jit *self, int error) {
+		self->out_.flush();
+		if (error == UNDEFINED) {
+			std::cerr << "Undefined identifier\n";
+		} else {
+			std::cerr << "Division by zero\n";
+		}
+		return -2;
+	}
+
+	//--------code generation--------
+
+	jit::operand jit::slot(size_t depth) const {
+		if (depth < reg_slots) {
+			return {false, slot_regs[depth], 0};
+		}
+		return {true, RBX, static_cast<int32_t>(deep_at_ + 4 * (depth - reg_slots))};
+	}
+
+	jit::operand jit::var(int id) const {
+		return {true, RBX, vars_at_ + 4 * id};
+	}
+
+	int32_t jit::live(int id) const {
+		return live_at_ + id;
+	}
+
+	// depth is that of the stack before in runs
+	void jit::compile_instr(const bytecode& bc, size_t at, size_t depth) {
+		const instr& in = bc.code_[at];
+		switch (in.op) {
+			case opcode::HALT:
+				as_.op_rm(0x33, RAX, {false, RAX, 0}); // xor eax, eax
+				compile_exit();
+				break;
+			case opcode::PUSH:
+				as_.mov_imm(slot(depth), in.arg);
+				break;
+			case opcode::POP:
+				break;
+			case opcode::DUP:
+				as_.mov(slot(depth), slot(depth - 1));
+				break;
+			case opcode::LOADC:
+				as_.op_rm(0x80, 7, {true, RBX, live(in.arg)}); // cmp byte [live], 0
+				as_.byte(0);
+				undefs_.push_back(as_.jump(E));
+				as_.mov(slot(depth), var(in.arg));
+				break;
+			case opcode::LOAD:
+				as_.mov(slot(depth), var(in.arg));
+				break;
+			case opcode::STORE:
+				as_.mov(var(in.arg), slot(depth - 1));
+				break;
+			case opcode::DEFINE: case opcode::DECL: {
+				size_t defined = 0;
+				if (in.op == opcode::DECL) {
+					as_.op_rm(0x80, 7, {true, RBX, live(in.arg)});
+					as_.byte(0);
+					defined = as_.jump(NE);
+				}
+				as_.mov_imm(var(in.arg), 0);
+				as_.op_rm(0xC6, 0, {true, RBX, live(in.arg)}); // mov byte [live], 1
+				as_.byte(1);
+				if (in.op == opcode::DECL) {
+					as_.bind(defined);
+				}
+				break;
+			}
+			case opcode::KILL:
+				as_.op_rm(0xC6, 0, {true, RBX, live(in.arg)});
+				as_.byte(0);
+				break;
+			case opcode::UNDEF:
+				undefs_.push_back(as_.jump(ALWAYS));
+				break;
+			case opcode::SCAN:
+				compile_call(entries_.scan);
+				store(depth, RAX);
+				break;
+			case opcode::PRINT:
+				as_.mov({false, RSI, 0}, slot(depth - 1));
+				compile_call(entries_.print);
+				break;
+			case opcode::NOT: {
+				int reg = load(depth - 1, RAX);
+				as_.op_rm(0x85, reg, {false, reg, 0}); // test
+				as_.set_cc(E, reg);
+				store(depth - 1, reg);
+				break;
+			}
+			case opcode::NEG:
+				as_.op_rm(0xF7, 3, slot(depth - 1));
+				break;
+			case opcode::DIV: case opcode::REM: case opcode::DIVN: case opcode::REMN:
+				compile_division(in.op, depth);
+				break;
+			case opcode::MULK: {
+				operand top = slot(depth - 1);
+				int reg = top.mem ? RAX : top.reg;
+				as_.op_rm(0x69, reg, top); // imul reg, top, arg
+				as_.imm32(in.arg);
+				store(depth - 1, reg);
+				break;
+			}
+			case opcode::SHLK:
+				as_.op_rm(0xC1, 4, slot(depth - 1));
+				as_.byte(static_cast<unsigned char>(in.arg));
+				break;
+			case opcode::DIVK: case opcode::REMK:
+				compile_by_divisor(bc.divisors_[in.arg], in.op == opcode::REMK, depth);
+				break;
+			case opcode::JMP:
+				jumps_.push_back({as_.jump(ALWAYS), static_cast<size_t>(in.arg)});
+				break;
+			case opcode::JZ: case opcode::JNZ: {
+				operand top = slot(depth - 1);
+				if (top.mem) {
+					as_.op_rm(0x83, 7, top); // cmp dword top, 0
+					as_.byte(0);
+				} else {
+					as_.op_rm(0x85, top.reg, top);
+				}
+				int cc = in.op == opcode::JZ ? E : NE;
+				jumps_.push_back({as_.jump(cc), static_cast<size_t>(in.arg)});
+				break;
+			}
+			case opcode::JEQ: case opcode::JNE: case opcode::JLT: case opcode::JLE:
+			case opcode::JGE: case opcode::JGT: {
+				int reg = load(depth - 2, RAX);
+				as_.op_rm(0x3B, reg, slot(depth - 1)); // cmp
+				jumps_.push_back({as_.jump(cc_of(in.op)), static_cast<size_t>(in.arg)});
+				break;
+			}
+			default:
+				compile_binary(in.op, depth);
+				break;
+		}
+	}
+
+	void jit::compile_binary(opcode op, size_t depth) {
+		int reg = load(depth - 2, RAX);
+		operand rhs = slot(depth - 1);
+		switch (op) {
+			case opcode::ADD: as_.op_rm(0x03, reg, rhs); break;
+			case opcode::SUB: as_.op_rm(0x2B, reg, rhs); break;
+			case opcode::AND: as_.op_rm(0x23, reg, rhs); break;
+			case opcode::OR: as_.op_rm(0x0B, reg, rhs); break;
+			case opcode::MUL: as_.op_rm2(0xAF, reg, rhs); break; // imul
+			default: // a comparison
+				as_.op_rm(0x3B, reg, rhs);
+				as_.set_cc(cc_of(op), reg);
+				break;
+		}
+		store(depth - 2, reg);
+	}
+
+	// idiv faults on INT_MIN / -1, which wraps around to INT_MIN instead, so
+	// -1 is taken apart unless the divisor is known to be safe
+	void jit::compile_division(opcode op, size_t depth) {
+		bool rem = op == opcode::REM || op == opcode::REMN;
+		if (op == opcode::DIVN || op == opcode::REMN) {
+			as_.mov({false, RAX, 0}, slot(depth - 2));
+			as_.byte(0x99); // cdq
+			as_.op_rm(0xF7, 7, slot(depth - 1)); // idiv
+			store(depth - 2, rem ? RDX : RAX);
+			return;
+		}
+		as_.mov({false, RCX, 0}, slot(depth - 1));
+		as_.op_rm(0x85, RCX, {false, RCX, 0});
+		zeros_.push_back(as_.jump(E));
+		as_.mov({false, RAX, 0}, slot(depth - 2));
+		as_.op_rm(0x83, 7, {false, RCX, 0}); // cmp ecx, -1
+		as_.byte(0xFF);
+		size_t by_minus_one = as_.jump(E);
+		as_.byte(0x99);
+		as_.op_rm(0xF7, 7, {false, RCX, 0});
+		size_t done = as_.jump(ALWAYS);
+		as_.bind(by_minus_one);
+		if (rem) {
+			as_.op_rm(0x33, RDX, {false, RDX, 0}); // xor edx, edx
+		} else {
+			as_.op_rm(0xF7, 3, {false, RAX, 0}); // neg eax
+		}
+		as_.bind(done);
+		store(depth - 2, rem ? RDX : RAX);
+	}
+
+	// as div_by and rem_by do
+	void jit::compile_by_divisor(const divisor& dv, bool rem, size_t depth) {
+		as_.mov({false, RCX, 0}, slot(depth - 1));
+		as_.op_rm(0x63, RAX, {false, RCX, 0}, true); // movsxd rax, ecx
+		as_.op_rm(0x69, RAX, {false, RAX, 0}, true); // imul rax, rax, magic
+		as_.imm32(dv.magic);
+		as_.op_rm(0xC1, 7, {false, RAX, 0}, true); // sar rax, 32
+		as_.byte(32);
+		if (dv.d > 0 && dv.magic < 0) {
+			as_.op_rm(0x03, RAX, {false, RCX, 0});
+		} else if (dv.d < 0 && dv.magic > 0) {
+			as_.op_rm(0x2B, RAX, {false, RCX, 0});
+		}
+		if (dv.shift > 0) {
+			as_.op_rm(0xC1, 7, {false, RAX, 0}); // sar eax, shift
+			as_.byte(static_cast<unsigned char>(dv.shift));
+		}
+		as_.mov({false, RDX, 0}, {false, RAX, 0});
+		as_.op_rm(0xC1, 5, {false, RDX, 0}); // shr edx, 31
+		as_.byte(31);
+		as_.op_rm(0x03, RAX, {false, RDX, 0});
+		if (rem) {
+			as_.op_rm(0x69, RAX, {false, RAX, 0}); // imul eax, eax, d
+			as_.imm32(dv.d);
+			as_.op_rm(0x2B, RCX, {false, RAX, 0});
+			store(depth - 1, RCX);
+		} else {
+			store(depth - 1, RAX);
+		}
+	}
+
+	// the first argument is the jit object, the second one is set by the
+	// caller
+	void jit::compile_call(uint64_t fn) {
+		as_.op_rm(0x8B, RDI, {true, RBX, 0}, true); // mov rdi, [rbx]
+		as_.byte(0x48); // mov rax, fn
+		as_.byte(0xB8);
+		for (int i = 0; i < 8; ++i) {
+			as_.byte(static_cast<unsigned char>(fn >> (8 * i)));
+		}
+		as_.byte(0xFF); // call rax
+		as_.byte(0xD0);
+	}
+
+	void jit::compile_exit() {
+		as_.op_rm(0x83, 0, {false, RSP, 0}, true); // add rsp, 8
+		as_.byte(8);
+		for (size_t i = reg_slots; i-- > 0;) {
+			as_.push_reg(slot_regs[i], true);
+		}
+		as_.push_reg(RBX, true);
+		as_.byte(0xC3); // ret
+	}
+
+	int jit::load(size_t depth, int scratch) {
+		operand from = slot(depth);
+		if (!from.mem) {
+			return from.reg;
+		}
+		as_.mov({false, scratch, 0}, from);
+		return scratch;
+	}
+
+	void jit::store(size_t depth, int reg) {
+		as_.mov(slot(depth), {false, reg, 0});
+	}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "compiler.h"
+#include "io.h"
+#include "x86.h"
+
+namespace cplr {
+
+	// compiles bytecode into x86-64 machine code put into executable memory:
+	// the operand stack is known statically at every instruction, so its top
+	// values live in registers and the deeper ones in the frame next to the
+	// identifiers, jumps of the bytecode are native jumps and ? and print
+	// call back into the runtime
+	class jit final {
+	public:
+		enum error_t : int { UNDEFINED, DIVISION_BY_ZERO }; // passed to fail
+
+		// addresses of the runtime called with the first quadword of the frame,
+		// the jit itself unless the code runs elsewhere, see elf_image
+		struct entries {
+			uint64_t scan; // int (void *), ?
+			uint64_t print; // void (void *, int)
+			uint64_t fail; // int (void *, int), reports error_t, returns -2
+		};
+
+		jit(input& in, output& out); // read by SCAN and written by PRINT
+		~jit();
+		jit(const jit&) = delete;
+		jit& operator=(const jit&) = delete;
+
+		void link(const entries& calls);
+		int compile(const bytecode& bc); // -1 if the code can't be mapped
+		void generate(const bytecode& bc); // the code alone, on any host
+		int run(); // 0, or -2 on an error reported as vm::run does
+		int run(std::vector<int>& vars, std::vector<unsigned char>& live); // on these
+		size_t code_size() const; // bytes of machine code
+		const std::vector<unsigned char>& code() const;
+		size_t frame_size() const; // bytes taken from the frame given in rdi
+
+	private:
+		using operand = x86::operand;
+
+		static int scan(jit *self);
+		static void print(jit *self, int value);
+		static int fail(jit *self, int error);
+
+		operand slot(size_t depth) const;
+		operand var(int id) const;
+		int32_t live(int id) const;
+		void compile_instr(const bytecode& bc, size_t at, size_t depth);
+		void compile_binary(opcode op, size_t depth);
+		void compile_division(opcode op, size_t depth);
+		void compile_by_divisor(const divisor& dv, bool rem, size_t depth);
+		void compile_call(uint64_t fn);
+		void compile_exit();
+		int load(size_t depth, int scratch); // register holding the slot
+		void store(size_t depth, int reg);
+
+		input& in_;
+		output& out_;
+		entries entries_;
+		x86::assembler as_; // the machine code
+		std::vector<size_t> labels_; // by instruction, where its code starts
+		std::vector<std::pair<size_t, size_t>> jumps_; // to patch, to instruction
+		std::vector<size_t> undefs_; // jumps to the undefined identifier exit
+		std::vector<size_t> zeros_; // jumps to the division by zero exit
+		std::vector<uint64_t> frame_;
+		int32_t vars_at_; // in the frame
+		int32_t live_at_;
+		int32_t deep_at_;
+		void *mem_;
+		size_t mem_size_;
+	};
+
+}
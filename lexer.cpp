@@ -1,81 +1,222 @@
 #include "lexer.h"
 
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace cplr {
 
-	node::node(node_t type)
-	: type_(type)
+	token_buffer::token_buffer()
+	: base_(0)
 	{}
 
-	node::~node() {}
+	void token_buffer::clear() {
+		base_ = 0;
+		kinds_.clear();
+		codes_.clear();
+		values_.clear();
+		offsets_.clear();
+	}
 
-	node_t node::get_type() const {
-		return type_;
+	size_t token_buffer::size() const {
+		return kinds_.size();
 	}
 
-	node::operator node_t() const {
-		return type_;
+	token_buffer::idx_t token_buffer::end() const {
+		return base_ + static_cast<idx_t>(kinds_.size());
 	}
 
-	id::id(size_t id)
-	: node(node_t::IDENTIFIER)
-	, id_(id)
-	{}
+	void token_buffer::push(const token& tk, size_t offset) {
+		kinds_.push_back(tk.kind);
+		codes_.push_back(tk.code);
+		values_.push_back(tk.value);
+		offsets_.push_back(static_cast<uint32_t>(offset));
+	}
 
-	size_t id::get_id() const {
-		return id_;
+	void token_buffer::append(const token_buffer& other) {
+		kinds_.insert(kinds_.end(), other.kinds_.begin(), other.kinds_.end());
+		codes_.insert(codes_.end(), other.codes_.begin(), other.codes_.end());
+		values_.insert(values_.end(), other.values_.begin(), other.values_.end());
+		offsets_.insert(offsets_.end(), other.offsets_.begin(), other.offsets_.end());
 	}
 
-	intLit::intLit(int int_lit)
-	: node(node_t::INTEGER_LITERAL)
-	, int_lit_(int_lit)
-	{}
+	void token_buffer::drop_before(idx_t tk) {
+		size_t cnt = tk - base_;
+		kinds_.erase(kinds_.begin(), kinds_.begin() + cnt);
+		codes_.erase(codes_.begin(), codes_.begin() + cnt);
+		values_.erase(values_.begin(), values_.begin() + cnt);
+		offsets_.erase(offsets_.begin(), offsets_.begin() + cnt);
+		base_ = tk;
+	}
 
-	int intLit::get_int() const {
-		return int_lit_;
+	node_t token_buffer::kind(idx_t tk) const {
+		return kinds_[tk - base_];
 	}
 
-	unOp::unOp(unOp_t op)
-	: node(node_t::UNARY_OPERATION)
-	, op_(op)
-	{}
+	unOp_t token_buffer::unop(idx_t tk) const {
+		return static_cast<unOp_t>(codes_[tk - base_]);
+	}
 
-	unOp::unOp(const unOp& other)
-	: node(other.type_)
-	, op_(other.op_)
-	{}
+	binOp_t token_buffer::binop(idx_t tk) const {
+		return static_cast<binOp_t>(codes_[tk - base_]);
+	}
 
+	int token_buffer::int_lit(idx_t tk) const {
+		return values_[tk - base_];
+	}
 
-	unOp_t unOp::get_op() const {
-		return op_;
+	bool token_buffer::too_large(idx_t tk) const {
+		return codes_[tk - base_] != 0;
 	}
 
-	binOp::binOp(binOp_t op)
-	: node(node_t::BINARY_OPERATION)
-	, op_(op)
-	{}
+	size_t token_buffer::id(idx_t tk) const {
+		return static_cast<size_t>(values_[tk - base_]);
+	}
 
-	binOp::binOp(const binOp& other)
-	: node(other.type_)
-	, op_(other.op_)
-	{}
+	size_t token_buffer::offset(idx_t tk) const {
+		return offsets_[tk - base_];
+	}
 
-	binOp_t binOp::get_op() const {
-		return op_;
+	size_t token_buffer::footprint() const {
+		return kinds_.capacity() * sizeof(node_t) + \
+			codes_.capacity() * sizeof(unsigned char) + \
+			values_.capacity() * sizeof(int) + \
+			offsets_.capacity() * sizeof(uint32_t);
 	}
 
-	unKnw::unKnw(std::string str)
-	: node(node_t::UNKNOWN)
-	, str_(std::move(str))
-	{}
+	const symbol_table& lexer::names() const {
+		return names_;
+	}
+
+	symbol_table& lexer::names() {
+		return names_;
+	}
+
+	//--------character classes--------
+
+	static std::array<char_t, 256> make_char_table() {
+		std::array<char_t, 256> table;
+		table.fill(char_t::OTHER);
+		for (int c = '!'; c <= '~'; ++c) {
+			table[c] = char_t::PUNCT;
+		}
+		for (int c = '0'; c <= '9'; ++c) {
+			table[c] = char_t::DIGIT;
+		}
+		for (int c = 'a'; c <= 'z'; ++c) {
+			table[c] = char_t::ALPHA;
+			table[c - 'a' + 'A'] = char_t::ALPHA;
+		}
+		for (unsigned char c : {'{', '}', '(', ')', ';', '?'}) {
+			table[c] = char_t::AUXILIARY;
+		}
+		for (unsigned char c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+			table[c] = char_t::SPACE;
+		}
+		return table;
+	}
+
+	const std::array<char_t, 256> char_table = make_char_table();
+
+	// the seven keywords differ in length or in the first character, so one
+	// comparison is enough
+	node_t keyword(const char *word, size_t len) {
+		const char *key = nullptr;
+		node_t kind = node_t::IDENTIFIER;
+		switch (len) {
+			case 2:
+				if (word[0] == 'i') {
+					key = "if", kind = node_t::IF;
+				} else if (word[0] == 'd') {
+					key = "do", kind = node_t::DO;
+				}
+				break;
+			case 4:
+				if (word[0] == 'e') {
+					key = "else", kind = node_t::ELSE;
+				} else if (word[0] == 't') {
+					key = "true", kind = node_t::BOOL_TRUE;
+				}
+				break;
+			case 5:
+				if (word[0] == 'p') {
+					key = "print", kind = node_t::PRINT;
+				} else if (word[0] == 'w') {
+					key = "while", kind = node_t::WHILE;
+				} else if (word[0] == 'f') {
+					key = "false", kind = node_t::BOOL_FALSE;
+				}
+				break;
+		}
+		if (key == nullptr || memcmp(word, key, len) != 0) {
+			return node_t::IDENTIFIER;
+		}
+		return kind;
+	}
+
+	//--------spans of contiguous source--------
+
+#ifdef __SSE2__
+	// bit i is set if byte i of v is within [lo, hi]
+	static inline unsigned in_range(__m128i v, char lo, char hi) {
+		__m128i biased = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(-128 - lo)));
+		__m128i bound = _mm_set1_epi8(static_cast<char>(-128 + (hi - lo) + 1));
+		return _mm_movemask_epi8(_mm_cmplt_epi8(biased, bound));
+	}
+
+	static inline unsigned space_mask(__m128i v) {
+		return in_range(v, '\t', '\r') | \
+			_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+	}
+
+	static inline unsigned digit_mask(__m128i v) {
+		return in_range(v, '0', '9');
+	}
+
+	static inline unsigned alnum_mask(__m128i v) {
+		// setting bit 5 folds upper case into lower and keeps digits in place
+		return in_range(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z') | \
+			in_range(v, '0', '9');
+	}
+
+	// skips 16 bytes at a time while all of them match, the tail shorter than
+	// 16 bytes is left for the table
+	template <typename Mask>
+	static inline bool skip_blocks(const char *& cur, const char *end, Mask mask) {
+		while (end - cur >= 16) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+			unsigned miss = mask(v) ^ 0xFFFF;
+			if (miss != 0) {
+				cur += __builtin_ctz(miss);
+				return true;
+			}
+			cur += 16;
+		}
+		return false;
+	}
+#endif
+
+	void skip_spaces(const char *& cur, const char *end) {
+#ifdef __SSE2__
+		if (skip_blocks(cur, end, space_mask)) return;
+#endif
+		skip_spaces<const char *>(cur, end);
+	}
 
-	const std::string& unKnw::get_str() const {
-		return str_;
+	void skip_digits(const char *& cur, const char *end) {
+#ifdef __SSE2__
+		if (skip_blocks(cur, end, digit_mask)) return;
+#endif
+		skip_digits<const char *>(cur, end);
 	}
 
-	bool isauxiliary(char c) {
-		return (
-			c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '?'
-		);
+	void skip_alnums(const char *& cur, const char *end) {
+#ifdef __SSE2__
+		if (skip_blocks(cur, end, alnum_mask)) return;
+#endif
+		skip_alnums<const char *>(cur, end);
 	}
 
 }
@@ -1,251 +1,294 @@
 #pragma once
 
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
 #include <cstdlib>
-#include <map>
-#include <memory>
+#include <iterator>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "symbols.h"
 #include "types_decl.h"
 
 namespace cplr {
 
-	static const std::map<std::string, node_t> keyW_s = {
-		{"print", node_t::PRINT},
-		{"if", node_t::IF},
-		{"else", node_t::ELSE},
-		{"do", node_t::DO},
-		{"while", node_t::WHILE},
-		{"true", node_t::BOOL_TRUE},
-		{"false", node_t::BOOL_FALSE}
+	enum class char_t : unsigned char { // what a byte may start
+		OTHER, // control characters and non-ASCII bytes, unknown tokens
+		SPACE,
+		DIGIT,
+		ALPHA,
+		AUXILIARY, // { } ( ) ; ?
+		PUNCT // the rest of printable characters
 	};
 
-	static const std::map<std::string, unOp_t> unOp_s = {
-		{"!", unOp_t::LOGICAL_NEGATION}
-	};
+	extern const std::array<char_t, 256> char_table;
 
-	static const std::map<std::string, binOp_t> binOp_s = {
-		{"=", binOp_t::ASSIGNMENT},
-		{"||", binOp_t::OR},
-		{"&&", binOp_t::AND},
-		{"==", binOp_t::EQUAL},
-		{"!=", binOp_t::NOT_EQUAL},
-		{"<", binOp_t::LESS},
-		{"<=", binOp_t::LESS_OR_EQUAL},
-		{">=", binOp_t::GREATER_OR_EQUAL},
-		{">", binOp_t::GREATER},
-		{"+", binOp_t::ADDITION},
-		{"-", binOp_t::SUBSTRACTION},
-			// in lexical analysis all '-' are recognised as binOp...
-		{"*", binOp_t::MULTIPLICATION},
-		{"/", binOp_t::DIVISION}
-	};
+	inline char_t char_class(char c) {
+		return char_table[static_cast<unsigned char>(c)];
+	}
 
-	static std::map<std::string, size_t> IDs;
+	const size_t max_keyword_len = 5;
+	node_t keyword(const char *word, size_t len); // node_t::IDENTIFIER if none
 
-	class node {
-	public:
-		node(node_t type);
-		virtual ~node();
-		node_t get_type() const;
-		operator node_t() const;
-	protected:
-		node_t type_;
+	struct token { // what a read_*_token helper has recognized
+		node_t kind;
+		unsigned char code; // unOp_t or binOp_t, 1 for a literal beyond INT_MAX
+		int value; // integer literal or id of identifier
 	};
 
-	class id final : public node {
+	// token stream kept as parallel arrays; a stream read in parts keeps only
+	// a window of it, tokens are numbered from the start of the stream anyway
+	class token_buffer final {
 	public:
-		id(size_t id);
-		size_t get_id() const;
+		using idx_t = uint32_t;
 
-	private:
-	 size_t id_;
-	};
+		token_buffer();
+		void clear();
+		size_t size() const; // tokens kept
+		idx_t end() const; // number of the token after the last one kept
+		void push(const token& tk, size_t offset);
+		void append(const token_buffer& other); // numbered on from end()
+		void drop_before(idx_t tk);
 
-	class intLit final : public node {
-	public:
-		intLit(int int_lit);
-		int get_int() const;
-	private:
-	 int int_lit_;
-	};
+		node_t kind(idx_t tk) const;
+		unOp_t unop(idx_t tk) const;
+		binOp_t binop(idx_t tk) const;
+		int int_lit(idx_t tk) const;
+		bool too_large(idx_t tk) const; // a literal beyond INT_MAX
+		size_t id(idx_t tk) const;
+		size_t offset(idx_t tk) const;
+		size_t footprint() const; // bytes taken by the stream
 
-	class unOp final : public node {
-	public:
-		unOp(unOp_t op);
-		unOp(const unOp& other);
-		unOp_t get_op() const;
 	private:
-		unOp_t op_;
+		idx_t base_; // number of the first token kept
+		std::vector<node_t> kinds_;
+		std::vector<unsigned char> codes_;
+		std::vector<int> values_;
+		std::vector<uint32_t> offsets_; // in the source
 	};
 
-	class binOp final : public node {
+	// tokens read while they are parsed: pull appends at least one token to
+	// the window or says that there are no more
+	class token_source {
 	public:
-		binOp(binOp_t op);
-		binOp(const binOp& other);
-		binOp_t get_op() const;
-	private:
-		binOp_t op_;
-	};
-
-	class unKnw final : public node {
-	public:
-		unKnw(std::string str);
-	 	const std::string& get_str() const;
-	private:
-		std::string str_;
+		virtual ~token_source() {}
+		virtual bool pull() = 0;
+		virtual const token_buffer& window() const = 0;
 	};
 
+	// spans of one class are skipped through the table, the overloads for
+	// contiguous source below go 16 bytes at a time
 	template <typename ForwardIterator>
 	void skip_spaces(ForwardIterator& cur, ForwardIterator end) {
-		while (cur != end && isspace(*cur)) {
+		while (cur != end && char_class(*cur) == char_t::SPACE) {
 			++cur;
 		}
 	}
 
 	template <typename ForwardIterator>
-	std::shared_ptr<node> read_digit_token(
-		ForwardIterator& cur, ForwardIterator end
-	) {
-		std::string token;
-		while (cur != end && isdigit(*cur)) {
-			token.push_back(*cur);
+	void skip_digits(ForwardIterator& cur, ForwardIterator end) {
+		while (cur != end && char_class(*cur) == char_t::DIGIT) {
 			++cur;
 		}
-
-		std::shared_ptr<node> ptr;
-		ptr = std::make_shared<intLit>(stoi(token));
-		return ptr;
 	}
 
 	template <typename ForwardIterator>
-	std::shared_ptr<node> read_id_keyword_token(
-		ForwardIterator& cur, ForwardIterator end
-	) {
-		std::string token;
-		while (cur != end && (isalpha(*cur) || isdigit(*cur))) {
-			token.push_back(*cur);
+	void skip_alnums(ForwardIterator& cur, ForwardIterator end) {
+		while (
+			cur != end && \
+			(char_class(*cur) == char_t::ALPHA || char_class(*cur) == char_t::DIGIT)
+		) {
 			++cur;
 		}
+	}
 
-		std::shared_ptr<node> ptr;
-		auto if_key = keyW_s.find(token);
-		if (if_key != keyW_s.end()) {
-			ptr = std::make_shared<node>(if_key->second);
-			return ptr;
+	void skip_spaces(const char *& cur, const char *end);
+	void skip_digits(const char *& cur, const char *end);
+	void skip_alnums(const char *& cur, const char *end);
+
+	template <typename ForwardIterator>
+	token read_digit_token(ForwardIterator& cur, ForwardIterator end) {
+		ForwardIterator first = cur;
+		skip_digits(cur, end);
+		uint64_t value = 0; // stops growing past int, leading zeros aside
+		for (; first != cur; ++first) {
+			value = std::min<uint64_t>(value * 10 + (*first - '0'), UINT_MAX);
 		}
-		auto if_id = IDs.find(token);
-		if (if_id != IDs.end()) {
-			ptr = std::make_shared<id>(if_id->second);
-		} else {
-			size_t new_id = IDs.size();
-			IDs[token] = new_id;
-			ptr = std::make_shared<id>(new_id);
+
+		if (value > INT_MAX) { // the parser takes only 2147483648 after -
+			int low = value == 0x80000000u ? INT_MIN : 0;
+			return {node_t::INTEGER_LITERAL, 1, low};
 		}
-		return ptr;
+		return {node_t::INTEGER_LITERAL, 0, static_cast<int>(value)};
 	}
 
-	bool isauxiliary(char c);
+	template <typename ForwardIterator>
+	token read_id_keyword_token(
+		ForwardIterator& cur, ForwardIterator end, symbol_table& names
+	) {
+		ForwardIterator first = cur;
+		skip_alnums(cur, end);
+		size_t len = std::distance(first, cur);
+		if (len <= max_keyword_len) {
+			char word[max_keyword_len];
+			std::copy(first, cur, word);
+			node_t kind = keyword(word, len);
+			if (kind != node_t::IDENTIFIER) {
+				return {kind, 0, 0};
+			}
+		}
+
+		return {node_t::IDENTIFIER, 0, static_cast<int>(names.intern(first, cur))};
+	}
 
 	template <typename ForwardIterator>
-	std::shared_ptr<node> read_auxiliary_token(ForwardIterator& cur) {
+	token read_auxiliary_token(ForwardIterator& cur) {
 		char c = *(cur++);
-		std::shared_ptr<node> ptr;
-		if (c == '{') {
-			ptr = std::make_shared<node>(node_t::OPEN_BRACE);
-		} else if (c == '}') {
-			ptr = std::make_shared<node>(node_t::CLOSE_BRACE);
-		} else if (c == '(') {
-			ptr = std::make_shared<node>(node_t::OPEN_PARENTHESIS);
-		} else if (c == ')') {
-			ptr = std::make_shared<node>(node_t::CLOSE_PARENTHESIS);
-		} else if (c == ';') {
-			ptr = std::make_shared<node>(node_t::SEMICOLON);
-		} else if (c == '?') {
-			ptr = std::make_shared<node>(node_t::SCAN);
+		node_t kind = node_t::UNKNOWN;
+		switch (c) {
+			case '{': kind = node_t::OPEN_BRACE; break;
+			case '}': kind = node_t::CLOSE_BRACE; break;
+			case '(': kind = node_t::OPEN_PARENTHESIS; break;
+			case ')': kind = node_t::CLOSE_PARENTHESIS; break;
+			case ';': kind = node_t::SEMICOLON; break;
+			case '?': kind = node_t::SCAN; break;
 		}
-		return ptr;
+		return {kind, 0, 0};
+	}
+
+	inline token binop_token(binOp_t op) {
+		return {node_t::BINARY_OPERATION, static_cast<unsigned char>(op), 0};
 	}
 
+	// operators are told apart by the first character and the next one
 	template <typename ForwardIterator>
-	std::shared_ptr<node> read_op_token(
-		ForwardIterator& cur, ForwardIterator end
-	) {
-		std::string token;
-		std::shared_ptr<node> ptr;
-		token.push_back(*(cur++));
-
-		if (cur != end && ispunct(*cur)) {
-			token.push_back(*cur);
-			auto if_binop = binOp_s.find(token);
-			if (if_binop != binOp_s.end()) {
-				ptr = std::make_shared<binOp>(if_binop->second);
-				++cur;
-				return ptr;
-			} else {
-				auto if_unop = unOp_s.find(token);
-				if (if_unop != unOp_s.end()) {
-					ptr = std::make_shared<unOp>(if_unop->second);
+	token read_op_token(ForwardIterator& cur, ForwardIterator end) {
+		char c = *(cur++);
+		char next = cur != end ? *cur : '\0';
+
+		switch (c) {
+			case '+':
+				return binop_token(binOp_t::ADDITION);
+			case '-': // in lexical analysis all '-' are recognised as binOp...
+				return binop_token(binOp_t::SUBSTRACTION);
+			case '*':
+				return binop_token(binOp_t::MULTIPLICATION);
+			case '/':
+				return binop_token(binOp_t::DIVISION);
+			case '=':
+				if (next == '=') {
 					++cur;
-					return ptr;
-				} else {
-					token.pop_back();
+					return binop_token(binOp_t::EQUAL);
 				}
-			}
+				return binop_token(binOp_t::ASSIGNMENT);
+			case '!':
+				if (next == '=') {
+					++cur;
+					return binop_token(binOp_t::NOT_EQUAL);
+				}
+				return {
+					node_t::UNARY_OPERATION, \
+					static_cast<unsigned char>(unOp_t::LOGICAL_NEGATION), 0
+				};
+			case '<':
+				if (next == '=') {
+					++cur;
+					return binop_token(binOp_t::LESS_OR_EQUAL);
+				}
+				return binop_token(binOp_t::LESS);
+			case '>':
+				if (next == '=') {
+					++cur;
+					return binop_token(binOp_t::GREATER_OR_EQUAL);
+				}
+				return binop_token(binOp_t::GREATER);
+			case '|':
+				if (next == '|') {
+					++cur;
+					return binop_token(binOp_t::OR);
+				}
+				break;
+			case '&':
+				if (next == '&') {
+					++cur;
+					return binop_token(binOp_t::AND);
+				}
+				break;
 		}
 
-		auto if_binop = binOp_s.find(token);
-		if (if_binop != binOp_s.end()) {
-			ptr = std::make_shared<binOp>(if_binop->second);
-		} else {
-			auto if_unop = unOp_s.find(token);
-			if (if_unop != unOp_s.end()) {
-				ptr = std::make_shared<unOp>(if_unop->second);
-			} else {
-				while (cur != end && ispunct(*cur) && !isauxiliary(*cur)) {
-					token.push_back(*(cur++));
-				}
-				ptr = std::make_shared<unKnw>(token);
-			}
+		while (cur != end && char_class(*cur) == char_t::PUNCT) {
+			++cur;
 		}
-		return ptr;
+		return {node_t::UNKNOWN, 0, 0};
 	}
 
+	// reads the token starting at cur, which is not a space; a run of control
+	// characters and non-ASCII bytes is one unknown token
 	template <typename ForwardIterator>
-	std::shared_ptr<node> read_op_auxiliary_token(
-		ForwardIterator& cur, ForwardIterator end
+	void read_token(
+		ForwardIterator& cur, ForwardIterator end, symbol_table& names, token& tk
 	) {
-		std::shared_ptr<node> ptr;
-		if (isauxiliary(*cur)) {
-			ptr = read_auxiliary_token(cur);
-		} else {
-			ptr = read_op_token(cur, end);
+		switch (char_class(*cur)) {
+			case char_t::DIGIT:
+				tk = read_digit_token(cur, end);
+				break;
+			case char_t::ALPHA:
+				tk = read_id_keyword_token(cur, end, names);
+				break;
+			case char_t::AUXILIARY:
+				tk = read_auxiliary_token(cur);
+				break;
+			case char_t::PUNCT:
+				tk = read_op_token(cur, end);
+				break;
+			default:
+				while (cur != end && char_class(*cur) == char_t::OTHER) {
+					++cur;
+				}
+				tk = {node_t::UNKNOWN, 0, 0};
+				break;
 		}
-
-		return ptr;
 	}
 
 	template <typename ForwardIterator>
-	std::vector<std::shared_ptr<node>> tokenize(
-		ForwardIterator begin, ForwardIterator end
+	void tokenize(
+		ForwardIterator begin, ForwardIterator end, token_buffer& tokens_list, \
+		symbol_table& names
 	) {
-		std::vector<std::shared_ptr<node>> tokens_list;
-		ForwardIterator cur = begin;
+		tokens_list.clear();
+		ForwardIterator cur = begin, last = begin;
+		size_t offset = 0;
+		token tk;
 
 		while (cur != end) {
 			skip_spaces(cur, end);
-			if (isdigit(*cur)) {
-				tokens_list.push_back(read_digit_token(cur, end));
-			} else if (isalpha(*cur)) {
-				tokens_list.push_back(read_id_keyword_token(cur, end));
-			} else if (ispunct(*cur)) {
-				tokens_list.push_back(read_op_auxiliary_token(cur, end));
+			if (cur == end) {
+				break;
 			}
+			offset += std::distance(last, cur);
+			last = cur;
+			read_token(cur, end, names, tk);
+			tokens_list.push(tk, offset);
 		}
-
-		return tokens_list;
 	}
 
+	class lexer final { // what stays the same for all the tokens of a program
+	public:
+		template <typename ForwardIterator>
+		void tokenize(
+			ForwardIterator begin, ForwardIterator end, token_buffer& tokens_list
+		) {
+			cplr::tokenize(begin, end, tokens_list, names_);
+		}
+
+		const symbol_table& names() const;
+		symbol_table& names();
+
+	private:
+		symbol_table names_;
+	};
+
 }
@@ -1,30 +1,341 @@
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <memory>
+#include <sstream>
 
+#include "compiler.h"
+#include "elf.h"
+#include "io.h"
 #include "lexer.h"
+#include "ir.h"
+#include "jit.h"
+#include "optimizer.h"
 #include "parser.h"
+#include "passes.h"
+#include "pipeline.h"
+#include "source.h"
+#include "threaded.h"
+#include "tier.h"
+#include "translator.h"
+#include "vm.h"
 
 using namespace std;
 using namespace cplr;
 
+// usage: main [--vm | --threaded | --jit | --walk | --tiered | --pipe]
+//	[--hot n] [--ssa] [--no-opt] [--dump] [--stats] [--time] [--stream]
+//	[--input file] [--binary-in 32 | 64] [--binary-out 32 | 64]
+//	[--emit-c out | --compile exe | --elf exe] file
+//	--vm	compile into bytecode and run it on the stack machine (default)
+//	--threaded	run the bytecode by direct threading, where the code of
+//		every instruction jumps to the next one's, with identifier operations
+//		of statements and conditions fused into superinstructions; --stats
+//		reports how many of each were made and how many times they ran
+//	--jit	compile the bytecode further into x86-64 machine code and run it
+//		natively, the stack machine runs it where that can't be done
+//	--walk	run the tree-walking interpreter, kept as the reference
+//	--tiered	start in the tree-walking interpreter and move a loop which
+//		has run n iterations (--hot, 1000 by default) into machine code in
+//		the middle of it; --time reports the loops moved and time by tier
+//	--pipe	lex, parse and run on three threads at once, top-level statements
+//		are run as soon as they are parsed, so on a syntax error the
+//		statements before it are run; --dump, --stats and --stream are ignored,
+//		--ssa, the other engines and --emit-c, --compile and --elf can't be
+//		given with it
+//	--ssa	lower the tree into SSA form, propagate constants, specialize
+//		operations by ranges of values and drop dead code there before
+//		compiling it into bytecode; programs with whiles checking
+//		identifiers at run time are compiled as they are
+//	--no-opt	run the tree as it is parsed, without folding constants,
+//		dropping dead code, computing sums of loops at once, unrolling
+//		small loops, hoisting invariant expressions out of loops and reusing
+//		values of common subexpressions
+//	--dump	print the bytecode before running it, with --ssa the SSA form too
+//	--stats	report memory taken by the tokens, the identifiers and the syntax
+//		tree, and how many nodes of the tree the optimizer eliminated
+//	--time	report time taken by lexing, parsing, optimizing and running, with
+//		--ssa by every pass as well
+//	--stream	read the file by chunks and lex it while parsing, so only the
+//		tokens near the one being parsed are kept
+//	--input	read ? from the file instead of stdin
+//	--binary-in	? reads raw native-endian 32 or 64-bit integers instead of
+//		decimal text, 64-bit ones wrap around
+//	--binary-out	print writes raw native-endian 32 or 64-bit integers with
+//		no separators instead of decimal lines
+//	--emit-c	translate the optimized tree into C with a small runtime for ?
+//		and print and write it to out, - is stdout, instead of running it;
+//		the formats of --binary-in and --binary-out are built into it, --ssa
+//		and the engines other than --vm can't be given with it
+//	--compile	the same, but build the executable exe of it with $CC, cc by
+//		default, at -O2
+//	--elf	write the machine code of --jit with a runtime of its own doing ?
+//		and print by system calls as a static x86-64 Linux executable exe,
+//		which needs no libc; it reads and writes decimal text only, --walk,
+//		--tiered and --threaded can't be given with it
+// file is mapped into memory, - reads the program from stdin
+
+static double ms_since(chrono::steady_clock::time_point& since) {
+	auto now = chrono::steady_clock::now();
+	double ms = chrono::duration<double, milli>(now - since).count();
+	since = now;
+	return ms;
+}
+
+// -1 if the tree can't be lowered, see ir_builder::build
+static int compile_ssa(const ast& tree, bytecode& bc, bool dump, bool timing) {
+	ir code;
+	if (ir_builder(tree, code).build() != 0) {
+		return -1;
+	}
+	pass_manager passes;
+	passes.add("sccp", sccp);
+	passes.add("specialize", specialize);
+	passes.add("sccp", sccp);
+	passes.add("dce", dce);
+	passes.run(code);
+	if (dump) {
+		code.dump(cerr);
+	}
+	if (timing) {
+		passes.report(cerr);
+	}
+	return ir_compiler(code).compile(bc);
+}
+
+static int usage() {
+	cerr << "usage: main [--vm | --threaded | --jit | --walk | --tiered | --pipe]\n" \
+		"\t[--hot n] [--ssa] [--no-opt] [--dump] [--stats] [--time] [--stream]\n" \
+		"\t[--input file] [--binary-in 32 | 64] [--binary-out 32 | 64]\n" \
+		"\t[--emit-c out | --compile exe | --elf exe] file" << endl;
+	return 1;
+}
+
+// false if bits is neither 32 nor 64
+static bool binary_format(const char *bits, input::format_t& format) {
+	if (strcmp(bits, "32") == 0) {
+		format = input::format_t::I32;
+	} else if (strcmp(bits, "64") == 0) {
+		format = input::format_t::I64;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// false unless arg is a decimal number of at most 32 bits
+static bool count(const char *arg, uint32_t& to) {
+	uint64_t value = 0;
+	const char *cur = arg;
+	for (; *cur >= '0' && *cur <= '9' && value <= UINT32_MAX; ++cur) {
+		value = value * 10 + static_cast<uint64_t>(*cur - '0');
+	}
+	if (cur == arg || *cur != '\0' || value > UINT32_MAX) {
+		return false;
+	}
+	to = static_cast<uint32_t>(value);
+	return true;
+}
+
 int main(int argc, char *argv[]) {
-	if (argc == 1) {
+	bool walk = false, native = false, tiered = false, threaded = false;
+	bool dump = false, stats = false, timing = false;
+	bool stream = false, pipe = false, opt = true, ssa = false, bad = false;
+	const char *file = nullptr, *input_file = nullptr;
+	const char *c_file = nullptr, *exe_file = nullptr; // ahead of time
+	const char *elf_file = nullptr;
+	uint32_t hot_after = 1000; // iterations of a loop before it is compiled
+	input::format_t in_format = input::format_t::TEXT;
+	input::format_t out_format = input::format_t::TEXT;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--walk") == 0) {
+			walk = true;
+			tiered = threaded = false;
+		} else if (strcmp(argv[i], "--vm") == 0) {
+			walk = tiered = native = threaded = false;
+		} else if (strcmp(argv[i], "--threaded") == 0) {
+			walk = tiered = native = false;
+			threaded = true;
+		} else if (strcmp(argv[i], "--jit") == 0) {
+			walk = tiered = threaded = false;
+			native = true;
+		} else if (strcmp(argv[i], "--tiered") == 0) {
+			walk = native = threaded = false;
+			tiered = true;
+		} else if (strcmp(argv[i], "--hot") == 0 && i + 1 < argc) {
+			bad = !count(argv[++i], hot_after) || bad;
+		} else if (strcmp(argv[i], "--pipe") == 0) {
+			pipe = true;
+		} else if (strcmp(argv[i], "--ssa") == 0) {
+			ssa = true;
+		} else if (strcmp(argv[i], "--no-opt") == 0) {
+			opt = false;
+		} else if (strcmp(argv[i], "--dump") == 0) {
+			dump = true;
+		} else if (strcmp(argv[i], "--stats") == 0) {
+			stats = true;
+		} else if (strcmp(argv[i], "--time") == 0) {
+			timing = true;
+		} else if (strcmp(argv[i], "--stream") == 0) {
+			stream = true;
+		} else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+			input_file = argv[++i];
+		} else if (strcmp(argv[i], "--binary-in") == 0 && i + 1 < argc) {
+			bad = !binary_format(argv[++i], in_format) || bad;
+		} else if (strcmp(argv[i], "--binary-out") == 0 && i + 1 < argc) {
+			bad = !binary_format(argv[++i], out_format) || bad;
+		} else if (strcmp(argv[i], "--emit-c") == 0 && i + 1 < argc) {
+			c_file = argv[++i];
+		} else if (strcmp(argv[i], "--compile") == 0 && i + 1 < argc) {
+			exe_file = argv[++i];
+		} else if (strcmp(argv[i], "--elf") == 0 && i + 1 < argc) {
+			elf_file = argv[++i];
+		} else if (strncmp(argv[i], "--", 2) == 0 || file != nullptr) {
+			bad = true;
+		} else {
+			file = argv[i];
+		}
+	}
+	bool engine = walk || native || tiered || threaded;
+	bool ahead = c_file != nullptr || exe_file != nullptr; // of running
+	if (
+		bad || (pipe && (engine || ssa || ahead || elf_file != nullptr)) || \
+		(ahead && (engine || ssa || elf_file != nullptr)) || \
+		(c_file != nullptr && exe_file != nullptr) || \
+		(elf_file != nullptr && (walk || tiered || threaded))
+	) {
+		return usage();
+	}
+
+	output out;
+	out.set_format(out_format);
+	input in;
+	in.set_format(in_format);
+	in.tie(&out);
+	if (file == nullptr) {
 		cout << "The file to be compiled wasn\'t attached." << endl;
+	} else if (in.open(input_file) != 0) {
+		cout << "Can\'t open input file." << endl;
 	} else {
-		ifstream prog(argv[1]);
-		if (!prog) {
+		lexer lxr;
+		source prog;
+		token_stream stream_toks(lxr.names());
+		if ((stream && !pipe ? stream_toks.open(file) : prog.open(file)) != 0) {
 			cout << "Can\'t open file." << endl;
+		} else if (pipe) {
+			auto since = chrono::steady_clock::now();
+			run_pipelined(prog, lxr.names(), in, out, opt);
+			if (timing) {
+				cerr << "time: all " << ms_since(since) << " ms" << endl;
+			}
 		} else {
-			prog.seekg(0, ios::end);
-			size_t size = prog.tellg();
-			string code(size, '\0');
-			prog.seekg(0);
-			prog.read(&code[0], size);
-			vector<shared_ptr<node>> tokens = tokenize(code.begin(), code.end());
+			auto since = chrono::steady_clock::now();
+			token_buffer tokens;
+			double lex_ms = 0; // a stream is lexed while it is parsed
+			if (!stream) {
+				lxr.tokenize(prog.begin(), prog.end(), tokens);
+				lex_ms = ms_since(since);
+			}
 			parser prsr;
-			prsr.parse(tokens.begin(), tokens.end());
-			prsr.run();
+			int parsed = stream ? prsr.parse(stream_toks) : prsr.parse(tokens);
+			double parse_ms = ms_since(since);
+			optimizer optr(prsr.get_ast());
+			if (opt && parsed == 0) {
+				optr.run();
+			}
+			double opt_ms = ms_since(since);
+			if (stats) {
+				const ast& tree = prsr.get_ast();
+				if (stream) {
+					cerr << "tokens: " << stream_toks.window().size() << " tokens kept, " \
+						<< stream_toks.footprint() << " bytes with the input" << endl;
+				} else {
+					cerr << "tokens: " << tokens.size() << " tokens, " \
+						<< tokens.footprint() << " bytes" << endl;
+				}
+				cerr << "names: " << lxr.names().size() << " identifiers, " \
+					<< lxr.names().footprint() << " bytes" << endl;
+				cerr << "ast: " << tree.size() << " nodes, " \
+					<< tree.footprint() << " bytes" << endl;
+				cerr << "opt: " << optr.eliminated() << " nodes eliminated, " \
+					<< optr.solved() << " loops solved, " \
+					<< optr.unrolled() << " unrolled, " \
+					<< optr.hoisted() << " expressions hoisted out of loops, " \
+					<< optr.reused() << " common subexpressions reused" << endl;
+			}
+			if (ahead) {
+				c_translator translator(prsr, &lxr.names());
+				translator.set_formats(in_format, out_format);
+				ostringstream source;
+				if (translator.translate(source) != 0) {
+					// reported by the parser or the translator
+				} else if (exe_file != nullptr) {
+					if (build_c(source.str(), exe_file) != 0) {
+						cout << "Can\'t build the executable." << endl;
+					}
+				} else if (strcmp(c_file, "-") == 0) {
+					cout << source.str();
+				} else if (!(ofstream(c_file) << source.str())) {
+					cout << "Can\'t write the C file." << endl;
+				}
+			} else if (walk) {
+				prsr.run(in, out);
+			} else if (tiered) {
+				tiering tiers(prsr, in, out, hot_after);
+				tiers.run();
+				out.flush();
+				if (timing) {
+					tiers.report(cerr);
+				}
+			} else {
+				bytecode bc;
+				int compiled = -1;
+				if (ssa && parsed == 0) { // frame slots hold values, not identifiers
+					compiled = compile_ssa(prsr.get_ast(), bc, dump, timing);
+					if (compiled == 0 && dump) {
+						bc.dump(cerr);
+					}
+				}
+				if (compiled != 0 && compiler(prsr).compile(bc) == 0) {
+					compiled = 0;
+					if (dump) {
+						bc.dump(cerr, &lxr.names());
+					}
+				}
+				jit code(in, out);
+				bool text = in_format == input::format_t::TEXT && \
+					out_format == input::format_t::TEXT;
+				if (compiled == 0 && elf_file != nullptr) {
+					elf_image image;
+					if (!text) {
+						cout << "The executable reads and writes decimal text only." << endl;
+					} else if (image.build(bc) != 0 || image.write(elf_file) != 0) {
+						cout << "Can\'t write the executable." << endl;
+					} else if (stats) {
+						cerr << "elf: " << image.size() << " bytes" << endl;
+					}
+				} else if (compiled == 0 && native && code.compile(bc) == 0) {
+					if (stats) {
+						cerr << "jit: " << code.code_size() << " bytes of machine code" << endl;
+					}
+					code.run();
+				} else if (compiled == 0 && threaded) {
+					threaded_vm engine(in, out);
+					engine.compile(bc);
+					engine.run(stats);
+					if (stats) {
+						engine.report(cerr);
+					}
+				} else if (compiled == 0) {
+					vm(in, out).run(bc);
+				}
+			}
+			out.flush(); // the run takes writing out what it printed
+			if (timing) {
+				cerr << "time: lex " << lex_ms << " ms, parse " << parse_ms \
+					<< " ms, opt " << opt_ms << " ms, run " << ms_since(since) << " ms" << endl;
+			}
 		}
 	}
 
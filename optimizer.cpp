@@ -0,0 +1,1404 @@
+#include "optimizer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "arith.h"
+
+namespace cplr {
+
+	// operations nested deeper than this in one expression are left as they
+	// are by folding, hoisting and numbering, which would run out of stack
+	// on a long machine-made statement; the engines don't recurse as deep
+	static const size_t max_depth = 4096;
+
+	optimizer::optimizer(ast& tree)
+	: tree_(tree)
+	, eliminated_(0)
+	, solved_(0)
+	, unrolled_(0)
+	, hoisted_(0)
+	, reused_(0)
+	, depth_(0)
+	, next_number_(0)
+	, epoch_(0)
+	{}
+
+	void optimizer::run() {
+		fold();
+		solve();
+		unroll();
+		hoist();
+		number();
+		tree_.reorder();
+	}
+
+	void optimizer::fold() {
+		size_t before = count(tree_.root());
+		fold_stmt(tree_.root());
+		eliminated_ += before - count(tree_.root());
+	}
+
+	void optimizer::solve() {
+		solve_loops(tree_.root());
+	}
+
+	void optimizer::unroll() {
+		unroll_loops(tree_.root());
+	}
+
+	void optimizer::hoist() {
+		hoist_loops(tree_.root());
+	}
+
+	void optimizer::number() {
+		forget();
+		number_stmt(tree_.root());
+	}
+
+	size_t optimizer::eliminated() const {
+		return eliminated_;
+	}
+
+	size_t optimizer::solved() const {
+		return solved_;
+	}
+
+	size_t optimizer::unrolled() const {
+		return unrolled_;
+	}
+
+	size_t optimizer::hoisted() const {
+		return hoisted_;
+	}
+
+	size_t optimizer::reused() const {
+		return reused_;
+	}
+
+	size_t optimizer::count(idx_t nd) const {
+		const ast::node& node = tree_[nd];
+		switch (node.type_) {
+			case node_t::SCOPE: {
+				size_t cnt = 1;
+				const idx_t *it = tree_.list(node.first_);
+				for (idx_t i = 0; i < node.count_; ++i) {
+					cnt += count(it[i]);
+				}
+				return cnt;
+			}
+			case node_t::IF:
+				return 1 + count(node.cond_) + count(node.body_) + count(node.else_);
+			case node_t::WHILE: case node_t::DO:
+				return 1 + count(node.cond_) + count(node.body_);
+			case node_t::PRINT: case node_t::UNARY_OPERATION:
+				return 1 + count(node.rhs_);
+			case node_t::BINARY_OPERATION:
+				return 1 + count(node.lhs_) + count(node.rhs_);
+			default:
+				return 1;
+		}
+	}
+
+	bool optimizer::is_boolean(idx_t nd) const {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::UNARY_OPERATION) {
+			return tree_.unop(nd) == unOp_t::LOGICAL_NEGATION;
+		} else if (type == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			return op >= binOp_t::OR && op <= binOp_t::GREATER;
+		} else if (type == node_t::INTEGER_LITERAL) {
+			return tree_[nd].val_ == 0 || tree_[nd].val_ == 1;
+		}
+		return type == node_t::BOOL_TRUE || type == node_t::BOOL_FALSE;
+	}
+
+	bool optimizer::is_operation(idx_t nd) const { // not a leaf
+		node_t type = tree_[nd].type_;
+		return type == node_t::UNARY_OPERATION || type == node_t::BINARY_OPERATION;
+	}
+
+	//--------statements--------
+	//
+	//	A branch which is never taken is dropped and the one which is always
+	//	taken replaces if in a scope of its own, since the identifiers defined
+	//	by it are undefined after if. The same goes for do whose condition is
+	//	false. Statements which do nothing are dropped from scopes: empty ones,
+	//	expressions which can't fail and don't read ?, and identifiers which are
+	//	defined already.
+
+	void optimizer::fold_stmt(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			fold_scope(nd);
+		} else if (type == node_t::IF) {
+			value_info cond = fold_expr(tree_[nd].cond_, true);
+			if (cond.is_const) {
+				idx_t taken = cond.val ? tree_[nd].body_ : tree_[nd].else_;
+				fold_stmt(taken);
+				replace_by_stmt(nd, taken);
+				return;
+			}
+			fold_stmt(tree_[nd].body_);
+			fold_stmt(tree_[nd].else_);
+			if (
+				cond.pure && tree_[tree_[nd].body_].type_ == node_t::EMPTY && \
+				tree_[tree_[nd].else_].type_ == node_t::EMPTY
+			) {
+				tree_[nd].type_ = node_t::EMPTY;
+			}
+		} else if (type == node_t::WHILE) {
+			value_info cond = fold_expr(tree_[nd].cond_, true);
+			if (cond.is_const && cond.val == 0) {
+				tree_[nd].type_ = node_t::EMPTY;
+				return;
+			}
+			fold_stmt(tree_[nd].body_);
+		} else if (type == node_t::DO) {
+			fold_stmt(tree_[nd].body_);
+			value_info cond = fold_expr(tree_[nd].cond_, true);
+			if (cond.is_const && cond.val == 0) {
+				replace_by_stmt(nd, tree_[nd].body_);
+			}
+		} else if (type == node_t::PRINT) {
+			fold_right(tree_[nd].rhs_);
+		} else if (type == node_t::IDENTIFIER) {
+			if (tree_.bind(nd) == ast::bind_t::DEFINED) {
+				tree_[nd].type_ = node_t::EMPTY;
+			}
+		} else if (tree_.is_assignment(nd)) {
+			fold_right(nd);
+		} else if (type != node_t::EMPTY) {
+			if (fold_top(nd, true).pure) { // the value is dropped anyway
+				tree_[nd].type_ = node_t::EMPTY;
+			}
+		}
+	}
+
+	// statements left are moved to the front of the list of the scope, which
+	// is looked up again after each one since set_scope may move the lists
+	void optimizer::fold_scope(idx_t nd) {
+		idx_t first = tree_[nd].first_, kept = 0;
+		for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+			idx_t stmt = tree_.list(first)[i];
+			fold_stmt(stmt);
+			if (tree_[stmt].type_ != node_t::EMPTY) {
+				tree_.list(first)[kept++] = stmt;
+			}
+		}
+		tree_[nd].count_ = kept;
+		if (kept == 0) {
+			tree_[nd].type_ = node_t::EMPTY;
+		}
+	}
+
+	void optimizer::fold_right(idx_t nd) {
+		if (tree_.is_assignment(nd)) {
+			fold_expr(tree_[nd].rhs_, false);
+		} else if (tree_[nd].type_ != node_t::IDENTIFIER) {
+			fold_top(nd, false);
+		}
+	}
+
+	// an identifier standing alone in a statement or in print is an lvalue
+	// which gets defined, so an expression is not folded into an identifier
+	// there unless it is defined anyway; the operands stay folded
+	optimizer::value_info optimizer::fold_top(idx_t nd, bool truth_only) {
+		ast::node before = tree_[nd];
+		value_info ret = fold_expr(nd, truth_only);
+		if (
+			tree_[nd].type_ == node_t::IDENTIFIER && \
+			tree_.bind(nd) != ast::bind_t::DEFINED
+		) {
+			tree_[nd] = before;
+		}
+		return ret;
+	}
+
+	void optimizer::replace_by_stmt(idx_t nd, idx_t by) {
+		node_t type = tree_[by].type_;
+		if (
+			type == node_t::SCOPE || type == node_t::EMPTY || type == node_t::IF || \
+			type == node_t::WHILE || type == node_t::DO
+		) { // these undefine what they define by themselves
+			tree_[nd] = tree_[by];
+		} else {
+			tree_.set_scope(nd, {by});
+		}
+	}
+
+	//--------expressions--------
+	//
+	//	Constant operations are computed by the helpers the engines use, but
+	//	division by zero is left for the run time to report. Operations with 0
+	//	and 1 are dropped when their other operand stays evaluated, and an
+	//	operand is dropped only if it is pure. Operands of !, && and || and
+	//	conditions are only checked for being nonzero, so there !!x is x.
+
+	optimizer::value_info optimizer::fold_expr(idx_t nd, bool truth_only) {
+		node_t type = tree_[nd].type_;
+		if (is_operation(nd)) {
+			if (depth_ == max_depth) {
+				return {false, false, 0}; // as if it read ?
+			}
+			++depth_;
+			value_info ret = type == node_t::UNARY_OPERATION ? \
+				fold_unary(nd, truth_only) : fold_binary(nd, truth_only);
+			--depth_;
+			return ret;
+		} else if (type == node_t::INTEGER_LITERAL) {
+			return {true, true, tree_[nd].val_};
+		} else if (type == node_t::BOOL_TRUE) {
+			return {true, true, 1};
+		} else if (type == node_t::BOOL_FALSE) {
+			return {true, true, 0};
+		} else if (type == node_t::IDENTIFIER) {
+			return {false, tree_.bind(nd) == ast::bind_t::DEFINED, 0};
+		}
+		return {false, false, 0}; // ?
+	}
+
+	optimizer::value_info optimizer::fold_unary(idx_t nd, bool truth_only) {
+		unOp_t op = tree_.unop(nd);
+		idx_t rhs = tree_[nd].rhs_;
+		value_info val = fold_expr(rhs, op == unOp_t::LOGICAL_NEGATION);
+		if (val.is_const) {
+			return make_const(nd, arith_unary(op, val.val));
+		}
+		if (
+			tree_[rhs].type_ == node_t::UNARY_OPERATION && tree_.unop(rhs) == op
+		) {
+			idx_t inner = tree_[rhs].rhs_;
+			if (op == unOp_t::NEGATION) { // - -x is x even for INT_MIN
+				return replace(nd, inner, val);
+			} else if (truth_only || is_boolean(inner)) {
+				return replace(nd, inner, val);
+			}
+		}
+		return {false, val.pure, 0};
+	}
+
+	optimizer::value_info optimizer::fold_binary(idx_t nd, bool truth_only) {
+		binOp_t op = tree_.binop(nd);
+		idx_t lhs_nd = tree_[nd].lhs_, rhs_nd = tree_[nd].rhs_;
+		bool logical = op == binOp_t::OR || op == binOp_t::AND;
+		value_info lhs = fold_expr(lhs_nd, logical);
+		value_info rhs = fold_expr(rhs_nd, logical);
+		if (logical) {
+			return fold_logical(nd, lhs, rhs, truth_only);
+		}
+
+		bool div = op == binOp_t::DIVISION || op == binOp_t::REMAINDER;
+		if (lhs.is_const && rhs.is_const && !(div && rhs.val == 0)) {
+			return make_const(nd, arith_binary(op, lhs.val, rhs.val));
+		}
+		value_info ret = {
+			false, lhs.pure && rhs.pure && !(div && !(rhs.is_const && rhs.val != 0)), 0
+		};
+		bool lhs_is = lhs.is_const, rhs_is = rhs.is_const;
+		if (op == binOp_t::ADDITION) {
+			if (lhs_is && lhs.val == 0) {
+				return replace(nd, rhs_nd, ret);
+			} else if (rhs_is && rhs.val == 0) {
+				return replace(nd, lhs_nd, ret);
+			}
+		} else if (op == binOp_t::SUBSTRACTION) {
+			idx_t by;
+			if (rhs_is && rhs.val == 0) {
+				return replace(nd, lhs_nd, ret);
+			} else if (is_remainder(lhs_nd, rhs_nd, by)) {
+				tree_[nd].op_ = static_cast<unsigned char>(binOp_t::REMAINDER);
+				tree_[nd].rhs_ = by;
+				int d = tree_[by].val_;
+				if (tree_[by].type_ == node_t::INTEGER_LITERAL && (d > 1 || d < -1)) {
+					tree_.set_divisor(nd, d);
+				}
+			}
+		} else if (op == binOp_t::MULTIPLICATION) {
+			if (
+				(lhs_is && lhs.val == 0 && rhs.pure) || \
+				(rhs_is && rhs.val == 0 && lhs.pure)
+			) {
+				return make_const(nd, 0);
+			} else if (lhs_is && lhs.val == 1) {
+				return replace(nd, rhs_nd, ret);
+			} else if (rhs_is && rhs.val == 1) {
+				return replace(nd, lhs_nd, ret);
+			} else if (rhs_is && rhs.val == -1) { // x * -1 is -x, it wraps the same
+				tree_[nd].type_ = node_t::UNARY_OPERATION;
+				tree_[nd].op_ = static_cast<unsigned char>(unOp_t::NEGATION);
+				tree_[nd].rhs_ = lhs_nd;
+			}
+		} else if (div && rhs_is) {
+			if (op == binOp_t::REMAINDER && (rhs.val == 1 || rhs.val == -1)) {
+				if (lhs.pure) {
+					return make_const(nd, 0);
+				}
+			} else if (rhs.val == 1) {
+				return replace(nd, lhs_nd, ret);
+			} else if (rhs.val == -1) { // INT_MIN / -1 is INT_MIN, so is -INT_MIN
+				tree_[nd].type_ = node_t::UNARY_OPERATION;
+				tree_[nd].op_ = static_cast<unsigned char>(unOp_t::NEGATION);
+				tree_[nd].rhs_ = lhs_nd;
+			} else if (rhs.val != 0) {
+				tree_.set_divisor(nd, rhs.val);
+			}
+		}
+		return ret;
+	}
+
+	// x - c * (x / c) and x - (x / c) * c are x % c, by is set to c then; x is
+	// evaluated once instead of twice, so it must not read ?
+	bool optimizer::is_remainder(idx_t x, idx_t prod, idx_t& by) const {
+		if (
+			tree_[prod].type_ != node_t::BINARY_OPERATION || \
+			tree_.binop(prod) != binOp_t::MULTIPLICATION
+		) {
+			return false;
+		}
+		idx_t quot = tree_[prod].rhs_, other = tree_[prod].lhs_;
+		for (int i = 0; i < 2; ++i, std::swap(quot, other)) {
+			if (
+				tree_[quot].type_ == node_t::BINARY_OPERATION && \
+				tree_.binop(quot) == binOp_t::DIVISION && \
+				same_expr(tree_[quot].lhs_, x) && same_expr(tree_[quot].rhs_, other)
+			) {
+				by = tree_[quot].rhs_;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool optimizer::same_expr(idx_t a, idx_t b) const {
+		const ast::node& lhs = tree_[a];
+		const ast::node& rhs = tree_[b];
+		if (lhs.type_ != rhs.type_) {
+			return false;
+		}
+		switch (lhs.type_) {
+			case node_t::INTEGER_LITERAL: case node_t::IDENTIFIER:
+				return lhs.val_ == rhs.val_;
+			case node_t::BOOL_TRUE: case node_t::BOOL_FALSE:
+				return true;
+			case node_t::UNARY_OPERATION:
+				return lhs.op_ == rhs.op_ && same_expr(lhs.rhs_, rhs.rhs_);
+			case node_t::BINARY_OPERATION:
+				return lhs.op_ == rhs.op_ && same_expr(lhs.lhs_, rhs.lhs_) && \
+					same_expr(lhs.rhs_, rhs.rhs_);
+			default:
+				return false; // ? is read anew each time
+		}
+	}
+
+	// a constant operand either decides the result, then the other one is
+	// dropped if it may be, or leaves the other operand converted to bool
+	optimizer::value_info optimizer::fold_logical(
+		idx_t nd, const value_info& lhs, const value_info& rhs, bool truth_only
+	) {
+		int decisive = tree_.binop(nd) == binOp_t::OR; // the value deciding alone
+		idx_t lhs_nd = tree_[nd].lhs_, rhs_nd = tree_[nd].rhs_;
+		if (lhs.is_const) {
+			if ((lhs.val != 0) == decisive) {
+				return make_const(nd, decisive); // rhs is never evaluated
+			}
+			return fold_to_bool(nd, rhs_nd, rhs, truth_only);
+		} else if (rhs.is_const) {
+			if ((rhs.val != 0) == decisive) {
+				if (lhs.pure) {
+					return make_const(nd, decisive);
+				}
+				return {false, false, 0};
+			}
+			return fold_to_bool(nd, lhs_nd, lhs, truth_only);
+		}
+		return {false, lhs.pure && rhs.pure, 0};
+	}
+
+	optimizer::value_info optimizer::fold_to_bool(
+		idx_t nd, idx_t by, const value_info& info, bool truth_only
+	) {
+		if (info.is_const) {
+			return make_const(nd, info.val != 0);
+		} else if (truth_only || is_boolean(by)) {
+			return replace(nd, by, info);
+		}
+		return {false, info.pure, 0};
+	}
+
+	optimizer::value_info optimizer::make_const(idx_t nd, int val) {
+		ast::node lit = {};
+		lit.type_ = node_t::INTEGER_LITERAL;
+		lit.val_ = val;
+		tree_[nd] = lit;
+		return {true, true, val};
+	}
+
+	optimizer::value_info optimizer::replace(
+		idx_t nd, idx_t by, const value_info& info
+	) {
+		tree_[nd] = tree_[by];
+		return info;
+	}
+
+	//--------closed form of loops--------
+	//
+	//	A loop is solved when its condition compares an identifier i with a
+	//	bound it doesn't change and its body only adds to identifiers defined
+	//	before it, each once: i = i + c with a constant c taking i towards the
+	//	bound, and v = v + e or v = v - e where e is made of +, - and * of i and
+	//	of what the loop doesn't change, at most linear in i. At the k-th run
+	//	such e is e0 + k * (e1 - e0) by its values at the first two runs, so n
+	//	runs add n * e0 + n * (n - 1) / 2 * (e1 - e0) to v, and all of it wraps
+	//	around alike. n is found from the distance to the bound if i doesn't
+	//	wrap on the way there, which is checked before; the loop is run as it
+	//	is otherwise and when it doesn't run at all (do runs once then).
+
+	static const size_t no_id = static_cast<size_t>(-1);
+
+	void optimizer::solve_loops(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			idx_t first = tree_[nd].first_; // make_scope may move the lists
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				solve_loops(tree_.list(first)[i]);
+			}
+		} else if (type == node_t::IF) {
+			solve_loops(tree_[nd].body_);
+			solve_loops(tree_[nd].else_);
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			solve_loops(tree_[nd].body_);
+			if (solve_loop(nd)) {
+				++solved_;
+			}
+		}
+	}
+
+	bool optimizer::solve_loop(idx_t nd) {
+		idx_t cond = tree_[nd].cond_, body = tree_[nd].body_;
+		if (tree_[cond].type_ != node_t::BINARY_OPERATION) {
+			return false;
+		}
+		binOp_t op = tree_.binop(cond);
+		if (op < binOp_t::LESS || op > binOp_t::GREATER) {
+			return false;
+		}
+
+		std::vector<idx_t> stmts;
+		if (tree_[body].type_ == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[body].first_);
+			stmts.assign(it, it + tree_[body].count_);
+		} else {
+			stmts.push_back(body);
+		}
+		assigned_.assign(tree_.frame_size(), 0);
+		for (auto stmt : stmts) {
+			if (
+				!tree_.is_assignment(stmt) || \
+				tree_.bind(tree_[stmt].lhs_) != ast::bind_t::DEFINED || \
+				assigned_[tree_[tree_[stmt].lhs_].val_]
+			) {
+				return false;
+			}
+			assigned_[tree_[tree_[stmt].lhs_].val_] = 1;
+		}
+
+		idx_t ind_nd = tree_[cond].lhs_, bound = tree_[cond].rhs_;
+		if (
+			tree_[ind_nd].type_ != node_t::IDENTIFIER || \
+			!assigned_[tree_[ind_nd].val_]
+		) { // b < i is i > b
+			std::swap(ind_nd, bound);
+			op = static_cast<binOp_t>(
+				static_cast<int>(binOp_t::LESS) + static_cast<int>(binOp_t::GREATER) - \
+				static_cast<int>(op)
+			);
+		}
+		if (
+			tree_[ind_nd].type_ != node_t::IDENTIFIER || \
+			tree_.bind(ind_nd) != ast::bind_t::DEFINED || \
+			!assigned_[tree_[ind_nd].val_]
+		) {
+			return false;
+		}
+		size_t ind = tree_[ind_nd].val_;
+		if (degree(bound, ind) != 0) {
+			return false;
+		}
+
+		struct sum {
+			size_t id;
+			idx_t addend;
+			bool negate;
+			bool after; // i is read after it is stepped
+		};
+		std::vector<sum> sums;
+		int step = 0;
+		for (auto stmt : stmts) {
+			sum add;
+			if (!solve_sum(stmt, ind, add.id, add.addend, add.negate)) {
+				return false;
+			} else if (add.id != ind) {
+				add.after = step != 0;
+				sums.push_back(add);
+				continue;
+			}
+			int by = tree_[add.addend].val_;
+			if (
+				tree_[add.addend].type_ != node_t::INTEGER_LITERAL || \
+				by == 0 || by == INT_MIN
+			) {
+				return false;
+			}
+			step = add.negate ? -by : by;
+		}
+
+		bool up = step > 0, strict = op == binOp_t::LESS || op == binOp_t::GREATER;
+		if (up != (op == binOp_t::LESS || op == binOp_t::LESS_OR_EQUAL)) {
+			return false; // it goes away from the bound, so it wraps
+		}
+		int dist = up ? step : -step;
+		// the last value of i may be up to dist - 1 past the bound
+		int limit = up ? INT_MAX - dist + strict : INT_MIN + dist - strict;
+		bool check_limit = limit != INT_MAX && limit != INT_MIN;
+		if (tree_[bound].type_ == node_t::INTEGER_LITERAL) {
+			int val = tree_[bound].val_;
+			if (up ? val > limit : val < limit) {
+				return false;
+			}
+			check_limit = false;
+		}
+
+		// the distance may wrap around, then it is negative
+		auto make_dist = [&]() {
+			idx_t ind_read = make_read(ind), bound_copy = substitute(bound, no_id, bound);
+			return up ? tree_.make_binop(binOp_t::SUBSTRACTION, bound_copy, ind_read) : \
+				tree_.make_binop(binOp_t::SUBSTRACTION, ind_read, bound_copy);
+		};
+		idx_t guard = tree_.make_binop(
+			binOp_t::AND, substitute(cond, no_id, cond),
+			tree_.make_binop(binOp_t::GREATER_OR_EQUAL, make_dist(), tree_.make_int(0))
+		);
+		if (!strict && dist == 1) { // n would be INT_MAX + 1
+			guard = tree_.make_binop(
+				binOp_t::AND, guard,
+				tree_.make_binop(binOp_t::NOT_EQUAL, make_dist(), tree_.make_int(INT_MAX))
+			);
+		}
+		if (check_limit) {
+			guard = tree_.make_binop(
+				binOp_t::AND, guard, tree_.make_binop(
+					up ? binOp_t::LESS_OR_EQUAL : binOp_t::GREATER_OR_EQUAL,
+					substitute(bound, no_id, bound), tree_.make_int(limit)
+				)
+			);
+		}
+
+		std::vector<idx_t> solved;
+		idx_t runs = make_dist(); // (dist - 1) / step + 1 or dist / step + 1
+		if (strict && dist > 1) {
+			runs = tree_.make_binop(binOp_t::SUBSTRACTION, runs, tree_.make_int(1));
+		}
+		if (dist > 1) {
+			runs = tree_.make_binop(binOp_t::DIVISION, runs, tree_.make_int(dist));
+			tree_.set_divisor(runs, dist);
+		}
+		if (!strict || dist > 1) {
+			runs = tree_.make_binop(binOp_t::ADDITION, runs, tree_.make_int(1));
+		}
+		size_t n = tree_.make_temp();
+		solved.push_back(make_assign(n, runs, ast::bind_t::UNDEFINED));
+
+		size_t tri = no_id; // n * (n - 1) / 2 is h * (2 * n - 1 - 2 * h), h = n / 2
+		for (const auto& add : sums) {
+			if (tri != no_id || degree(add.addend, ind) == 0) {
+				continue;
+			}
+			size_t half = tree_.make_temp();
+			idx_t halved = tree_.make_binop(binOp_t::DIVISION, make_read(n), tree_.make_int(2));
+			tree_.set_divisor(halved, 2);
+			solved.push_back(make_assign(half, halved, ast::bind_t::UNDEFINED));
+			idx_t odd = tree_.make_binop(binOp_t::ADDITION, make_read(n), make_read(n));
+			odd = tree_.make_binop(binOp_t::SUBSTRACTION, odd, tree_.make_int(1));
+			odd = tree_.make_binop(binOp_t::SUBSTRACTION, odd, make_read(half));
+			odd = tree_.make_binop(binOp_t::SUBSTRACTION, odd, make_read(half));
+			tri = tree_.make_temp();
+			solved.push_back(make_assign(
+				tri, tree_.make_binop(binOp_t::MULTIPLICATION, make_read(half), odd),
+				ast::bind_t::UNDEFINED
+			));
+		}
+
+		for (const auto& add : sums) {
+			idx_t total;
+			if (degree(add.addend, ind) == 0) {
+				total = tree_.make_binop(
+					binOp_t::MULTIPLICATION, make_read(n), substitute(add.addend, no_id, 0)
+				);
+			} else {
+				int first = add.after ? step : 0;
+				idx_t at_first = tree_.make_binop(
+					binOp_t::ADDITION, make_read(ind), tree_.make_int(first)
+				);
+				idx_t at_second = tree_.make_binop(
+					binOp_t::ADDITION, make_read(ind),
+					tree_.make_int(arith_binary(binOp_t::ADDITION, first, step))
+				);
+				idx_t first_sum = tree_.make_binop(
+					binOp_t::MULTIPLICATION, make_read(n),
+					substitute(add.addend, ind, at_first)
+				);
+				idx_t diff = tree_.make_binop(
+					binOp_t::SUBSTRACTION, substitute(add.addend, ind, at_second),
+					substitute(add.addend, ind, at_first)
+				);
+				total = tree_.make_binop(
+					binOp_t::ADDITION, first_sum,
+					tree_.make_binop(binOp_t::MULTIPLICATION, make_read(tri), diff)
+				);
+			}
+			idx_t value = tree_.make_binop(
+				add.negate ? binOp_t::SUBSTRACTION : binOp_t::ADDITION,
+				make_read(add.id), total
+			);
+			solved.push_back(make_assign(add.id, value, ast::bind_t::DEFINED));
+		}
+		idx_t stepped = tree_.make_binop(
+			binOp_t::ADDITION, make_read(ind),
+			tree_.make_binop(binOp_t::MULTIPLICATION, make_read(n), tree_.make_int(step))
+		);
+		solved.push_back(make_assign(ind, stepped, ast::bind_t::DEFINED));
+
+		idx_t loop = tree_.make_copy(nd);
+		idx_t branch = tree_.make_if(guard, tree_.make_scope(solved), loop);
+		tree_[nd] = tree_[branch];
+		return true;
+	}
+
+	// v = v + e, v = e + v or v = v - e where e is at most linear in ind
+	bool optimizer::solve_sum(
+		idx_t stmt, size_t ind, size_t& id, idx_t& addend, bool& negate
+	) const {
+		idx_t rhs = tree_[stmt].rhs_;
+		id = tree_[tree_[stmt].lhs_].val_;
+		if (tree_[rhs].type_ != node_t::BINARY_OPERATION) {
+			return false;
+		}
+		binOp_t op = tree_.binop(rhs);
+		idx_t self = tree_[rhs].lhs_, other = tree_[rhs].rhs_;
+		auto is_self = [&](idx_t x) {
+			return tree_[x].type_ == node_t::IDENTIFIER && \
+				static_cast<size_t>(tree_[x].val_) == id;
+		};
+		if (op == binOp_t::ADDITION && !is_self(self)) {
+			std::swap(self, other);
+		}
+		if ((op != binOp_t::ADDITION && op != binOp_t::SUBSTRACTION) || !is_self(self)) {
+			return false;
+		}
+		addend = other;
+		negate = op == binOp_t::SUBSTRACTION;
+		int deg = degree(other, ind);
+		return deg == 0 || deg == 1;
+	}
+
+	// of nd as a polynomial in ind over what the loop doesn't change, -1 if
+	// it is not one
+	int optimizer::degree(idx_t nd, size_t ind) const {
+		switch (tree_[nd].type_) {
+			case node_t::INTEGER_LITERAL: case node_t::BOOL_TRUE:
+			case node_t::BOOL_FALSE:
+				return 0;
+			case node_t::IDENTIFIER: {
+				size_t id = tree_[nd].val_;
+				if (tree_.bind(nd) != ast::bind_t::DEFINED) {
+					return -1;
+				}
+				return id == ind ? 1 : (id < assigned_.size() && !assigned_[id] ? 0 : -1);
+			}
+			case node_t::UNARY_OPERATION:
+				return tree_.unop(nd) == unOp_t::NEGATION ? degree(tree_[nd].rhs_, ind) : -1;
+			case node_t::BINARY_OPERATION: {
+				binOp_t op = tree_.binop(nd);
+				int lhs = degree(tree_[nd].lhs_, ind), rhs = degree(tree_[nd].rhs_, ind);
+				if (lhs < 0 || rhs < 0) {
+					return -1;
+				} else if (op == binOp_t::ADDITION || op == binOp_t::SUBSTRACTION) {
+					return std::max(lhs, rhs);
+				} else if (op == binOp_t::MULTIPLICATION && lhs + rhs <= 1) {
+					return lhs + rhs;
+				}
+				return -1;
+			}
+			default:
+				return -1;
+		}
+	}
+
+	// a copy of the expression nd with copies of by in place of reads of ind
+	ast::idx_t optimizer::substitute(idx_t nd, size_t ind, idx_t by) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::IDENTIFIER && static_cast<size_t>(tree_[nd].val_) == ind) {
+			return substitute(by, no_id, by);
+		}
+		idx_t copy = tree_.make_copy(nd);
+		if (type == node_t::UNARY_OPERATION) {
+			idx_t rhs = substitute(tree_[nd].rhs_, ind, by);
+			tree_[copy].rhs_ = rhs;
+		} else if (type == node_t::BINARY_OPERATION) {
+			idx_t lhs = substitute(tree_[nd].lhs_, ind, by);
+			idx_t rhs = substitute(tree_[nd].rhs_, ind, by);
+			tree_[copy].lhs_ = lhs;
+			tree_[copy].rhs_ = rhs;
+		}
+		return copy;
+	}
+
+	ast::idx_t optimizer::make_read(size_t id) {
+		idx_t nd = tree_.make_id(id);
+		tree_[nd].op_ = static_cast<unsigned char>(ast::bind_t::DEFINED);
+		return nd;
+	}
+
+	ast::idx_t optimizer::make_assign(size_t id, idx_t value, ast::bind_t bind) {
+		idx_t lhs = tree_.make_id(id);
+		tree_[lhs].op_ = static_cast<unsigned char>(bind);
+		return tree_.make_binop(binOp_t::ASSIGNMENT, lhs, value);
+	}
+
+	//--------unrolling--------
+	//
+	//	A loop with a small body runs a few copies of it a time. When a counter
+	//	i is stepped once by a constant c towards a bound which the loop doesn't
+	//	change, and nothing else writes it, the copies run while i is at least
+	//	times - 1 steps away from the bound without checking the condition in
+	//	between; the loop runs as it is after that, for what is left. Other
+	//	loops check the condition before each copy and leave at once when it
+	//	is false, so the condition must not read ?, as it is then checked once
+	//	more by the loop. The copies of a body go one after another in one
+	//	scope: what they define is defined by each of them again anyway, since
+	//	the resolution is done by then.
+
+	static const size_t unroll_budget = 64; // nodes of all of the copies
+	static const int max_unroll = 8;
+
+	void optimizer::unroll_loops(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			idx_t first = tree_[nd].first_; // make_scope may move the lists
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				unroll_loops(tree_.list(first)[i]);
+			}
+		} else if (type == node_t::IF) {
+			unroll_loops(tree_[nd].body_);
+			unroll_loops(tree_[nd].else_);
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			unroll_loops(tree_[nd].body_);
+			if (unroll_loop(nd)) {
+				++unrolled_;
+			}
+		}
+	}
+
+	bool optimizer::unroll_loop(idx_t nd) {
+		if (
+			(tree_[nd].type_ == node_t::WHILE && tree_[nd].val_ != 0) || \
+			reads_input(tree_[nd].cond_)
+		) { // ids checked at run time are killed on each run
+			return false;
+		}
+		size_t size = count(tree_[nd].body_);
+		int times = 1;
+		while (times < max_unroll && 2 * times * size <= unroll_budget) {
+			times *= 2;
+		}
+		if (times == 1) {
+			return false;
+		}
+
+		size_t ind;
+		idx_t bound;
+		binOp_t op;
+		int step;
+		if (find_counter(nd, ind, bound, op, step)) {
+			int64_t span = static_cast<int64_t>(step) * (times - 1);
+			int64_t last = static_cast<int64_t>(tree_[bound].val_) - span;
+			if (
+				span >= INT_MIN && span <= INT_MAX && !(
+					tree_[bound].type_ == node_t::INTEGER_LITERAL && \
+					(last < INT_MIN || last > INT_MAX)
+				)
+			) {
+				unroll_counted(nd, times, ind, bound, op, step);
+				return true;
+			}
+		}
+		unroll_checked(nd, times);
+		return true;
+	}
+
+	// i op bound where i = i + c is a statement of the body and it is the
+	// only one writing i, and c takes i towards the bound
+	bool optimizer::find_counter(
+		idx_t nd, size_t& ind, idx_t& bound, binOp_t& op, int& step
+	) {
+		idx_t cond = tree_[nd].cond_, body = tree_[nd].body_;
+		if (tree_[cond].type_ != node_t::BINARY_OPERATION) {
+			return false;
+		}
+		op = tree_.binop(cond);
+		if (op < binOp_t::LESS || op > binOp_t::GREATER) {
+			return false;
+		}
+		assigned_.assign(tree_.frame_size(), 0);
+		mark_assigned(body);
+		idx_t ind_nd = tree_[cond].lhs_;
+		bound = tree_[cond].rhs_;
+		if (
+			tree_[ind_nd].type_ != node_t::IDENTIFIER || \
+			!assigned_[tree_[ind_nd].val_]
+		) {
+			std::swap(ind_nd, bound);
+			op = static_cast<binOp_t>(
+				static_cast<int>(binOp_t::LESS) + static_cast<int>(binOp_t::GREATER) - \
+				static_cast<int>(op)
+			);
+		}
+		if (
+			tree_[ind_nd].type_ != node_t::IDENTIFIER || \
+			tree_.bind(ind_nd) != ast::bind_t::DEFINED
+		) {
+			return false;
+		}
+		ind = tree_[ind_nd].val_;
+		if (degree(bound, ind) != 0) {
+			return false;
+		}
+
+		std::vector<idx_t> stmts;
+		if (tree_[body].type_ == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[body].first_);
+			stmts.assign(it, it + tree_[body].count_);
+		} else {
+			stmts.push_back(body);
+		}
+		idx_t stepping = 0;
+		step = 0;
+		assigned_.assign(tree_.frame_size(), 0);
+		for (auto stmt : stmts) {
+			size_t id;
+			idx_t addend;
+			bool negate;
+			if (
+				step == 0 && tree_.is_assignment(stmt) && \
+				static_cast<size_t>(tree_[tree_[stmt].lhs_].val_) == ind && \
+				solve_sum(stmt, ind, id, addend, negate) && \
+				tree_[addend].type_ == node_t::INTEGER_LITERAL && \
+				tree_[addend].val_ != 0 && tree_[addend].val_ != INT_MIN
+			) {
+				stepping = stmt;
+				step = negate ? -tree_[addend].val_ : tree_[addend].val_;
+			} else {
+				mark_assigned(stmt);
+			}
+		}
+		if (step == 0 || assigned_[ind] || stepping == 0) {
+			return false;
+		}
+		return (step > 0) == (op == binOp_t::LESS || op == binOp_t::LESS_OR_EQUAL);
+	}
+
+	// { last = bound - (times - 1) * c; if (no wrap) while (i op last) {
+	// body ... body } while (i op bound) body }, do runs its body once first
+	void optimizer::unroll_counted(
+		idx_t nd, int times, size_t ind, idx_t bound, binOp_t op, int step
+	) {
+		std::vector<idx_t> stmts;
+		idx_t loop = tree_.make_copy(nd);
+		if (tree_[nd].type_ == node_t::DO) {
+			append_copy(tree_[nd].body_, stmts);
+			tree_[loop].type_ = node_t::WHILE; // with no ids to check
+		}
+
+		size_t last = tree_.make_temp();
+		idx_t limit = tree_.make_binop(
+			binOp_t::SUBSTRACTION, substitute(bound, no_id, bound),
+			tree_.make_int(step * (times - 1))
+		);
+		stmts.push_back(make_assign(last, limit, ast::bind_t::UNDEFINED));
+
+		std::vector<idx_t> copies;
+		for (int i = 0; i < times; ++i) {
+			append_copy(tree_[nd].body_, copies);
+		}
+		idx_t unrolled = tree_.make_while(
+			node_t::WHILE, tree_.make_binop(op, make_read(ind), make_read(last)),
+			tree_.make_scope(copies)
+		);
+		if (tree_[bound].type_ == node_t::INTEGER_LITERAL) { // checked already
+			stmts.push_back(unrolled);
+		} else {
+			idx_t fits = tree_.make_binop(
+				step > 0 ? binOp_t::LESS_OR_EQUAL : binOp_t::GREATER_OR_EQUAL,
+				make_read(last), substitute(bound, no_id, bound)
+			);
+			stmts.push_back(tree_.make_if(fits, unrolled, tree_.make_empty()));
+		}
+		stmts.push_back(loop);
+		tree_.set_scope(nd, stmts);
+	}
+
+	// while (c) { body if (c) { body if (c) { body } } } and the same in do
+	void optimizer::unroll_checked(idx_t nd, int times) {
+		idx_t inner = 0;
+		for (int i = times; i > 0; --i) {
+			std::vector<idx_t> stmts;
+			append_copy(tree_[nd].body_, stmts);
+			if (i < times) {
+				idx_t cond = substitute(tree_[nd].cond_, no_id, 0);
+				stmts.push_back(tree_.make_if(cond, inner, tree_.make_empty()));
+			}
+			inner = tree_.make_scope(stmts);
+		}
+		tree_[nd].body_ = inner;
+	}
+
+	// copies of the statements of body, which is a scope or one statement
+	void optimizer::append_copy(idx_t body, std::vector<idx_t>& stmts) {
+		if (tree_[body].type_ != node_t::SCOPE) {
+			stmts.push_back(copy_stmt(body));
+			return;
+		}
+		idx_t first = tree_[body].first_;
+		for (idx_t i = 0, ie = tree_[body].count_; i < ie; ++i) {
+			stmts.push_back(copy_stmt(tree_.list(first)[i]));
+		}
+	}
+
+	ast::idx_t optimizer::copy_stmt(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			std::vector<idx_t> stmts;
+			idx_t first = tree_[nd].first_;
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				stmts.push_back(copy_stmt(tree_.list(first)[i]));
+			}
+			return tree_.make_scope(stmts);
+		} else if (type == node_t::IF) {
+			idx_t cond = substitute(tree_[nd].cond_, no_id, 0);
+			idx_t body = copy_stmt(tree_[nd].body_);
+			idx_t other = copy_stmt(tree_[nd].else_);
+			idx_t copy = tree_.make_copy(nd);
+			tree_[copy].cond_ = cond;
+			tree_[copy].body_ = body;
+			tree_[copy].else_ = other;
+			return copy;
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			idx_t cond = substitute(tree_[nd].cond_, no_id, 0);
+			idx_t body = copy_stmt(tree_[nd].body_);
+			idx_t copy = tree_.make_copy(nd); // the list of tracked ids is shared
+			tree_[copy].cond_ = cond;
+			tree_[copy].body_ = body;
+			return copy;
+		} else if (type == node_t::PRINT) {
+			idx_t rhs = substitute(tree_[nd].rhs_, no_id, 0);
+			idx_t copy = tree_.make_copy(nd);
+			tree_[copy].rhs_ = rhs;
+			return copy;
+		}
+		return substitute(nd, no_id, 0); // expressions and assignments
+	}
+
+	bool optimizer::reads_input(idx_t nd) const {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::UNARY_OPERATION) {
+			return reads_input(tree_[nd].rhs_);
+		} else if (type == node_t::BINARY_OPERATION) {
+			return reads_input(tree_[nd].lhs_) || reads_input(tree_[nd].rhs_);
+		}
+		return type == node_t::SCAN;
+	}
+
+	//--------loop-invariant code motion--------
+	//
+	//	An expression in while or do is invariant if every identifier it reads
+	//	is defined before the loop and is not written inside of it, where
+	//	writing is any lvalue use, since that is what defines an identifier.
+	//	Invariant expressions which can't fail and don't read ? are computed
+	//	into temporaries just before the loop, as they may be computed even if
+	//	the loop runs no times; the loop and the temporaries are put in a scope
+	//	in place of the loop. Inner loops go first, so what they hoist can be
+	//	hoisted again out of the outer ones.
+
+	void optimizer::hoist_loops(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			idx_t first = tree_[nd].first_; // set_scope may move the lists
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				hoist_loops(tree_.list(first)[i]);
+			}
+		} else if (type == node_t::IF) {
+			hoist_loops(tree_[nd].body_);
+			hoist_loops(tree_[nd].else_);
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			hoist_loops(tree_[nd].body_);
+			assigned_.assign(tree_.frame_size(), 0);
+			mark_assigned(tree_[nd].body_);
+			std::vector<idx_t> temps;
+			hoist_top(tree_[nd].cond_, temps);
+			hoist_stmt(tree_[nd].body_, temps);
+			if (!temps.empty()) {
+				temps.push_back(tree_.make_copy(nd));
+				tree_.set_scope(nd, temps);
+			}
+		}
+	}
+
+	void optimizer::mark_assigned(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[nd].first_);
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				mark_assigned(it[i]);
+			}
+		} else if (type == node_t::IF) {
+			mark_assigned(tree_[nd].body_);
+			mark_assigned(tree_[nd].else_);
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			mark_assigned(tree_[nd].body_);
+		} else if (type == node_t::PRINT) {
+			mark_lval(tree_[nd].rhs_);
+		} else if (type != node_t::EMPTY) {
+			mark_lval(nd);
+		}
+	}
+
+	void optimizer::mark_lval(idx_t nd) {
+		if (tree_.is_assignment(nd)) {
+			assigned_[tree_[tree_[nd].lhs_].val_] = 1;
+		} else if (
+			tree_[nd].type_ == node_t::IDENTIFIER && \
+			tree_.bind(nd) != ast::bind_t::DEFINED
+		) { // an identifier defined already is left as it is
+			assigned_[tree_[nd].val_] = 1;
+		}
+	}
+
+	void optimizer::hoist_stmt(idx_t nd, std::vector<idx_t>& temps) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			idx_t first = tree_[nd].first_;
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				hoist_stmt(tree_.list(first)[i], temps);
+			}
+		} else if (type == node_t::IF) {
+			hoist_top(tree_[nd].cond_, temps);
+			hoist_stmt(tree_[nd].body_, temps);
+			hoist_stmt(tree_[nd].else_, temps);
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			hoist_top(tree_[nd].cond_, temps);
+			hoist_stmt(tree_[nd].body_, temps);
+		} else if (type == node_t::PRINT) {
+			hoist_stmt(tree_[nd].rhs_, temps);
+		} else if (tree_.is_assignment(nd)) {
+			hoist_top(tree_[nd].rhs_, temps);
+		} else if (type != node_t::EMPTY && type != node_t::IDENTIFIER) {
+			hoist_top(nd, temps);
+		}
+	}
+
+	void optimizer::hoist_top(idx_t nd, std::vector<idx_t>& temps) {
+		if (hoist_expr(nd, temps) && is_operation(nd)) {
+			hoist_into_temp(nd, temps);
+		}
+	}
+
+	// tells whether nd may be hoisted, the largest parts of it which may be
+	// are hoisted if it may not
+	bool optimizer::hoist_expr(idx_t nd, std::vector<idx_t>& temps) {
+		node_t type = tree_[nd].type_;
+		if (is_operation(nd) && depth_ == max_depth) {
+			return false;
+		} else if (type == node_t::UNARY_OPERATION) {
+			++depth_;
+			bool inv = hoist_expr(tree_[nd].rhs_, temps);
+			--depth_;
+			return inv;
+		} else if (type == node_t::BINARY_OPERATION) {
+			idx_t lhs = tree_[nd].lhs_, rhs = tree_[nd].rhs_;
+			++depth_;
+			bool lhs_inv = hoist_expr(lhs, temps), rhs_inv = hoist_expr(rhs, temps);
+			--depth_;
+			binOp_t op = tree_.binop(nd);
+			bool safe = (op != binOp_t::DIVISION && op != binOp_t::REMAINDER) || (
+				tree_[rhs].type_ == node_t::INTEGER_LITERAL && tree_[rhs].val_ != 0
+			);
+			if (lhs_inv && rhs_inv && safe) {
+				return true;
+			}
+			if (lhs_inv && is_operation(lhs)) {
+				hoist_into_temp(lhs, temps);
+			}
+			if (rhs_inv && is_operation(rhs)) {
+				hoist_into_temp(rhs, temps);
+			}
+			return false;
+		} else if (type == node_t::IDENTIFIER) {
+			size_t id = tree_[nd].val_;
+			return tree_.bind(nd) == ast::bind_t::DEFINED && \
+				id < assigned_.size() && !assigned_[id]; // temporaries are written
+		}
+		return type != node_t::SCAN;
+	}
+
+	// nd turns into a read of the temporary and its copy is assigned to it
+	void optimizer::hoist_into_temp(idx_t nd, std::vector<idx_t>& temps) {
+		idx_t temp = tree_.make_temp();
+		idx_t value = tree_.make_copy(nd);
+		temps.push_back(make_assign(temp, value, ast::bind_t::UNDEFINED));
+
+		ast::node read = {};
+		read.type_ = node_t::IDENTIFIER;
+		read.op_ = static_cast<unsigned char>(ast::bind_t::DEFINED);
+		read.val_ = static_cast<int>(temp);
+		tree_[nd] = read;
+		++hoisted_;
+	}
+
+	//--------value numbering--------
+	//
+	//	Values are numbered along the statements of a scope: literals of the
+	//	same value get the same number and so do operations of the same kind on
+	//	operands of the same numbers; an identifier gets the number of what is
+	//	assigned to it and a new one when nothing is known of it, ? gets a new
+	//	number each time. An operation whose number is met again is replaced by
+	//	a read of an identifier which still holds the value or of a temporary,
+	//	which the first occurrence is then turned into an assignment to; it has
+	//	been evaluated by then, as operands go left to right. What is met under
+	//	the right operand of && and || is forgotten after it, it may be not
+	//	evaluated. Compound statements are not looked into from outside and
+	//	everything is forgotten around them, but the condition of if goes with
+	//	the statements before it.
+
+	void optimizer::number_stmt(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			forget();
+			idx_t first = tree_[nd].first_;
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				number_stmt(tree_.list(first)[i]);
+			}
+			forget();
+		} else if (type == node_t::IF) {
+			number_top(tree_[nd].cond_);
+			forget();
+			number_stmt(tree_[nd].body_);
+			forget();
+			number_stmt(tree_[nd].else_);
+			forget();
+		} else if (type == node_t::WHILE || type == node_t::DO) {
+			forget(); // the condition is evaluated again after the body
+			number_top(tree_[nd].cond_);
+			forget();
+			number_stmt(tree_[nd].body_);
+			forget();
+		} else if (type == node_t::PRINT) {
+			number_right(tree_[nd].rhs_);
+		} else if (type != node_t::EMPTY) {
+			number_right(nd);
+		}
+	}
+
+	void optimizer::number_right(idx_t nd) {
+		if (tree_.is_assignment(nd)) {
+			idx_t rhs = tree_[nd].rhs_;
+			bool computed = is_operation(rhs);
+			number_top(rhs);
+			uint32_t number = numbered_[rhs];
+			size_t id = tree_[tree_[nd].lhs_].val_;
+			value_of(id);
+			values_[id] = {epoch_, number};
+			auto it = holders_.find(number);
+			if (computed && (it == holders_.end() || it->second.place != place_t::TEMP)) {
+				holders_[number] = {place_t::ID, 0, id}; // needs no temporary
+			}
+		} else if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			if (tree_.bind(nd) != ast::bind_t::DEFINED) { // 0 or what it was
+				size_t id = tree_[nd].val_;
+				value_of(id);
+				values_[id] = {epoch_, next_number_++};
+			}
+		} else {
+			number_top(nd);
+		}
+	}
+
+	void optimizer::number_top(idx_t nd) {
+		number_expr(nd);
+		reuse_expr(nd);
+	}
+
+	uint32_t optimizer::number_expr(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		uint32_t kind = static_cast<uint32_t>(type) << 8 | tree_[nd].op_;
+		uint32_t number;
+		if (is_operation(nd) && depth_ == max_depth) {
+			number = next_number_++; // not looked into, like ?
+		} else if (type == node_t::UNARY_OPERATION) {
+			++depth_;
+			number = number_of({kind, number_expr(tree_[nd].rhs_), 0});
+			--depth_;
+		} else if (type == node_t::BINARY_OPERATION) {
+			++depth_;
+			uint32_t lhs = number_expr(tree_[nd].lhs_);
+			uint32_t rhs = number_expr(tree_[nd].rhs_);
+			--depth_;
+			binOp_t op = tree_.binop(nd);
+			idx_t by;
+			if (op == binOp_t::SUBSTRACTION && holds_quotient(nd, by)) {
+				op = binOp_t::REMAINDER;
+				tree_[nd].op_ = static_cast<unsigned char>(op);
+				tree_[nd].rhs_ = by;
+				tree_.set_divisor(nd, tree_[by].val_);
+				kind = static_cast<uint32_t>(type) << 8 | tree_[nd].op_;
+				rhs = numbered_[by];
+				++reused_;
+			}
+			if (
+				(op == binOp_t::ADDITION || op == binOp_t::MULTIPLICATION || \
+				op == binOp_t::EQUAL || op == binOp_t::NOT_EQUAL) && lhs > rhs
+			) { // not && and ||, the right operand may be not evaluated
+				std::swap(lhs, rhs);
+			}
+			number = number_of({kind, lhs, rhs});
+		} else if (type == node_t::IDENTIFIER) {
+			number = value_of(tree_[nd].val_);
+		} else if (type == node_t::SCAN) {
+			number = next_number_++;
+		} else {
+			int val = type == node_t::INTEGER_LITERAL ? tree_[nd].val_ : \
+				type == node_t::BOOL_TRUE;
+			kind = static_cast<uint32_t>(node_t::INTEGER_LITERAL) << 8;
+			number = number_of({kind, static_cast<uint32_t>(val), 0});
+		}
+		if (nd >= numbered_.size()) {
+			numbered_.resize(tree_.size());
+		}
+		numbered_[nd] = number;
+		return number;
+	}
+
+	// x - c * q where q holds x / c, as in q = x / c; r = x - c * q, is x % c
+	// like what is_remainder finds in one expression; by is set to c then
+	bool optimizer::holds_quotient(idx_t nd, idx_t& by) {
+		idx_t prod = tree_[nd].rhs_;
+		if (
+			tree_[prod].type_ != node_t::BINARY_OPERATION || \
+			tree_.binop(prod) != binOp_t::MULTIPLICATION
+		) {
+			return false;
+		}
+		idx_t lit = tree_[prod].lhs_, quot = tree_[prod].rhs_;
+		if (tree_[lit].type_ != node_t::INTEGER_LITERAL) {
+			std::swap(lit, quot);
+		}
+		int d = tree_[lit].val_;
+		if (
+			tree_[lit].type_ != node_t::INTEGER_LITERAL || (d >= -1 && d <= 1) || \
+			tree_[quot].type_ != node_t::IDENTIFIER || \
+			tree_.bind(quot) != ast::bind_t::DEFINED // it is not read anymore
+		) {
+			return false;
+		}
+		uint32_t kind = static_cast<uint32_t>(node_t::BINARY_OPERATION) << 8 | \
+			static_cast<uint32_t>(binOp_t::DIVISION);
+		auto it = numbers_.find({kind, numbered_[tree_[nd].lhs_], numbered_[lit]});
+		if (it == numbers_.end() || it->second != numbered_[quot]) {
+			return false;
+		}
+		by = lit;
+		return true;
+	}
+
+	uint32_t optimizer::number_of(const value_key& key) {
+		auto ins = numbers_.emplace(key, next_number_);
+		if (ins.second) {
+			++next_number_;
+		}
+		return ins.first->second;
+	}
+
+	uint32_t optimizer::value_of(size_t id) {
+		if (id >= values_.size()) {
+			values_.resize(tree_.frame_size(), {0, 0});
+		}
+		id_value& value = values_[id];
+		if (value.epoch != epoch_) {
+			value = {epoch_, next_number_++};
+		}
+		return value.number;
+	}
+
+	// goes as deep as number_expr
+	void optimizer::reuse_expr(idx_t nd) {
+		if (!is_operation(nd) || depth_ == max_depth) {
+			return;
+		}
+		uint32_t number = numbered_[nd];
+		auto it = holders_.find(number);
+		if (it != holders_.end() && reuse(nd, it->second)) {
+			return;
+		}
+		holders_[number] = {place_t::NODE, nd, 0};
+		added_.push_back(number);
+
+		++depth_;
+		if (tree_[nd].type_ == node_t::UNARY_OPERATION) {
+			reuse_expr(tree_[nd].rhs_);
+			--depth_;
+			return;
+		}
+		reuse_expr(tree_[nd].lhs_);
+		size_t mark = added_.size();
+		reuse_expr(tree_[nd].rhs_);
+		--depth_;
+		binOp_t op = tree_.binop(nd);
+		if (op == binOp_t::OR || op == binOp_t::AND) {
+			for (size_t i = mark, ie = added_.size(); i < ie; ++i) {
+				holders_.erase(added_[i]);
+			}
+			added_.resize(mark);
+		}
+	}
+
+	// false if the identifier holds something else by now
+	bool optimizer::reuse(idx_t nd, holder& from) {
+		if (from.place == place_t::ID && value_of(from.id) != numbered_[nd]) {
+			return false;
+		} else if (from.place == place_t::NODE) {
+			idx_t first = from.nd;
+			size_t temp = tree_.make_temp();
+			idx_t value = tree_.make_copy(first);
+			idx_t lhs = tree_.make_id(temp);
+			tree_[lhs].op_ = static_cast<unsigned char>(ast::bind_t::UNDEFINED);
+			idx_t assign = tree_.make_binop(binOp_t::ASSIGNMENT, lhs, value);
+			tree_[first] = tree_[assign];
+			from = {place_t::TEMP, 0, temp};
+		}
+
+		ast::node read = {};
+		read.type_ = node_t::IDENTIFIER;
+		read.op_ = static_cast<unsigned char>(ast::bind_t::DEFINED);
+		read.val_ = static_cast<int>(from.id);
+		tree_[nd] = read;
+		++reused_;
+		return true;
+	}
+
+	void optimizer::forget() {
+		holders_.clear();
+		added_.clear();
+		++epoch_;
+	}
+
+}
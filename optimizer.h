@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "types_decl.h"
+
+namespace cplr {
+
+	// rewrites a resolved tree in place between parsing and running it, so
+	// that what resolution found stays true
+	class optimizer final {
+	public:
+		explicit optimizer(ast& tree);
+		void run(); // all of the passes
+		void fold();
+		void solve(); // needs the whole program, see ast::make_temp
+		void unroll(); // the same
+		void hoist(); // the same
+		void number(); // the same; goes last, it puts assignments in expressions
+		size_t eliminated() const; // nodes no longer reachable from the root
+		size_t solved() const; // loops replaced by what they compute
+		size_t unrolled() const; // loops running a few copies of the body a time
+		size_t hoisted() const; // expressions moved out of loops
+		size_t reused() const; // expressions replaced by values computed before
+
+	private:
+		using idx_t = ast::idx_t;
+
+		struct value_info { // what is known about an expression after folding
+			bool is_const;
+			bool pure; // can be dropped: reads no ?, can't fail at run time
+			int val; // if is_const
+		};
+
+		struct value_key { // an operation on value numbers or a literal
+			uint32_t kind; // type and op
+			uint32_t lhs;
+			uint32_t rhs;
+
+			bool operator==(const value_key& other) const {
+				return kind == other.kind && lhs == other.lhs && rhs == other.rhs;
+			}
+		};
+
+		struct value_key_hash {
+			size_t operator()(const value_key& key) const {
+				uint64_t mix = (static_cast<uint64_t>(key.lhs) << 32) | key.rhs;
+				return (mix ^ key.kind) * 0x9E3779B97F4A7C15ull >> 16;
+			}
+		};
+
+		struct id_value { // the value number of an identifier in an epoch
+			uint32_t epoch;
+			uint32_t number;
+		};
+
+		enum class place_t : unsigned char {
+			NODE, // the first occurrence, it is put into a temporary when reused
+			ID, // an identifier it was assigned to, while it still holds it
+			TEMP // written once by the first occurrence
+		};
+
+		struct holder { // where a value numbered already may be read from
+			place_t place;
+			idx_t nd; // NODE
+			size_t id; // ID and TEMP
+		};
+
+		size_t count(idx_t nd) const;
+		bool is_boolean(idx_t nd) const; // the value is 0 or 1
+		bool is_operation(idx_t nd) const;
+
+		void fold_stmt(idx_t nd);
+		void fold_scope(idx_t nd);
+		void fold_right(idx_t nd);
+		value_info fold_top(idx_t nd, bool truth_only);
+		value_info fold_expr(idx_t nd, bool truth_only);
+		value_info fold_unary(idx_t nd, bool truth_only);
+		value_info fold_binary(idx_t nd, bool truth_only);
+		value_info fold_logical(
+			idx_t nd, const value_info& lhs, const value_info& rhs, bool truth_only
+		);
+		value_info fold_to_bool(
+			idx_t nd, idx_t by, const value_info& info, bool truth_only
+		);
+
+		bool is_remainder(idx_t x, idx_t prod, idx_t& by) const;
+		bool same_expr(idx_t a, idx_t b) const;
+
+		value_info make_const(idx_t nd, int val);
+		value_info replace(idx_t nd, idx_t by, const value_info& info);
+		void replace_by_stmt(idx_t nd, idx_t by);
+
+		void solve_loops(idx_t nd);
+		bool solve_loop(idx_t nd);
+		bool solve_sum(
+			idx_t stmt, size_t ind, size_t& id, idx_t& addend, bool& negate
+		) const;
+		int degree(idx_t nd, size_t ind) const;
+		idx_t substitute(idx_t nd, size_t ind, idx_t by);
+		idx_t make_read(size_t id);
+		idx_t make_assign(size_t id, idx_t value, ast::bind_t bind);
+
+		void unroll_loops(idx_t nd);
+		bool unroll_loop(idx_t nd);
+		bool find_counter(
+			idx_t nd, size_t& ind, idx_t& bound, binOp_t& op, int& step
+		);
+		void unroll_counted(
+			idx_t nd, int times, size_t ind, idx_t bound, binOp_t op, int step
+		);
+		void unroll_checked(idx_t nd, int times);
+		void append_copy(idx_t body, std::vector<idx_t>& stmts);
+		idx_t copy_stmt(idx_t nd);
+		bool reads_input(idx_t nd) const;
+
+		void hoist_loops(idx_t nd);
+		void mark_assigned(idx_t nd);
+		void mark_lval(idx_t nd);
+		void hoist_stmt(idx_t nd, std::vector<idx_t>& temps);
+		void hoist_top(idx_t nd, std::vector<idx_t>& temps);
+		bool hoist_expr(idx_t nd, std::vector<idx_t>& temps);
+		void hoist_into_temp(idx_t nd, std::vector<idx_t>& temps);
+
+		void number_stmt(idx_t nd);
+		void number_top(idx_t nd);
+		void number_right(idx_t nd);
+		uint32_t number_expr(idx_t nd);
+		bool holds_quotient(idx_t nd, idx_t& by);
+		uint32_t number_of(const value_key& key);
+		uint32_t value_of(size_t id);
+		void reuse_expr(idx_t nd);
+		bool reuse(idx_t nd, holder& from);
+		void forget();
+
+		ast& tree_;
+		size_t eliminated_;
+		size_t solved_;
+		size_t unrolled_;
+		size_t hoisted_;
+		size_t reused_;
+		size_t depth_; // of operations looked into, see max_depth
+		std::vector<unsigned char> assigned_; // ids written by the loop, by id
+
+		std::unordered_map<value_key, uint32_t, value_key_hash> numbers_;
+		std::unordered_map<uint32_t, holder> holders_; // by value number
+		std::vector<uint32_t> added_; // to holders_, dropped after && and ||
+		std::vector<uint32_t> numbered_; // value numbers of nodes, by node
+		std::vector<id_value> values_; // by id
+		uint32_t next_number_;
+		uint32_t epoch_;
+	};
+
+}
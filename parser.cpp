@@ -1,156 +1,40 @@
 #include "parser.h"
+
+#include <climits>
 //#include "types_decl.h"
 
 namespace cplr {
 
-	parser::node_ast::node_ast(node_t type, node_ast *parent)
-	: parent_(parent)
-	, type_(type)
-	{}
-
-	parser::node_ast::~node_ast() {}
-
-	parser::scope_ast::scope_ast()
-	: node_ast(node_t::SCOPE)
+	parser::parser()
+	: toks_(nullptr)
+	, stream_(nullptr)
+	, next_(0)
+	, err_ctr(0)
+	, in_(nullptr)
+	, out_(nullptr)
+	, tier_(nullptr)
 	{}
 
-	parser::node_ast::operator node_t() const {
-	 return type_;
+	const ast& parser::get_ast() const {
+		return tree_;
 	}
 
-	parser::id_ast::id_ast(size_t id, node_ast *parent)
-	: node_ast(node_t::IDENTIFIER, parent)
-	, id_(id)
-	{}
-
-	parser::id_ast::id_ast(const cplr::id& nd, node_ast *parent)
-	: node_ast(node_t::IDENTIFIER, parent)
-	, id_(nd.get_id())
-	{}
-
-	parser::intLit_ast::intLit_ast(int int_lit, node_ast *parent)
-	: node_ast(node_t::INTEGER_LITERAL, parent)
-	, int_lit_(int_lit)
-	{}
-
-	parser::intLit_ast::intLit_ast(const cplr::intLit& nd, node_ast *parent)
-	: node_ast(node_t::INTEGER_LITERAL, parent)
-	, int_lit_(nd.get_int())
-	{}
-
-	parser::print_ast::print_ast()
-	: node_ast(node_t::PRINT)
-	, val_(nullptr)
-	{}
-
-	parser::print_ast::print_ast(node_ast *val, node_ast *parent)
-	: node_ast(node_t::PRINT, parent)
-	, val_(val)
-	{}
-
-	parser::while_ast::while_ast(
-		node_t type, node_ast *cond, node_ast *body, node_ast *parent
-	)
-	: node_ast(type, parent)
-	, cond_(cond)
-	, body_(body)
-	{}
-
-	parser::if_ast::if_ast()
-	: node_ast(node_t::IF)
-	, cond_(nullptr)
-	, if_body_(nullptr)
-	, else_body_(nullptr)
-	{}
-
-	parser::if_ast::if_ast(
-			node_ast *cond, node_ast *if_body, node_ast *else_body, node_ast *parent
-	)
-	: node_ast(node_t::IF, parent)
-	, cond_(cond)
-	, if_body_(if_body)
-	, else_body_(else_body)
-	{}
-
-	parser::unOp_ast::unOp_ast(unOp_t op, node_ast *rhs, node_ast *parent)
-	: node_ast(node_t::UNARY_OPERATION, parent)
-	, op_(op)
-	, rhs_(rhs)
-	{}
-
-	parser::unOp_ast::unOp_ast(
-		const cplr::unOp& nd, node_ast *rhs, node_ast *parent
-	)
-	: node_ast(node_t::UNARY_OPERATION, parent)
-	, op_(nd.get_op())
-	, rhs_(rhs)
-	{}
-
-	parser::binOp_ast::binOp_ast(
-		binOp_t op, node_ast *lhs, node_ast *rhs, node_ast *parent
-	)
-	: node_ast(node_t::BINARY_OPERATION, parent)
-	, op_(op)
-	, lhs_(lhs)
-	, rhs_(rhs)
-	{}
-
-	parser::binOp_ast::binOp_ast(
-		const cplr::binOp& nd, node_ast *lhs, node_ast *rhs, node_ast *parent
-	)
-	: node_ast(node_t::BINARY_OPERATION, parent)
-	, op_(nd.get_op())
-	, lhs_(lhs)
-	, rhs_(rhs)
-	{}
-
-	parser::empty_ast::empty_ast()
-	: node_ast (node_t::EMPTY)
-	{}
-
-	parser::empty_ast::empty_ast(node_ast *parent)
-	: node_ast (node_t::EMPTY, parent)
-	{}
+	ast& parser::get_ast() {
+		return tree_;
+	}
 
-	parser::parser()
-	: root_(new empty_ast())
-	, err_ctr(0)
-	{}
+	size_t parser::get_err_ctr() const {
+		return err_ctr;
+	}
 
-	parser::~parser() {
-		parser_dct_aux(root_);
+	node_t parser::kind(tk_t it) const {
+		return toks_->kind(it);
 	}
 
-	void parser::parser_dct_aux(node_ast *nd) {
-		if (*nd == node_t::SCOPE) {
-			auto nd_scope = reinterpret_cast<scope_ast *>(nd);
-			for (
-				auto it = nd_scope->nodes_.begin(), ite = nd_scope->nodes_.end(); \
-				it != ite; ++it
-			) {
-				parser_dct_aux(*it);
-			}
-		} else if (*nd == node_t::PRINT) {
-			auto nd_print = reinterpret_cast<print_ast *>(nd);
-			parser_dct_aux(nd_print->val_);
-		} else if (*nd == node_t::IF) {
-			auto nd_if = reinterpret_cast<if_ast *>(nd);
-			parser_dct_aux(nd_if->cond_);
-			parser_dct_aux(nd_if->if_body_);
-			parser_dct_aux(nd_if->else_body_);
-		} else if (*nd == node_t::DO || *nd == node_t::WHILE) {
-			auto nd_while = reinterpret_cast<while_ast *>(nd);
-			parser_dct_aux(nd_while->cond_);
-			parser_dct_aux(nd_while->body_);
-		} else if (*nd == node_t::UNARY_OPERATION) {
-			auto nd_unop = reinterpret_cast<unOp_ast *>(nd);
-			parser_dct_aux(nd_unop->rhs_);
-		} else if (*nd == node_t::BINARY_OPERATION) {
-			auto nd_binop = reinterpret_cast<binOp_ast *>(nd);
-			parser_dct_aux(nd_binop->lhs_);
-			parser_dct_aux(nd_binop->rhs_);
-		}
-		delete nd;
+	// tokens of a stream are pulled when they are needed for the first time
+	bool parser::at_end(tk_t it) {
+		while (it >= toks_->end() && stream_ != nullptr && stream_->pull()) {}
+		return it >= toks_->end();
 	}
 
 	//--------rules--------
@@ -177,39 +61,91 @@ namespace cplr {
 	//	factor -> ( bool ) | id | int | scn | true | false
 	//	id -> [node_t::IDENTIFIER]
 	//	int -> [node_t::INTEGER_LITERAL]
-	//	scn -> cin >>
+	//	scn -> ?
+	//
+	//	bool ... term are parsed in one pass by precedence climbing, see
+	//	parse_binary, the levels above are kept as the reference
+
+	int parser::parse(const token_buffer& toks) {
+		toks_ = &toks;
+		stream_ = nullptr;
+		return parse_all();
+	}
 
-	int parser::parse(RandomAccessIt begin, RandomAccessIt end) {
-		parser_dct_aux(root_);
+	int parser::parse(token_source& toks) {
+		toks_ = &toks.window();
+		stream_ = &toks;
+		return parse_all();
+	}
+
+	int parser::parse_all() {
+		tk_t begin = toks_->end() - static_cast<tk_t>(toks_->size());
+		tree_.clear();
 		errors.clear();
 		err_ctr = 0;
-		root_ = parse_stmts(begin, end);
-		if (begin != end) {
-			++err_ctr;
-			errors += "Stray token\n";
-		}
+		tree_.set_root(parse_stmts(begin));
+		check_stray(begin);
 		if (err_ctr > 0) {
 			std::cerr << errors;
 			return -1;
 		}
+		tree_.resolve();
 		return 0;
 	}
 
-	parser::node_ast * parser::parse_block(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		node_ast *nd; // aka interior node
-		if (cur == end) {
-			nd = new empty_ast();
-		} else if (**cur == node_t::OPEN_BRACE) {
-			nd = parse_stmts(++cur, end);
-			if (cur == end || **cur != node_t::CLOSE_BRACE) {
+	void parser::check_stray(tk_t cur) {
+		if (!at_end(cur) || cur != toks_->end()) { // a missing } is skipped too
+			++err_ctr;
+			errors += "Stray token\n";
+		}
+	}
+
+	// the program is parsed by top-level statements, each one is put into a
+	// tree of its own replacing the previous one and is resolved as a part of
+	// the whole program; parse_next returns 1 for a statement, 0 at the end
+	// and -1 on errors, which are left for get_errors
+	void parser::parse_begin(token_source& toks) {
+		toks_ = &toks.window();
+		stream_ = &toks;
+		next_ = toks_->end() - static_cast<tk_t>(toks_->size());
+		tree_.clear();
+		tree_.resolve_begin();
+		errors.clear();
+		err_ctr = 0;
+	}
+
+	int parser::parse_next() {
+		if (err_ctr > 0) return -1;
+
+		if (!at_end(next_) && kind(next_) != node_t::CLOSE_BRACE) {
+			tree_.drop_nodes();
+			tree_.set_root(parse_stmt(next_));
+			if (err_ctr == 0) {
+				tree_.resolve_more(tree_.root());
+				return 1;
+			}
+		}
+		check_stray(next_);
+		return err_ctr > 0 ? -1 : 0;
+	}
+
+	const std::string& parser::get_errors() const {
+		return errors;
+	}
+
+	parser::idx_t parser::parse_block(tk_t& cur) {
+		idx_t nd; // aka interior node
+		if (at_end(cur)) {
+			nd = tree_.make_empty();
+		} else if (kind(cur) == node_t::OPEN_BRACE) {
+			nd = parse_stmts(++cur);
+			if (at_end(cur) || kind(cur) != node_t::CLOSE_BRACE) {
 				++err_ctr;
 				errors += "Expected }\n";
 			}
 			++cur;
 		} else {
-			nd = new empty_ast();
+			nd = tree_.make_empty();
 			++err_ctr;
 			errors += "Expected {\n";
 		}
@@ -217,40 +153,37 @@ namespace cplr {
 		return nd;
 	}
 
-	parser::scope_ast * parser::parse_stmts(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		scope_ast *nd = new scope_ast();
-		while (err_ctr == 0 && cur != end && **cur != node_t::CLOSE_BRACE) {
-			nd->nodes_.push_back(parse_stmt(cur, end));
+	parser::idx_t parser::parse_stmts(tk_t& cur) {
+		std::vector<idx_t> stmts;
+		while (err_ctr == 0 && !at_end(cur) && kind(cur) != node_t::CLOSE_BRACE) {
+			stmts.push_back(parse_stmt(cur));
 		}
 
-		return nd;
+		return tree_.make_scope(stmts);
 	}
 
-	bool parser::if_bool(RandomAccessIt it) {
+	bool parser::if_bool(tk_t it) {
+		node_t type = kind(it);
 		return (
-			**it == node_t::UNARY_OPERATION || **it == node_t::BINARY_OPERATION \
-			|| **it == node_t::IDENTIFIER || **it == node_t::INTEGER_LITERAL \
-			|| **it == node_t::SCAN \
-			|| **it == node_t::BOOL_TRUE || **it == node_t::BOOL_FALSE \
-			|| **it == node_t::OPEN_PARENTHESIS || **it == node_t::CLOSE_PARENTHESIS
+			type == node_t::UNARY_OPERATION || type == node_t::BINARY_OPERATION \
+			|| type == node_t::IDENTIFIER || type == node_t::INTEGER_LITERAL \
+			|| type == node_t::SCAN \
+			|| type == node_t::BOOL_TRUE || type == node_t::BOOL_FALSE \
+			|| type == node_t::OPEN_PARENTHESIS || type == node_t::CLOSE_PARENTHESIS
 		);
 	}
 
-	parser::RandomAccessIt parser::find_bool_end(
-		RandomAccessIt begin, RandomAccessIt end
-	) {
+	parser::tk_t parser::find_bool_end(tk_t begin) {
 		int ctr = 0; // aka parentheses counter
-		RandomAccessIt it;
+		tk_t it;
 		for (
 			it = begin; \
-			it != end && ctr >= 0 && if_bool(it); \
+			!at_end(it) && ctr >= 0 && if_bool(it); \
 			++it
 		) {
-			if (**it == node_t::OPEN_PARENTHESIS) {
+			if (kind(it) == node_t::OPEN_PARENTHESIS) {
 				++ctr;
-			} else if (**it == node_t::CLOSE_PARENTHESIS) {
+			} else if (kind(it) == node_t::CLOSE_PARENTHESIS) {
 				--ctr;
 				if (ctr < 0) {
 					break;
@@ -261,136 +194,107 @@ namespace cplr {
 		return it;
 	}
 
-	parser::if_ast * parser::handle_if_else(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		if_ast *nd_if;
-		if (++cur == end || **cur != node_t::OPEN_PARENTHESIS) {
+	parser::idx_t parser::handle_if_else(tk_t& cur) {
+		if (at_end(++cur) || kind(cur) != node_t::OPEN_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected (\n";
 		} else {
 			++cur;
 		}
-		auto bool_end = find_bool_end(cur, end);
-		nd_if = new if_ast(parse_bool(cur, bool_end));
-		nd_if->cond_->parent_ = nd_if;
-		cur = bool_end;
-		if (cur == end || **cur != node_t::CLOSE_PARENTHESIS) {
+		idx_t nd_cond = parse_bool(cur);
+		if (at_end(cur) || kind(cur) != node_t::CLOSE_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected )\n";
 		} else {
 			++cur;
 		}
-		node_ast *nd_if_body = parse_stmt(cur, end);
-		nd_if->if_body_ = nd_if_body;
-		nd_if_body->parent_ = nd_if;
-		node_ast *nd_else_body;
-		if (cur != end && **cur == node_t::ELSE) {
-			nd_else_body = parse_stmt(++cur, end);
+		idx_t nd_if_body = parse_stmt(cur);
+		idx_t nd_else_body;
+		if (!at_end(cur) && kind(cur) == node_t::ELSE) {
+			nd_else_body = parse_stmt(++cur);
 		} else {
-			nd_else_body = new empty_ast();
+			nd_else_body = tree_.make_empty();
 		}
-		nd_if->else_body_ = nd_else_body;
-		nd_else_body->parent_ = nd_if;
 
-		return nd_if;
+		return tree_.make_if(nd_cond, nd_if_body, nd_else_body);
 	}
 
-	parser::while_ast * parser::handle_do_while(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		while_ast *nd_while = new while_ast(
-			node_t::DO, nullptr, parse_stmt(++cur, end)
-		);
-		nd_while->body_->parent_ = nd_while;
-		if (cur == end || **cur != node_t::WHILE) {
+	parser::idx_t parser::handle_do_while(tk_t& cur) {
+		idx_t nd_body = parse_stmt(++cur);
+		if (at_end(cur) || kind(cur) != node_t::WHILE) {
 			++err_ctr;
 			errors += "Expected while\n";
 		} else {
 			++cur;
 		}
-		if (cur == end || **cur != node_t::OPEN_PARENTHESIS) {
+		if (at_end(cur) || kind(cur) != node_t::OPEN_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected (\n";
 		} else {
 			++cur;
 		}
-		auto bool_end = find_bool_end(cur, end);
-		node_ast *nd_cond = parse_bool(cur, bool_end);
-		nd_while->cond_ = nd_cond;
-		nd_cond->parent_ = nd_while;
-		cur = bool_end;
-		if (cur == end || **cur != node_t::CLOSE_PARENTHESIS) {
+		idx_t nd_cond = parse_bool(cur);
+		if (at_end(cur) || kind(cur) != node_t::CLOSE_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected )\n";
 		} else {
 			++cur;
 		}
-		if (cur == end || **cur != node_t::SEMICOLON) {
+		if (at_end(cur) || kind(cur) != node_t::SEMICOLON) {
 			++err_ctr;
 			errors += "Expected ;\n";
 		} else {
 			++cur;
 		}
 
-		return nd_while;
+		return tree_.make_while(node_t::DO, nd_cond, nd_body);
 	}
 
-	parser::while_ast * parser::handle_while(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		while_ast *nd_while;
-		if (++cur == end || **cur != node_t::OPEN_PARENTHESIS) {
+	parser::idx_t parser::handle_while(tk_t& cur) {
+		if (at_end(++cur) || kind(cur) != node_t::OPEN_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected (\n";
 		} else {
 			++cur;
 		}
-		auto bool_end = find_bool_end(cur, end);
-		nd_while = new while_ast(node_t::WHILE, parse_bool(cur, bool_end));
-		nd_while->cond_->parent_ = nd_while;
-		cur = bool_end;
-		if (cur == end || **cur != node_t::CLOSE_PARENTHESIS) {
+		idx_t nd_cond = parse_bool(cur);
+		if (at_end(cur) || kind(cur) != node_t::CLOSE_PARENTHESIS) {
 			++err_ctr;
 			errors += "Expected )\n";
 		} else {
 			++cur;
 		}
-		node_ast *nd_body = parse_stmt(cur, end);
-		nd_while->body_ = nd_body;
-		nd_body->parent_ = nd_while;
+		idx_t nd_body = parse_stmt(cur);
 
-		return nd_while;
+		return tree_.make_while(node_t::WHILE, nd_cond, nd_body);
 	}
 
-	parser::node_ast * parser::parse_stmt(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	parser::idx_t parser::parse_stmt(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-		node_ast *nd;
-		if (cur == end) {
+		idx_t nd;
+		if (at_end(cur)) {
 			++err_ctr;
 			errors += "Expected primary-expression\n";
-			nd = new empty_ast();
-		} else if (**cur == node_t::IF) {
-			nd = handle_if_else(cur, end);
-		} else if (**cur == node_t::ELSE) {
+			nd = tree_.make_empty();
+		} else if (kind(cur) == node_t::IF) {
+			nd = handle_if_else(cur);
+		} else if (kind(cur) == node_t::ELSE) {
 			++err_ctr;
 			errors += "else without previous if\n";
-			nd = new empty_ast();
-		} else if (**cur == node_t::DO) {
-			nd = handle_do_while(cur, end);
-		} else if (**cur == node_t::WHILE) {
-			nd = handle_while(cur, end);
-		} else if (**cur == node_t::OPEN_BRACE) {
-			nd = parse_block(cur, end);
-		} else if (**cur == node_t::SEMICOLON) {
-			nd = new empty_ast();
+			nd = tree_.make_empty();
+		} else if (kind(cur) == node_t::DO) {
+			nd = handle_do_while(cur);
+		} else if (kind(cur) == node_t::WHILE) {
+			nd = handle_while(cur);
+		} else if (kind(cur) == node_t::OPEN_BRACE) {
+			nd = parse_block(cur);
+		} else if (kind(cur) == node_t::SEMICOLON) {
+			nd = tree_.make_empty();
 			++cur;
 		} else {
-			nd = parse_prnt(cur, end);
-			if (cur == end || **cur != node_t::SEMICOLON) {
+			nd = parse_prnt(cur);
+			if (at_end(cur) || kind(cur) != node_t::SEMICOLON) {
 				++err_ctr;
 				errors += "Expected ;\n";
 			} else {
@@ -401,554 +305,410 @@ namespace cplr {
 		return nd;
 	}
 
-	parser::node_ast * parser::parse_prnt(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	parser::idx_t parser::parse_prnt(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-		node_ast *nd;
-		if (cur == end) {
+		idx_t nd;
+		if (at_end(cur)) {
 			++err_ctr;
 			errors += \
 				"Expected print, assignment, expression, identifier or int constant\n";
-			nd = new empty_ast();
-		} else if (**cur == node_t::PRINT) {
-			auto nd_prnt = new print_ast(parse_right(++cur, end));
-			nd_prnt->val_->parent_ = nd_prnt;
-			nd = nd_prnt;
+			nd = tree_.make_empty();
+		} else if (kind(cur) == node_t::PRINT) {
+			nd = tree_.make_print(parse_right(++cur));
 		} else {
-			nd = parse_right(cur, end);
+			nd = parse_right(cur);
 		}
 
 		return nd;
 	}
 
-	parser::node_ast * parser::parse_right(
-		RandomAccessIt& cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	parser::idx_t parser::parse_right(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-		node_ast *nd;
-		RandomAccessIt bool_end;
-		if (cur == end) {
+		idx_t nd;
+		if (at_end(cur)) {
 			++err_ctr;
 			errors += \
 				"Expected assignment, expression, identifier or int constant\n";
-			nd = new empty_ast();
+			nd = tree_.make_empty();
 		} else if (
-			end - cur >= 2 && **next(cur) == node_t::BINARY_OPERATION && \
-			(*std::static_pointer_cast<cplr::binOp>(*next(cur))).get_op() \
-			== binOp_t::ASSIGNMENT
+			!at_end(cur + 1) && kind(cur) == node_t::IDENTIFIER && \
+			kind(cur + 1) == node_t::BINARY_OPERATION && \
+			toks_->binop(cur + 1) == binOp_t::ASSIGNMENT
 		) {
-			bool_end = find_bool_end(cur + 2, end);
-			auto nd_binop = new binOp_ast(
-				binOp_t::ASSIGNMENT, \
-				parse_id(cur, cur + 1), parse_bool(cur + 2, bool_end)
-			);
-			nd_binop->lhs_->parent_ = nd_binop;
-			nd_binop->rhs_->parent_ = nd_binop;
-			nd = nd_binop;
+			idx_t lhs = tree_.make_id(toks_->id(cur));
+			cur += 2;
+			idx_t rhs = parse_bool(cur);
+			nd = tree_.make_binop(binOp_t::ASSIGNMENT, lhs, rhs);
 		} else {
-			bool_end = find_bool_end(cur, end);
-			nd = parse_bool(cur, bool_end);
+			nd = parse_bool(cur);
 		}
-		cur = bool_end;
 
 		return nd;
 	}
 
-	bool parser::if_or(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::OR);
-	}
-
-	parser::node_ast * parser::parse_bool(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	// binding power of a binary operator, 0 for anything that ends expression
+	int parser::precedence(tk_t it) const {
+		if (kind(it) != node_t::BINARY_OPERATION) return 0;
 
-		return parse_op(
-			cur, end, [this](RandomAccessIt it) { return if_or(it); }, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_bool(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_join(l_cur, l_end);
-			}
-		);
-	}
-
-	bool parser::if_and(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::AND);
+		switch (toks_->binop(it)) {
+			case binOp_t::OR:
+				return 1;
+			case binOp_t::AND:
+				return 2;
+			case binOp_t::EQUAL: case binOp_t::NOT_EQUAL:
+				return 3;
+			case binOp_t::LESS: case binOp_t::LESS_OR_EQUAL:
+			case binOp_t::GREATER_OR_EQUAL: case binOp_t::GREATER:
+				return REL_PREC;
+			case binOp_t::ADDITION: case binOp_t::SUBSTRACTION:
+				return 5;
+			case binOp_t::MULTIPLICATION: case binOp_t::DIVISION:
+				return 6;
+			default: // binOp_t::ASSIGNMENT
+				return 0;
+		}
 	}
 
-	parser::node_ast * parser::parse_join(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		return parse_op(
-			cur, end, [this](RandomAccessIt it) { return if_and(it); }, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_join(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_equality(l_cur, l_end);
-			}
-		);
+	bool parser::if_operand(tk_t it) {
+		return !at_end(it) && if_bool(it) && kind(it) != node_t::CLOSE_PARENTHESIS;
 	}
 
-	bool parser::if_equal_not_equal(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::EQUAL \
-			|| (*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::NOT_EQUAL);
-	}
+	// whole bool: anything that may continue an expression is a stray token,
+	// after an error cur is moved to the end of the bool like the old
+	// range-based parser did
+	parser::idx_t parser::parse_bool(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-	parser::node_ast * parser::parse_equality(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+		idx_t nd = parse_binary(cur, 1);
+		if (err_ctr == 0 && if_operand(cur)) {
+			++err_ctr;
+			errors += "Stray token\n";
+		}
+		if (err_ctr > 0) {
+			cur = find_bool_end(cur);
+		}
 
-		return parse_op(
-			cur, end, [this](RandomAccessIt it) { return if_equal_not_equal(it); }, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_equality(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_rel(l_cur, l_end);
-			}
-		);
+		return nd;
 	}
 
-	bool parser::if_less_greater(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::LESS \
-			|| (*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::LESS_OR_EQUAL \
-			|| (*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::GREATER_OR_EQUAL \
-			|| (*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::GREATER);
-	}
-
-	parser::node_ast * parser::parse_rel(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		return parse_op(
-			cur, end, [this](RandomAccessIt it) { return if_less_greater(it); }, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_expr(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_expr(l_cur, l_end);
-			}
-		);
-	}
+	// precedence climbing: operators not weaker than min_prec are taken in a
+	// loop, so they are left-associative, and the right operand is parsed with
+	// min_prec raised above the operator; every token is looked at once
+	parser::idx_t parser::parse_binary(tk_t& cur, int min_prec) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-	bool parser::if_addition_substraction(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::ADDITION \
-			|| (*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::SUBSTRACTION);
-	}
-
-	parser::node_ast * parser::parse_expr(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		return parse_op(
-			cur, end, [this](RandomAccessIt it) {
-									return if_addition_substraction(it) \
-									&& **prev(it) != node_t::UNARY_OPERATION \
-									&& **prev(it) != node_t::BINARY_OPERATION;
-								}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_expr(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_term(l_cur, l_end);
-			}
-		);
-	}
+		if (!if_operand(cur)) {
+			++err_ctr;
+			errors += \
+				"Expected expression, identifier or int constant\n";
+			return tree_.make_empty();
+		}
+		idx_t lhs = parse_unary(cur);
+		bool rel_seen = false; // relations don't chain: a < b < c is an error
+		int prec;
+		while (
+			err_ctr == 0 && !at_end(cur) && (prec = precedence(cur)) >= min_prec && \
+			!(prec == REL_PREC && rel_seen)
+		) {
+			binOp_t op = toks_->binop(cur);
+			idx_t rhs = parse_binary(++cur, prec + 1);
+			lhs = tree_.make_binop(op, lhs, rhs);
+			rel_seen = rel_seen || prec == REL_PREC;
+		}
 
-	bool parser::if_multiplication_division(RandomAccessIt it) {
-		return **it == node_t::BINARY_OPERATION \
-			&& ((*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::MULTIPLICATION || \
-			(*std::static_pointer_cast<cplr::binOp>(*it)).get_op() \
-			== binOp_t::DIVISION);
-	}
-
-	parser::node_ast * parser::parse_term(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		return parse_op(
-			cur, end, [this](RandomAccessIt l_it) {
-									return if_multiplication_division(l_it);
-								}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_term(l_cur, l_end);
-			}, \
-			[this](RandomAccessIt l_cur, RandomAccessIt l_end) {
-				return parse_unary(l_cur, l_end);
-			}
-		);
+		return lhs;
 	}
 
-	parser::node_ast * parser::parse_unary(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	parser::idx_t parser::parse_unary(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-		node_ast *nd;
-		if (cur == end) {
+		idx_t nd;
+		if (!if_operand(cur)) {
 			++err_ctr;
 			errors += \
 				"Expected expression in parentheses, identifier or int constant\n";
-			nd = new empty_ast();
-		} else if (**cur == node_t::UNARY_OPERATION) {
-			unOp_t op = (*std::static_pointer_cast<cplr::unOp>(*cur)).get_op();
+			nd = tree_.make_empty();
+		} else if (kind(cur) == node_t::UNARY_OPERATION) {
+			unOp_t op = toks_->unop(cur);
 			if (op == unOp_t::LOGICAL_NEGATION) {
-				nd = new unOp_ast(
-					unOp_t::LOGICAL_NEGATION, parse_unary(next(cur), end)
+				nd = tree_.make_unop(
+					unOp_t::LOGICAL_NEGATION, parse_unary(++cur)
 				);
 			} else {
 				++err_ctr;
 				errors += "Unknown token\n";
-				nd = new empty_ast();
+				nd = tree_.make_empty();
 			}
-		} else if (**cur == node_t::BINARY_OPERATION) {
-			binOp_t op = (*std::static_pointer_cast<cplr::binOp>(*cur)).get_op();
+		} else if (kind(cur) == node_t::BINARY_OPERATION) {
+			binOp_t op = toks_->binop(cur);
 			if (op == binOp_t::SUBSTRACTION) {
-				nd = new unOp_ast(unOp_t::NEGATION, parse_unary(next(cur), end));
+				++cur;
+				if (
+					!at_end(cur) && kind(cur) == node_t::INTEGER_LITERAL && \
+					toks_->too_large(cur) && toks_->int_lit(cur) == INT_MIN
+				) { // -2147483648, INT_MIN negated is itself
+					nd = tree_.make_unop(unOp_t::NEGATION, tree_.make_int(INT_MIN));
+					++cur;
+				} else {
+					nd = tree_.make_unop(unOp_t::NEGATION, parse_unary(cur));
+				}
 			} else {
 				++err_ctr;
 				errors += "Unknown token\n";
-				nd = new empty_ast();
+				nd = tree_.make_empty();
 			}
 		} else {
-			nd = parse_factor(cur, end);
+			nd = parse_factor(cur);
 		}
 
 		return nd;
 	}
 
-	parser::node_ast * parser::parse_factor(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
+	parser::idx_t parser::parse_factor(tk_t& cur) {
+		if (err_ctr > 0) return tree_.make_empty();
 
-		node_ast *nd;
-		if (cur == end) {
-			++err_ctr;
-			errors += \
-				"Expected expression in parentheses, identifier or int constant\n";
-			nd = new empty_ast();
-		} else if (**cur == node_t::OPEN_PARENTHESIS) {
-			if (**prev(end) != node_t::CLOSE_PARENTHESIS) {
-				nd = parse_bool(next(cur), end);
+		idx_t nd;
+		node_t type = kind(cur);
+		if (type == node_t::OPEN_PARENTHESIS) {
+			nd = parse_bool(++cur);
+			if (at_end(cur) || kind(cur) != node_t::CLOSE_PARENTHESIS) {
 				++err_ctr;
 				errors += "Expected )\n";
 			} else {
-				nd = parse_bool(next(cur), prev(end));
+				++cur;
 			}
-		} else if (**cur == node_t::IDENTIFIER) {
-			nd = parse_id(cur, end);
-		} else if (**cur == node_t::INTEGER_LITERAL) {
-			nd = parse_int(cur, end);
-		} else if (**cur == node_t::SCAN) {
-			nd = parse_scan(cur, end);
-		} else if (**cur == node_t::BOOL_TRUE) {
-			nd = parse_true_false(cur, end);
-		} else if (**cur == node_t::BOOL_FALSE) {
-			nd = parse_true_false(cur, end);
+		} else if (type == node_t::IDENTIFIER) {
+			nd = tree_.make_id(toks_->id(cur++));
+		} else if (type == node_t::INTEGER_LITERAL && toks_->too_large(cur)) {
+			++err_ctr;
+			errors += "Integer constant too large\n";
+			nd = tree_.make_empty();
+		} else if (type == node_t::INTEGER_LITERAL) {
+			nd = tree_.make_int(toks_->int_lit(cur++));
+		} else if (
+			type == node_t::SCAN || type == node_t::BOOL_TRUE || \
+			type == node_t::BOOL_FALSE
+		) {
+			nd = tree_.make_leaf(type);
+			++cur;
 		} else {
 			++err_ctr;
 			errors += "Unknown token\n";
-			nd = new empty_ast();
-		}
-
-		return nd;
-	}
-
-	parser::node_ast * parser::parse_id(RandomAccessIt cur, RandomAccessIt end) {
-		if (err_ctr > 0) return new empty_ast();
-
-		id_ast *nd_id = new id_ast(*std::static_pointer_cast<cplr::id>(*cur));
-		if (next(cur) != end) {
-			++err_ctr;
-			errors += "Stray token\n";
-		}
-
-		return nd_id;
-	}
-
-	parser::node_ast * parser::parse_int(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		intLit_ast *nd_int = new intLit_ast(
-			*std::static_pointer_cast<cplr::intLit>(*cur)
-		);
-		if (next(cur) != end) {
-			++err_ctr;
-			errors += "Stray token\n";
-		}
-
-		return nd_int;
-	}
-
-	parser::node_ast * parser::parse_scan(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		node_ast *nd = new node_ast(node_t::SCAN);
-		if (next(cur) != end) {
-			++err_ctr;
-			errors += "Stray token\n";
+			nd = tree_.make_empty();
 		}
 
 		return nd;
 	}
 
-	parser::node_ast * parser::parse_true_false(
-		RandomAccessIt cur, RandomAccessIt end
-	) {
-		if (err_ctr > 0) return new empty_ast();
-
-		node_ast *nd = new node_ast(**cur);
-		if (next(cur) != end) {
-			++err_ctr;
-			errors += "Stray token\n";
-		}
-
-		return nd;
-	}
+	//--------tree-walking interpreter--------
 
-	int parser::run() {
+	int parser::run(input& in, output& out, loop_tier *tier) {
 		if (err_ctr > 0) {
 			return -1;
 		}
-		IDs_.clear();
-		run_aux(root_, 0);
+		in_ = &in;
+		out_ = &out;
+		frame_.assign(tree_.frame_size(), 0);
+		live_.assign(tree_.frame_size(), 0);
+		tier_ = tier;
+		hits_.assign(tier != nullptr ? tree_.size() : 0, 0);
+		run_aux(tree_.root());
+		tier_ = nullptr;
 
 		if (err_ctr > 0) {
+			out.flush();
 			std::cerr << errors;
 			return -2;
 		}
 		return 0;
 	}
 
-	void parser::run_aux(node_ast *nd, size_t scp_nesting_lvl) {
+	void parser::run_aux(idx_t nd) {
 		if (err_ctr > 0) return;
 
-		if (*nd == node_t::SCOPE) {
-			IDs_.resize(scp_nesting_lvl + 1);
-			auto nd_scope = reinterpret_cast<scope_ast *>(nd);
-			for (
-				auto it = nd_scope->nodes_.begin(), ite = nd_scope->nodes_.end(); \
-				it != ite; ++it
-			) {
-				run_aux(*it, scp_nesting_lvl + 1);
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[nd].first_);
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				run_aux(it[i]);
 			}
-			IDs_.resize(scp_nesting_lvl);
-		} else if (*nd == node_t::IF) {
-			run_if(reinterpret_cast<if_ast *>(nd), scp_nesting_lvl);
-		} else if (*nd == node_t::DO) {
-			run_do(reinterpret_cast<while_ast *>(nd), scp_nesting_lvl);
-		} else if (*nd == node_t::WHILE) {
-			run_while(reinterpret_cast<while_ast *>(nd), scp_nesting_lvl);
-		} else if (*nd != node_t::EMPTY) {
-			run_prnt(nd, scp_nesting_lvl);
+		} else if (type == node_t::IF) {
+			run_if(nd);
+		} else if (type == node_t::DO) {
+			run_do(nd);
+		} else if (type == node_t::WHILE) {
+			run_while(nd);
+		} else if (type != node_t::EMPTY) {
+			run_prnt(nd);
 		}
 	}
 
-	void parser::run_if(if_ast *nd, size_t scp_nesting_lvl) {
+	void parser::run_if(idx_t nd) {
 		if (err_ctr > 0) return;
 
-		IDs_.resize(scp_nesting_lvl + 1);
-		bool cond = static_cast<bool>(run_expr(nd->cond_, scp_nesting_lvl + 1));
-		IDs_[scp_nesting_lvl].clear();
-		if (cond) {
-			run_aux(nd->if_body_, scp_nesting_lvl + 1);
+		if (run_expr(tree_[nd].cond_)) {
+			run_aux(tree_[nd].body_);
 		} else {
-			run_aux(nd->else_body_, scp_nesting_lvl + 1);
+			run_aux(tree_[nd].else_);
 		}
-		IDs_.resize(scp_nesting_lvl);
 	}
 
-	void parser::run_do(while_ast *nd, size_t scp_nesting_lvl) {
+	void parser::run_do(idx_t nd) {
 		if (err_ctr > 0) return;
 
-		while (1) {
-			IDs_.resize(scp_nesting_lvl + 1);
-			run_aux(nd->body_, scp_nesting_lvl + 1);
-			IDs_[scp_nesting_lvl].clear();
-			if (!static_cast<bool>(run_expr(nd->cond_, scp_nesting_lvl + 1))) {
-				break;
+		do {
+			if (tier_up(nd)) {
+				return;
 			}
-		}
-		IDs_.resize(scp_nesting_lvl);
+			run_aux(tree_[nd].body_);
+		} while (run_expr(tree_[nd].cond_));
 	}
 
-	void parser::run_while(while_ast *nd, size_t scp_nesting_lvl) {
+	void parser::run_while(idx_t nd) {
 		if (err_ctr > 0) return;
 
-		while (1) {
-			IDs_.resize(scp_nesting_lvl + 1);
-			bool cond = static_cast<bool>(run_expr(nd->cond_, scp_nesting_lvl + 1));
-			IDs_[scp_nesting_lvl].clear();
+		kill_tracked(nd);
+		while (!tier_up(nd)) {
+			bool cond = static_cast<bool>(run_expr(tree_[nd].cond_));
+			kill_tracked(nd);
 			if (cond) {
-				run_aux(nd->body_, scp_nesting_lvl + 1);
+				run_aux(tree_[nd].body_);
 			} else {
 				break;
 			}
 		}
-		IDs_.resize(scp_nesting_lvl);
 	}
 
-	void parser::run_prnt(node_ast *nd, size_t scp_nesting_lvl) {
+	void parser::kill_tracked(idx_t nd) {
+		const idx_t *it = tree_.list(tree_[nd].tracked_);
+		for (int i = 0, ie = tree_[nd].val_; i < ie; ++i) {
+			live_[it[i]] = 0;
+		}
+	}
+
+	// counts iterations of the loop nd at their start; true if the loop has
+	// been run to the end by the tier, or stopped by an error there
+	bool parser::tier_up(idx_t nd) {
+		if (tier_ == nullptr) {
+			return false;
+		} else if (hits_[nd] < tier_->hot_after()) {
+			++hits_[nd];
+			return false;
+		}
+		int status = tier_->run_loop(nd, frame_, live_);
+		if (status == -2) {
+			++err_ctr; // already reported
+		}
+		return status != 1;
+	}
+
+	void parser::run_prnt(idx_t nd) {
 		if (err_ctr > 0) return;
 
-		if (*nd == node_t::PRINT) {
-			int value = run_right(
-				reinterpret_cast<print_ast *>(nd)->val_, scp_nesting_lvl
-			);
-			std::cout << value << '\n';
+		if (tree_[nd].type_ == node_t::PRINT) {
+			int value = run_right(tree_[nd].rhs_);
+			if (err_ctr > 0) return; // the statement is aborted
+			out_->write_int(value);
 		} else {
-			run_right(nd, scp_nesting_lvl);
+			run_right(nd);
 		}
 	}
 
-	int parser::run_right(node_ast *nd, size_t scp_nesting_lvl) {
+	int parser::run_right(idx_t nd) {
 		if (err_ctr > 0) return 0;
 
-		if (*nd == node_t::IDENTIFIER) {
-			return run_id_lval(reinterpret_cast<id_ast *>(nd), scp_nesting_lvl);
-		} else if (*nd == node_t::BINARY_OPERATION) {
-			binOp_ast *nd_binop = reinterpret_cast<binOp_ast *>(nd);
-			if (nd_binop->op_ == binOp_t::ASSIGNMENT) {
-				int& id = run_id_lval(
-					reinterpret_cast<id_ast *>(nd_binop->lhs_), scp_nesting_lvl
-				);
-				id = run_expr(nd_binop->rhs_, scp_nesting_lvl);
-				return id;
-			}
+		if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			return run_id_lval(nd);
+		} else if (tree_.is_assignment(nd)) {
+			int& id = run_id_lval(tree_[nd].lhs_);
+			id = run_expr(tree_[nd].rhs_);
+			return id;
 		}
-		return run_expr(nd, scp_nesting_lvl);
+		return run_expr(nd);
 	}
 
-	int parser::run_expr(node_ast *nd, size_t scp_nesting_lvl) {
+	int parser::run_expr(idx_t nd) {
 		if (err_ctr > 0) return 0;
 
-		if (*nd == node_t::UNARY_OPERATION) {
-			return run_unary(reinterpret_cast<unOp_ast *>(nd), scp_nesting_lvl);
-		} else if (*nd == node_t::BINARY_OPERATION) {
-			return run_binary(reinterpret_cast<binOp_ast *>(nd), scp_nesting_lvl);
+		if (tree_[nd].type_ == node_t::UNARY_OPERATION) {
+			return run_unary(nd);
+		} else if (tree_[nd].type_ == node_t::BINARY_OPERATION) {
+			return run_binary(nd);
 		} else {
-			return run_int(nd, scp_nesting_lvl);
+			return run_int(nd);
 		}
 	}
 
-	int parser::run_unary(unOp_ast *nd, size_t scp_nesting_lvl) {
+	int parser::run_unary(idx_t nd) {
 		if (err_ctr > 0) return 0;
 
-		if (nd->op_ == unOp_t::LOGICAL_NEGATION) {
-			return ! run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == unOp_t::NEGATION) {
-			return - run_expr(nd->rhs_, scp_nesting_lvl);
-		}
+		return arith_unary(tree_.unop(nd), run_expr(tree_[nd].rhs_));
 	}
 
-	int parser::run_binary(binOp_ast *nd, size_t scp_nesting_lvl) {
+	int parser::run_binary(idx_t nd) {
 		if (err_ctr > 0) return 0;
 
-		if (nd->op_ == binOp_t::OR) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			|| run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::AND) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			&& run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::EQUAL) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			== run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::NOT_EQUAL) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			!= run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::LESS) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			< run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::LESS_OR_EQUAL) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			<= run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::GREATER_OR_EQUAL) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			>= run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::GREATER) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			> run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::ADDITION) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			+ run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::SUBSTRACTION) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			- run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::MULTIPLICATION) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			* run_expr(nd->rhs_, scp_nesting_lvl);
-		} else if (nd->op_ == binOp_t::DIVISION) {
-			return run_expr(nd->lhs_, scp_nesting_lvl) \
-			/ run_expr(nd->rhs_, scp_nesting_lvl);
-		}
-	}
-
-	int& parser::run_id_lval(id_ast *nd, size_t scp_nesting_lvl) {
-		std::map<size_t, int>::iterator id;
-		for (auto it = IDs_.begin(), ite = IDs_.end(); it != ite; ++it) {
-			id = (*it).find(nd->id_);
-			if (id != (*it).end()) {
-				return id->second;
+		binOp_t op = tree_.binop(nd);
+		if (op == binOp_t::OR) {
+			return run_expr(tree_[nd].lhs_) || run_expr(tree_[nd].rhs_);
+		} else if (op == binOp_t::AND) {
+			return run_expr(tree_[nd].lhs_) && run_expr(tree_[nd].rhs_);
+		} else if (op == binOp_t::ASSIGNMENT) { // to a temporary, see optimizer
+			return run_right(nd);
+		}
+		// operands are evaluated left to right, it matters for ?
+		int lhs = run_expr(tree_[nd].lhs_);
+		int rhs = run_expr(tree_[nd].rhs_);
+		if (err_ctr > 0) return 0;
+		if (op == binOp_t::DIVISION || op == binOp_t::REMAINDER) {
+			if (tree_[nd].divisor_ != 0) { // a constant, see optimizer
+				const divisor& dv = tree_.divisor_of(nd);
+				return op == binOp_t::DIVISION ? div_by(dv, lhs) : rem_by(dv, lhs);
+			} else if (rhs == 0) {
+				++err_ctr;
+				errors += "Division by zero\n";
+				return 0;
 			}
 		}
-		return IDs_[scp_nesting_lvl - 1][nd->id_];
+		return arith_binary(op, lhs, rhs);
 	}
 
-	int parser::run_int(node_ast *nd, size_t scp_nesting_lvl) {
-		if (*nd == node_t::IDENTIFIER) {
-			auto id = reinterpret_cast<id_ast *>(nd)->id_;
-			std::map<size_t, int>::iterator id_val;
-			for (auto it = IDs_.begin(), ite = IDs_.end(); it != ite; ++it) {
-				id_val = (*it).find(id);
-				if (id_val != (*it).end()) {
-					return id_val->second;
-				}
+	int& parser::run_id_lval(idx_t nd) {
+		int id = tree_[nd].val_;
+		ast::bind_t bind = tree_.bind(nd);
+		if (
+			bind == ast::bind_t::UNDEFINED || \
+			(bind == ast::bind_t::UNKNOWN && !live_[id])
+		) {
+			frame_[id] = 0;
+			live_[id] = 1;
+		}
+		return frame_[id];
+	}
+
+	int parser::run_int(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::IDENTIFIER) {
+			int id = tree_[nd].val_;
+			ast::bind_t bind = tree_.bind(nd);
+			if (
+				bind == ast::bind_t::DEFINED || \
+				(bind == ast::bind_t::UNKNOWN && live_[id])
+			) {
+				return frame_[id];
 			}
 			++err_ctr;
 			errors += "Undefined identifier\n";
 			return 0;
-		} else if (*nd == node_t::INTEGER_LITERAL) {
-			return reinterpret_cast<intLit_ast *>(nd)->int_lit_;
-		} else if (*nd == node_t::SCAN) {
-			int ret = 0;
-			std::cin >> ret;
-			return ret;
-		} else if (*nd == node_t::BOOL_TRUE) {
+		} else if (type == node_t::INTEGER_LITERAL) {
+			return tree_[nd].val_;
+		} else if (type == node_t::SCAN) {
+			return in_->read_int();
+		} else if (type == node_t::BOOL_TRUE) {
 			return 1;
-		} else { // *nd == node_t::BOOL_FALSE
+		} else { // type == node_t::BOOL_FALSE
 			return 0;
 		}
 	}
@@ -0,0 +1,821 @@
+#include "passes.h"
+
+#include <chrono>
+#include <utility>
+
+#include "arith.h"
+#include "ranges.h"
+
+namespace cplr {
+
+	using value_t = ir::value_t;
+	using block_t = ir::block_t;
+	using op_t = ir::op_t;
+	using term_t = ir::term_t;
+
+	//--------pass_manager--------
+
+	void pass_manager::add(const char *name, pass_t pass) {
+		passes_.push_back({name, pass, 0, 0});
+	}
+
+	void pass_manager::run(ir& code) {
+		for (auto& it : passes_) {
+			auto since = std::chrono::steady_clock::now();
+			it.changes = it.pass(code);
+			it.ms = std::chrono::duration<double, std::milli>(
+				std::chrono::steady_clock::now() - since
+			).count();
+		}
+	}
+
+	void pass_manager::report(std::ostream& os) const {
+		os << "passes:";
+		for (size_t i = 0; i < passes_.size(); ++i) {
+			os << (i == 0 ? " " : ", ") << passes_[i].name << ' ' << passes_[i].ms \
+				<< " ms " << passes_[i].changes << " changes";
+		}
+		os << '\n';
+	}
+
+	// drops removed instructions from the lists of the blocks
+	static void compact(ir& code, std::vector<value_t>& list) {
+		size_t kept = 0;
+		for (auto v : list) {
+			if (code.instrs_[v].op_ != op_t::NOP) {
+				list[kept++] = v;
+			}
+		}
+		list.resize(kept);
+	}
+
+	static void remove(ir& code, value_t v) {
+		code.instrs_[v].op_ = op_t::NOP;
+		code.instrs_[v].args_.clear();
+	}
+
+	//--------sparse conditional constant propagation--------
+	//
+	//	As in Wegman and Zadeck, "Constant Propagation with Conditional
+	//	Branches": every value starts unknown and only goes down to a constant
+	//	and then to not a constant, while blocks are visited only once an edge
+	//	to them is found executable, so a phi meets only the values coming by
+	//	such edges. Constant values are then replaced by constants, branches on
+	//	them by jumps and blocks never reached are dropped.
+
+	namespace {
+
+		enum class lattice_t : unsigned char { TOP, CONST, BOTTOM };
+
+		class propagation final {
+		public:
+			explicit propagation(ir& code);
+			size_t run();
+
+		private:
+			void visit(block_t b);
+			void mark_edge(block_t from, block_t to);
+			void lower(value_t v, lattice_t state, int val);
+			void eval(value_t v);
+			void eval_term(block_t b);
+			size_t rewrite();
+			value_t find(value_t v) const;
+
+			ir& code_;
+			std::vector<lattice_t> states_; // by value
+			std::vector<int> vals_; // if CONST
+			std::vector<std::vector<value_t>> users_; // by value
+			std::vector<std::vector<block_t>> branches_; // by value, on it
+			std::vector<unsigned char> reached_; // by block
+			std::vector<std::vector<unsigned char>> edges_; // by block, by pred
+			std::vector<std::pair<block_t, block_t>> flow_;
+			std::vector<value_t> ssa_;
+			std::vector<value_t> subst_; // by value, what it is replaced by
+		};
+
+		propagation::propagation(ir& code)
+		: code_(code)
+		{}
+
+		size_t propagation::run() {
+			size_t n = code_.instrs_.size();
+			states_.assign(n, lattice_t::TOP);
+			vals_.assign(n, 0);
+			users_.assign(n, {});
+			branches_.assign(n, {});
+			for (value_t v = 0; v < n; ++v) {
+				const ir::instr& in = code_.instrs_[v];
+				if (in.op_ == op_t::CONST) {
+					states_[v] = lattice_t::CONST;
+					vals_[v] = in.val_;
+				}
+				for (auto arg : in.args_) {
+					users_[arg].push_back(v);
+				}
+			}
+			reached_.assign(code_.blocks_.size(), 0);
+			edges_.resize(code_.blocks_.size());
+			for (block_t b = 0; b < code_.blocks_.size(); ++b) {
+				const ir::block& blk = code_.blocks_[b];
+				edges_[b].assign(blk.preds_.size(), 0);
+				if (blk.term_ == term_t::BR) {
+					branches_[blk.cond_].push_back(b);
+				}
+			}
+
+			flow_.push_back({ir::none, 0});
+			while (!flow_.empty() || !ssa_.empty()) {
+				while (!flow_.empty()) {
+					auto edge = flow_.back();
+					flow_.pop_back();
+					mark_edge(edge.first, edge.second);
+				}
+				while (!ssa_.empty()) {
+					value_t v = ssa_.back();
+					ssa_.pop_back();
+					for (auto user : users_[v]) {
+						if (reached_[code_.instrs_[user].block_]) {
+							eval(user);
+						}
+					}
+					for (auto b : branches_[v]) {
+						if (reached_[b]) {
+							eval_term(b);
+						}
+					}
+				}
+			}
+			return rewrite();
+		}
+
+		void propagation::visit(block_t b) {
+			const ir::block& blk = code_.blocks_[b];
+			for (auto v : blk.phis_) {
+				eval(v);
+			}
+			for (auto v : blk.code_) {
+				eval(v);
+			}
+			eval_term(b);
+		}
+
+		void propagation::mark_edge(block_t from, block_t to) {
+			bool found = from == ir::none; // to the entry
+			const ir::block& blk = code_.blocks_[to];
+			for (size_t i = 0; i < blk.preds_.size(); ++i) {
+				if (blk.preds_[i] == from && !edges_[to][i]) {
+					edges_[to][i] = 1;
+					found = true;
+				}
+			}
+			if (!found) {
+				return;
+			} else if (!reached_[to]) {
+				reached_[to] = 1;
+				visit(to);
+			} else {
+				for (auto v : blk.phis_) {
+					eval(v);
+				}
+			}
+		}
+
+		void propagation::lower(value_t v, lattice_t state, int val) {
+			if (state == states_[v] && (state != lattice_t::CONST || val == vals_[v])) {
+				return;
+			} else if (state == lattice_t::CONST && states_[v] == lattice_t::CONST) {
+				state = lattice_t::BOTTOM; // two constants meet
+			}
+			if (state > states_[v]) {
+				states_[v] = state;
+				vals_[v] = val;
+				ssa_.push_back(v);
+			}
+		}
+
+		void propagation::eval(value_t v) {
+			const ir::instr& in = code_.instrs_[v];
+			if (in.op_ == op_t::PHI) {
+				const std::vector<unsigned char>& edges = edges_[in.block_];
+				for (size_t i = 0; i < in.args_.size(); ++i) {
+					value_t arg = in.args_[i];
+					if (edges[i] && states_[arg] != lattice_t::TOP) {
+						lower(v, states_[arg], vals_[arg]);
+					}
+				}
+				return;
+			} else if (in.op_ == op_t::SCAN) {
+				lower(v, lattice_t::BOTTOM, 0);
+				return;
+			} else if (in.op_ == op_t::PRINT || in.op_ == op_t::CONST) {
+				return;
+			}
+
+			lattice_t state = lattice_t::CONST;
+			for (auto arg : in.args_) {
+				if (states_[arg] == lattice_t::TOP) {
+					return; // not known yet
+				} else if (states_[arg] == lattice_t::BOTTOM) {
+					state = lattice_t::BOTTOM;
+				}
+			}
+			if (state == lattice_t::BOTTOM) {
+				lower(v, state, 0);
+				return;
+			}
+			int lhs = vals_[in.args_[0]];
+			if (in.op_ == op_t::NOT || in.op_ == op_t::NEG) {
+				bool is_not = in.op_ == op_t::NOT;
+				lower(v, state, arith_unary(
+					is_not ? unOp_t::LOGICAL_NEGATION : unOp_t::NEGATION, lhs
+				));
+				return;
+			}
+			int rhs = vals_[in.args_[1]];
+			bool division = in.op_ == op_t::DIV || in.op_ == op_t::REM || \
+				in.op_ == op_t::DIVN || in.op_ == op_t::REMN;
+			if (division && rhs == 0) {
+				lower(v, lattice_t::BOTTOM, 0); // stops the program when reached
+				return;
+			}
+			static const binOp_t ops[] = {
+				binOp_t::EQUAL, binOp_t::NOT_EQUAL, binOp_t::LESS,
+				binOp_t::LESS_OR_EQUAL, binOp_t::GREATER_OR_EQUAL, binOp_t::GREATER,
+				binOp_t::ADDITION, binOp_t::SUBSTRACTION, binOp_t::MULTIPLICATION,
+				binOp_t::DIVISION, binOp_t::REMAINDER, binOp_t::DIVISION,
+				binOp_t::REMAINDER, binOp_t::AND, binOp_t::OR
+			};
+			size_t at = static_cast<size_t>(in.op_) - static_cast<size_t>(op_t::EQ);
+			lower(v, state, arith_binary(ops[at], lhs, rhs));
+		}
+
+		void propagation::eval_term(block_t b) {
+			const ir::block& blk = code_.blocks_[b];
+			if (blk.term_ == term_t::JMP) {
+				flow_.push_back({b, blk.succ_[0]});
+			} else if (blk.term_ == term_t::BR) {
+				lattice_t state = states_[blk.cond_];
+				if (state == lattice_t::CONST) {
+					flow_.push_back({b, blk.succ_[vals_[blk.cond_] != 0 ? 0 : 1]});
+				} else if (state == lattice_t::BOTTOM) {
+					flow_.push_back({b, blk.succ_[0]});
+					flow_.push_back({b, blk.succ_[1]});
+				}
+			}
+		}
+
+		value_t propagation::find(value_t v) const {
+			while (v < subst_.size() && subst_[v] != ir::none) {
+				v = subst_[v];
+			}
+			return v;
+		}
+
+		size_t propagation::rewrite() {
+			size_t changes = 0;
+			subst_.assign(code_.instrs_.size(), ir::none);
+			for (block_t b = 0; b < code_.blocks_.size(); ++b) {
+				if (reached_[b]) {
+					continue;
+				}
+				ir::block& blk = code_.blocks_[b];
+				for (size_t i = 0; i < code_.successors(b); ++i) {
+					ir::block& succ = code_.blocks_[blk.succ_[i]];
+					for (size_t j = succ.preds_.size(); j-- > 0;) {
+						if (succ.preds_[j] == b) {
+							code_.remove_pred(blk.succ_[i], j);
+						}
+					}
+				}
+				for (int part = 0; part < 2; ++part) {
+					for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+						remove(code_, v);
+						++changes;
+					}
+				}
+				blk.phis_.clear();
+				blk.code_.clear();
+				blk.preds_.clear();
+				blk.term_ = term_t::HALT;
+				blk.cond_ = ir::none;
+			}
+
+			for (block_t b = 0; b < code_.blocks_.size(); ++b) {
+				if (!reached_[b]) {
+					continue;
+				}
+				for (int part = 0; part < 2; ++part) {
+					const ir::block& blk = code_.blocks_[b];
+					for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+						if (
+							states_[v] == lattice_t::CONST && \
+							code_.instrs_[v].op_ != op_t::CONST
+						) {
+							subst_[v] = code_.make_const(vals_[v]);
+							remove(code_, v);
+							++changes;
+						}
+					}
+				}
+				ir::block& blk = code_.blocks_[b];
+				compact(code_, blk.phis_);
+				compact(code_, blk.code_);
+				if (blk.term_ == term_t::BR && states_[blk.cond_] == lattice_t::CONST) {
+					code_.retarget(b, blk.succ_[vals_[blk.cond_] != 0 ? 0 : 1]);
+					++changes;
+				}
+			}
+
+			// phis left with one value by dropped edges are that value
+			bool changed = true;
+			while (changed) {
+				changed = false;
+				for (auto& blk : code_.blocks_) {
+					for (auto phi : blk.phis_) {
+						value_t same = ir::none;
+						bool trivial = true;
+						for (auto arg : code_.instrs_[phi].args_) {
+							arg = find(arg);
+							if (arg == phi || arg == same) {
+								continue;
+							} else if (same != ir::none) {
+								trivial = false;
+								break;
+							}
+							same = arg;
+						}
+						if (trivial && same != ir::none) {
+							subst_[phi] = same;
+							remove(code_, phi);
+							changed = true;
+							++changes;
+						}
+					}
+					compact(code_, blk.phis_);
+				}
+			}
+
+			for (auto& in : code_.instrs_) {
+				for (auto& arg : in.args_) {
+					arg = find(arg);
+				}
+			}
+			for (auto& blk : code_.blocks_) {
+				if (blk.term_ == term_t::BR) {
+					blk.cond_ = find(blk.cond_);
+				}
+			}
+			return changes;
+		}
+
+	}
+
+	size_t sccp(ir& code) {
+		return propagation(code).run();
+	}
+
+	//--------dead code elimination--------
+	//
+	//	Everything which can't be dropped is live: ?, print, division which may
+	//	stop the program and conditions of branches, and so is every argument
+	//	of a live instruction. The rest is dropped, cycles of phis included.
+
+	size_t dce(ir& code) {
+		std::vector<unsigned char> live(code.instrs_.size(), 0);
+		std::vector<value_t> work;
+		auto mark = [&](value_t v) {
+			if (!live[v]) {
+				live[v] = 1;
+				work.push_back(v);
+			}
+		};
+		for (auto b : code.order()) {
+			const ir::block& blk = code.blocks_[b];
+			for (auto v : blk.code_) {
+				if (!code.is_pure(v)) {
+					mark(v);
+				}
+			}
+			if (blk.term_ == term_t::BR) {
+				mark(blk.cond_);
+			}
+		}
+		while (!work.empty()) {
+			value_t v = work.back();
+			work.pop_back();
+			for (auto arg : code.instrs_[v].args_) {
+				mark(arg);
+			}
+		}
+
+		size_t changes = 0;
+		for (auto& blk : code.blocks_) {
+			for (int part = 0; part < 2; ++part) {
+				for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+					if (!live[v]) {
+						remove(code, v);
+						++changes;
+					}
+				}
+			}
+			compact(code, blk.phis_);
+			compact(code, blk.code_);
+		}
+		return changes;
+	}
+
+
+	//--------specialization--------
+	//
+	//	Goes by the ranges of values, see range_analysis: a value known to be
+	//	one number is that constant, a division by a divisor which is never 0,
+	//	nor -1 when the dividend may be INT_MIN, is done without the checks, a
+	//	comparison of a boolean with 0 or 1 is the boolean or its !, and a
+	//	branch on ! swaps its successors instead. && and || computing a value
+	//	branch to blocks choosing 1 or 0 by a phi; when the right operand is
+	//	short and can't fail, both are computed and and-ed or or-ed, so the phi
+	//	is a boolean operation and the blocks are gone.
+
+	namespace {
+
+		static const size_t max_speculated = 4; // instructions of && and ||
+
+		class specialization final {
+		public:
+			explicit specialization(ir& code);
+			size_t run();
+
+		private:
+			void specialize(value_t v, block_t b);
+			void specialize_branch(block_t b);
+			bool merge_logical(block_t b);
+			bool collapse_select(block_t b);
+			bool merge_jump(block_t b);
+			bool is_empty_jump(block_t b) const;
+			value_t to_boolean(value_t v, block_t b);
+			value_t negate(value_t v, block_t b);
+			void clear(block_t b);
+			void replace(value_t v, value_t by);
+			value_t find(value_t v) const;
+
+			ir& code_;
+			range_analysis ranges_;
+			std::vector<value_t> subst_; // by value, what it is replaced by
+			size_t changes_;
+		};
+
+		specialization::specialization(ir& code)
+		: code_(code)
+		, ranges_(code)
+		, changes_(0)
+		{}
+
+		size_t specialization::run() {
+			ranges_.run();
+			subst_.assign(code_.instrs_.size(), ir::none);
+			std::vector<block_t> order = code_.order();
+			for (auto b : order) {
+				for (size_t i = 0; i < code_.blocks_[b].phis_.size(); ++i) {
+					specialize(code_.blocks_[b].phis_[i], b);
+				}
+				for (size_t i = 0; i < code_.blocks_[b].code_.size(); ++i) {
+					specialize(code_.blocks_[b].code_[i], b);
+				}
+				specialize_branch(b);
+			}
+			for (auto& blk : code_.blocks_) {
+				compact(code_, blk.phis_);
+				compact(code_, blk.code_);
+			}
+
+			bool changed = true;
+			while (changed) {
+				changed = false;
+				for (auto b : code_.order()) {
+					if (merge_logical(b) || collapse_select(b) || merge_jump(b)) {
+						changed = true;
+					}
+				}
+			}
+
+			for (auto& in : code_.instrs_) {
+				for (auto& arg : in.args_) {
+					arg = find(arg);
+				}
+			}
+			for (auto& blk : code_.blocks_) {
+				if (blk.term_ == term_t::BR) {
+					blk.cond_ = find(blk.cond_);
+				}
+				compact(code_, blk.phis_);
+				compact(code_, blk.code_);
+			}
+			return changes_;
+		}
+
+		void specialization::specialize(value_t v, block_t b) {
+			for (auto& arg : code_.instrs_[v].args_) {
+				arg = find(arg);
+			}
+			range_analysis::range r = ranges_.of(v);
+			if (code_.is_pure(v) && !r.empty() && r.lo == r.hi) {
+				replace(v, code_.make_const(r.lo));
+				return;
+			}
+			ir::instr& in = code_.instrs_[v];
+			if (in.op_ == op_t::DIV || in.op_ == op_t::REM) {
+				if (ranges_.is_safe_divisor(in.args_[0], in.args_[1], b)) {
+					in.op_ = in.op_ == op_t::DIV ? op_t::DIVN : op_t::REMN;
+					++changes_;
+				}
+			} else if (in.op_ == op_t::EQ || in.op_ == op_t::NE) {
+				value_t x = in.args_[0], k = in.args_[1];
+				if (code_.is_const(x)) {
+					std::swap(x, k);
+				}
+				if (code_.is_const(x) || !code_.is_const(k)) {
+					return;
+				}
+				int val = code_.instrs_[k].val_;
+				if (val == 0 && in.op_ == op_t::EQ) {
+					in.op_ = op_t::NOT;
+					in.args_ = {x};
+					++changes_;
+				} else if ((val == 0 || val == 1) && ranges_.is_boolean(x)) {
+					if ((in.op_ == op_t::NE) == (val == 0)) {
+						replace(v, x);
+					} else {
+						in.op_ = op_t::NOT;
+						in.args_ = {x};
+						++changes_;
+					}
+				}
+			} else if (in.op_ == op_t::NOT) {
+				const ir::instr& arg = code_.instrs_[in.args_[0]];
+				if (arg.op_ == op_t::NOT && ranges_.is_boolean(arg.args_[0])) {
+					replace(v, arg.args_[0]);
+				}
+			}
+		}
+
+		void specialization::specialize_branch(block_t b) {
+			ir::block& blk = code_.blocks_[b];
+			if (blk.term_ != term_t::BR) {
+				return;
+			}
+			blk.cond_ = find(blk.cond_);
+			while (code_.instrs_[blk.cond_].op_ == op_t::NOT) {
+				blk.cond_ = find(code_.instrs_[blk.cond_].args_[0]);
+				std::swap(blk.succ_[0], blk.succ_[1]);
+				++changes_;
+			}
+			range_analysis::range r = ranges_.at(blk.cond_, b);
+			if (r.empty()) {
+				return;
+			} else if (r.is_nonzero()) {
+				code_.retarget(b, blk.succ_[0]);
+				++changes_;
+			} else if (r.lo == 0 && r.hi == 0) {
+				code_.retarget(b, blk.succ_[1]);
+				++changes_;
+			}
+		}
+
+		// b branching on a to m, which only branches on c, both to the same
+		// two blocks choosing a value for a phi, branches on a && c or a || c
+		// computed in b
+		bool specialization::merge_logical(block_t b) {
+			ir::block& blk = code_.blocks_[b];
+			if (blk.term_ != term_t::BR) {
+				return false;
+			}
+			for (int side = 0; side < 2; ++side) {
+				block_t m = blk.succ_[side], out = blk.succ_[1 - side];
+				const ir::block& mid = code_.blocks_[m];
+				if (
+					m == b || m == 0 || m == out || mid.preds_.size() != 1 || \
+					!mid.phis_.empty() || mid.term_ != term_t::BR || \
+					mid.code_.size() > max_speculated || mid.succ_[0] == mid.succ_[1] || \
+					(mid.succ_[0] != out && mid.succ_[1] != out)
+				) {
+					continue;
+				}
+				block_t to = mid.succ_[0] == out ? mid.succ_[1] : mid.succ_[0];
+				if (
+					!is_empty_jump(to) || !is_empty_jump(out) || \
+					code_.blocks_[to].succ_[0] != code_.blocks_[out].succ_[0]
+				) {
+					continue;
+				}
+				bool speculable = true;
+				for (auto v : mid.code_) {
+					op_t op = code_.instrs_[v].op_;
+					if (!code_.is_pure(v) || op == op_t::DIVN || op == op_t::REMN) {
+						speculable = false; // may fail or is safe only after a
+						break;
+					}
+				}
+				if (!speculable) {
+					continue;
+				}
+
+				// a and c, or their !, taking the branch to to
+				value_t a = find(blk.cond_), c = find(mid.cond_);
+				bool not_a = side == 1, not_c = mid.succ_[1] == to;
+				for (auto v : mid.code_) {
+					code_.instrs_[v].block_ = b;
+					blk.code_.push_back(v);
+				}
+				if (not_a && not_c) { // !a && !c is !(a || c)
+					blk.cond_ = code_.add(b, op_t::OR, {to_boolean(a, b), to_boolean(c, b)});
+					blk.succ_[0] = out;
+					blk.succ_[1] = to;
+				} else {
+					a = not_a ? negate(a, b) : to_boolean(a, b);
+					c = not_c ? negate(c, b) : to_boolean(c, b);
+					blk.cond_ = code_.add(b, op_t::AND, {a, c});
+					blk.succ_[0] = to;
+					blk.succ_[1] = out;
+				}
+				for (auto& pred : code_.blocks_[to].preds_) {
+					if (pred == m) {
+						pred = b;
+					}
+				}
+				std::vector<block_t>& preds = code_.blocks_[out].preds_;
+				for (size_t i = 0; i < preds.size(); ++i) {
+					if (preds[i] == m) {
+						preds.erase(preds.begin() + i);
+						break;
+					}
+				}
+				code_.blocks_[m].code_.clear();
+				clear(m);
+				++changes_;
+				return true;
+			}
+			return false;
+		}
+
+		// b branching to two empty blocks jumping to the same one computes the
+		// phis there: an argument the same on both sides is taken as it is,
+		// 1 and 0 are the condition and 0 and 1 its !
+		bool specialization::collapse_select(block_t b) {
+			ir::block& blk = code_.blocks_[b];
+			if (blk.term_ != term_t::BR) {
+				return false;
+			}
+			block_t then_b = blk.succ_[0], else_b = blk.succ_[1];
+			if (
+				then_b == else_b || !is_empty_jump(then_b) || !is_empty_jump(else_b) || \
+				code_.blocks_[then_b].preds_.size() != 1 || \
+				code_.blocks_[else_b].preds_.size() != 1 || \
+				code_.blocks_[then_b].succ_[0] != code_.blocks_[else_b].succ_[0]
+			) {
+				return false;
+			}
+			block_t join = code_.blocks_[then_b].succ_[0];
+			const ir::block& to = code_.blocks_[join];
+			size_t at_then = 0, at_else = 0;
+			for (size_t i = 0; i < to.preds_.size(); ++i) {
+				if (to.preds_[i] == then_b) {
+					at_then = i;
+				} else if (to.preds_[i] == else_b) {
+					at_else = i;
+				}
+			}
+			auto is = [&](value_t v, int val) {
+				v = find(v);
+				return code_.is_const(v) && code_.instrs_[v].val_ == val;
+			};
+			for (auto phi : to.phis_) {
+				const std::vector<value_t>& args = code_.instrs_[phi].args_;
+				if (
+					find(args[at_then]) != find(args[at_else]) && \
+					!(is(args[at_then], 1) && is(args[at_else], 0)) && \
+					!(is(args[at_then], 0) && is(args[at_else], 1))
+				) {
+					return false;
+				}
+			}
+
+			value_t cond = find(blk.cond_), yes = ir::none, no = ir::none;
+			std::vector<value_t> args;
+			for (auto phi : to.phis_) {
+				value_t on_then = find(code_.instrs_[phi].args_[at_then]);
+				if (on_then == find(code_.instrs_[phi].args_[at_else])) {
+					args.push_back(on_then);
+				} else if (is(on_then, 1)) {
+					yes = yes == ir::none ? to_boolean(cond, b) : yes;
+					args.push_back(yes);
+				} else {
+					no = no == ir::none ? negate(cond, b) : no;
+					args.push_back(no);
+				}
+			}
+			code_.remove_pred(join, std::max(at_then, at_else));
+			code_.remove_pred(join, std::min(at_then, at_else));
+			ir::block& dst = code_.blocks_[join];
+			dst.preds_.push_back(b);
+			for (size_t i = 0; i < dst.phis_.size(); ++i) {
+				code_.instrs_[dst.phis_[i]].args_.push_back(args[i]);
+			}
+			blk.term_ = term_t::JMP;
+			blk.cond_ = ir::none;
+			blk.succ_[0] = join;
+			blk.succ_[1] = ir::none;
+			clear(then_b);
+			clear(else_b);
+			++changes_;
+			return true;
+		}
+
+		// b jumping to a block entered only from b takes its code
+		bool specialization::merge_jump(block_t b) {
+			ir::block& blk = code_.blocks_[b];
+			block_t next = blk.succ_[0];
+			if (
+				blk.term_ != term_t::JMP || next == b || next == 0 || \
+				code_.blocks_[next].preds_.size() != 1
+			) {
+				return false;
+			}
+			ir::block& from = code_.blocks_[next];
+			for (auto phi : from.phis_) {
+				replace(phi, find(code_.instrs_[phi].args_[0]));
+			}
+			from.phis_.clear();
+			for (auto v : from.code_) {
+				code_.instrs_[v].block_ = b;
+				blk.code_.push_back(v);
+			}
+			from.code_.clear();
+			blk.term_ = from.term_;
+			blk.cond_ = from.cond_;
+			blk.succ_[0] = from.succ_[0];
+			blk.succ_[1] = from.succ_[1];
+			blk.id_ = from.id_;
+			for (size_t i = 0; i < code_.successors(b); ++i) {
+				for (auto& pred : code_.blocks_[blk.succ_[i]].preds_) {
+					if (pred == next) {
+						pred = b;
+					}
+				}
+			}
+			clear(next);
+			++changes_;
+			return true;
+		}
+
+		bool specialization::is_empty_jump(block_t b) const {
+			const ir::block& blk = code_.blocks_[b];
+			return blk.term_ == term_t::JMP && blk.phis_.empty() && blk.code_.empty();
+		}
+
+		value_t specialization::to_boolean(value_t v, block_t b) {
+			if (ranges_.is_boolean(v)) {
+				return v;
+			}
+			return code_.add(b, op_t::NE, {v, code_.make_const(0)});
+		}
+
+		value_t specialization::negate(value_t v, block_t b) {
+			const ir::instr& in = code_.instrs_[v];
+			if (in.op_ == op_t::NOT && ranges_.is_boolean(in.args_[0])) {
+				return find(in.args_[0]);
+			}
+			return code_.add(b, op_t::NOT, {v});
+		}
+
+		// a block left unreachable, its code has been moved away
+		void specialization::clear(block_t b) {
+			ir::block& blk = code_.blocks_[b];
+			blk.preds_.clear();
+			blk.term_ = term_t::HALT;
+			blk.cond_ = ir::none;
+			blk.succ_[0] = blk.succ_[1] = ir::none;
+		}
+
+		void specialization::replace(value_t v, value_t by) {
+			if (v >= subst_.size()) {
+				subst_.resize(v + 1, ir::none);
+			}
+			subst_[v] = by;
+			remove(code_, v);
+			++changes_;
+		}
+
+		value_t specialization::find(value_t v) const {
+			while (v < subst_.size() && subst_[v] != ir::none) {
+				v = subst_[v];
+			}
+			return v;
+		}
+
+	}
+
+	size_t specialize(ir& code) {
+		return specialization(code).run();
+	}
+
+}
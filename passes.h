@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+#include "ir.h"
+
+namespace cplr {
+
+	// runs passes over ir one after another, each one is a function taking the
+	// whole program, so new ones are added without touching the others
+	class pass_manager final {
+	public:
+		using pass_t = size_t (*)(ir& code); // returns how many changes it made
+
+		void add(const char *name, pass_t pass);
+		void run(ir& code);
+		void report(std::ostream& os) const; // time and changes by pass
+
+	private:
+		struct entry {
+			const char *name;
+			pass_t pass;
+			double ms; // of the last run
+			size_t changes;
+		};
+
+		std::vector<entry> passes_;
+	};
+
+	size_t sccp(ir& code); // sparse conditional constant propagation
+	size_t dce(ir& code); // dead code elimination
+	size_t specialize(ir& code); // by ranges of values, see range_analysis
+
+}
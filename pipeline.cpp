@@ -0,0 +1,137 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "optimizer.h"
+#include "parser.h"
+#include "vm.h"
+
+namespace cplr {
+
+	static const size_t token_block_size = 1 << 12; // tokens
+	static const size_t code_batch_size = 1 << 12; // instructions
+	static const size_t queue_capacity = 8;
+
+	//--------token_queue--------
+
+	token_queue::token_queue(bounded_queue<token_buffer>& in)
+	: in_(in)
+	{}
+
+	bool token_queue::pull() {
+		if (!in_.pop(block_)) {
+			return false;
+		}
+		if (window_.size() > keep_size) {
+			window_.drop_before(window_.end() - keep_size);
+		}
+		window_.append(block_);
+		return true;
+	}
+
+	const token_buffer& token_queue::window() const {
+		return window_;
+	}
+
+	//--------stages--------
+
+	static void lex_stage(
+		const source& prog, symbol_table& names, bounded_queue<token_buffer>& out
+	) {
+		const char *cur = prog.begin(), *end = prog.end();
+		token_buffer block;
+		token tk;
+		while (1) {
+			skip_spaces(cur, end);
+			if (cur == end) {
+				break;
+			}
+			size_t offset = cur - prog.begin();
+			read_token(cur, end, names, tk);
+			block.push(tk, offset);
+			if (block.size() == token_block_size) {
+				if (!out.push(std::move(block))) {
+					return;
+				}
+				block = token_buffer();
+			}
+		}
+		if (block.size() > 0) {
+			out.push(std::move(block));
+		}
+		out.close();
+	}
+
+	// batches start from one statement and grow twice up to code_batch_size,
+	// so the first statements don't wait for the next ones and the rest don't
+	// pay for the queue one by one
+	static void parse_stage(
+		bounded_queue<token_buffer>& in, bounded_queue<code_batch>& out, bool opt
+	) {
+		token_queue toks(in);
+		parser prsr;
+		compiler cmp(prsr);
+		code_batch batch;
+		size_t limit = 1;
+		prsr.parse_begin(toks);
+		int ret;
+		while ((ret = prsr.parse_next()) > 0) {
+			if (opt) { // names are still being added, so nothing is hoisted
+				optimizer(prsr.get_ast()).fold();
+			}
+			cmp.append(batch.bc);
+			if (batch.bc.code_.size() >= limit) {
+				if (!out.push(std::move(batch))) {
+					in.cancel();
+					return;
+				}
+				batch = code_batch();
+				limit = std::min(limit * 2, code_batch_size);
+			}
+		}
+		if (ret < 0) {
+			batch.errors = prsr.get_errors();
+		}
+		if (!batch.bc.code_.empty() || !batch.errors.empty()) {
+			out.push(std::move(batch));
+		}
+		out.close();
+		in.cancel(); // stops the lexer if parsing stopped on an error
+	}
+
+	int run_pipelined(
+		const source& prog, symbol_table& names, input& in, output& out, bool opt
+	) {
+		bounded_queue<token_buffer> tokens(queue_capacity);
+		bounded_queue<code_batch> code(queue_capacity);
+		std::thread lexer_thread(
+			lex_stage, std::cref(prog), std::ref(names), std::ref(tokens)
+		);
+		std::thread parser_thread(
+			parse_stage, std::ref(tokens), std::ref(code), opt
+		);
+
+		vm machine(in, out);
+		code_batch batch;
+		int ret = 0;
+		while (ret == 0 && code.pop(batch)) {
+			if (!batch.bc.code_.empty()) {
+				ret = machine.resume(batch.bc);
+				out.flush(); // what is printed is seen at once
+			}
+			if (ret == 0 && !batch.errors.empty()) {
+				out.flush();
+				std::cerr << batch.errors;
+				ret = -1;
+			}
+		}
+		code.cancel();
+		parser_thread.join();
+		lexer_thread.join();
+
+		return ret;
+	}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "compiler.h"
+#include "io.h"
+#include "lexer.h"
+#include "source.h"
+#include "symbols.h"
+
+namespace cplr {
+
+	// queue between two threads: push waits while it is full and pop waits
+	// while it is empty
+	template <typename T>
+	class bounded_queue final {
+	public:
+		explicit bounded_queue(size_t capacity);
+
+		bool push(T&& item); // false if the queue is cancelled
+		bool pop(T& item); // false if there will be no more items
+		void close(); // nothing more will be pushed, the rest can be popped
+		void cancel(); // the consumer is gone, items are dropped
+		bool empty();
+
+	private:
+		std::mutex mtx_;
+		std::condition_variable not_full_;
+		std::condition_variable not_empty_;
+		std::deque<T> items_;
+		size_t capacity_;
+		bool closed_;
+		bool cancelled_;
+	};
+
+	// consuming end of the queue filled by the lexer thread
+	class token_queue final : public token_source {
+	public:
+		explicit token_queue(bounded_queue<token_buffer>& in);
+
+		bool pull() override; // takes the next block of tokens
+		const token_buffer& window() const override;
+
+	private:
+		static const size_t keep_size = 64; // tokens the parser may look back
+
+		bounded_queue<token_buffer>& in_;
+		token_buffer window_;
+		token_buffer block_;
+	};
+
+	struct code_batch { // statements compiled together
+		bytecode bc;
+		std::string errors; // syntax errors found after the statements
+	};
+
+	// lexer, parser with compiler, and vm run on three threads: tokens go from
+	// the lexer by blocks, top-level statements are compiled as soon as they
+	// are parsed and run while the rest of the program is still being read
+	int run_pipelined(
+		const source& prog, symbol_table& names, input& in, output& out, bool opt
+	);
+
+	template <typename T>
+	bounded_queue<T>::bounded_queue(size_t capacity)
+	: capacity_(capacity)
+	, closed_(false)
+	, cancelled_(false)
+	{}
+
+	template <typename T>
+	bool bounded_queue<T>::push(T&& item) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		not_full_.wait(lock, [this] {
+			return items_.size() < capacity_ || cancelled_;
+		});
+		if (cancelled_) {
+			return false;
+		}
+		items_.push_back(std::move(item));
+		not_empty_.notify_one();
+		return true;
+	}
+
+	template <typename T>
+	bool bounded_queue<T>::pop(T& item) {
+		std::unique_lock<std::mutex> lock(mtx_);
+		not_empty_.wait(lock, [this] {
+			return !items_.empty() || closed_ || cancelled_;
+		});
+		if (cancelled_ || items_.empty()) {
+			return false;
+		}
+		item = std::move(items_.front());
+		items_.pop_front();
+		not_full_.notify_one();
+		return true;
+	}
+
+	template <typename T>
+	void bounded_queue<T>::close() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		closed_ = true;
+		not_empty_.notify_all();
+	}
+
+	template <typename T>
+	void bounded_queue<T>::cancel() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		cancelled_ = true;
+		items_.clear();
+		not_full_.notify_all();
+		not_empty_.notify_all();
+	}
+
+	template <typename T>
+	bool bounded_queue<T>::empty() {
+		std::lock_guard<std::mutex> lock(mtx_);
+		return items_.empty();
+	}
+
+}
@@ -0,0 +1,422 @@
+#include "ranges.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+
+namespace cplr {
+
+	using range = range_analysis::range;
+	using op_t = ir::op_t;
+
+	static const size_t max_facts = 8; // conditions kept by block
+	static const size_t max_depth = 32; // dominators looked through for them
+	static const unsigned char widen_after = 2; // updates of a phi
+
+	static const range full_range = {INT_MIN, INT_MAX, false};
+	static const range empty_range = {1, 0, false};
+
+	bool range::empty() const {
+		return lo > hi;
+	}
+
+	bool range::has(int val) const {
+		return lo <= val && val <= hi;
+	}
+
+	bool range::is_nonzero() const {
+		return nonzero || lo > 0 || hi < 0;
+	}
+
+	static range make_range(int64_t lo, int64_t hi) {
+		if (lo < INT_MIN || hi > INT_MAX) { // wraps around
+			return full_range;
+		}
+		return {static_cast<int>(lo), static_cast<int>(hi), false};
+	}
+
+	static range join(const range& a, const range& b) {
+		if (a.empty()) {
+			return b;
+		} else if (b.empty()) {
+			return a;
+		}
+		return {
+			std::min(a.lo, b.lo), std::max(a.hi, b.hi), a.is_nonzero() && b.is_nonzero()
+		};
+	}
+
+	static bool same(const range& a, const range& b) {
+		if (a.empty() || b.empty()) {
+			return a.empty() == b.empty();
+		}
+		return a.lo == b.lo && a.hi == b.hi && a.is_nonzero() == b.is_nonzero();
+	}
+
+	static range truth(bool always, bool never) {
+		return {never ? 0 : always ? 1 : 0, always ? 1 : never ? 0 : 1, false};
+	}
+
+	static bool is_comparison(op_t op) {
+		return op >= op_t::EQ && op <= op_t::GT;
+	}
+
+	// x op y as y op' x
+	static op_t mirror(op_t op) {
+		switch (op) {
+			case op_t::LT: return op_t::GT;
+			case op_t::LE: return op_t::GE;
+			case op_t::GE: return op_t::LE;
+			case op_t::GT: return op_t::LT;
+			default: return op;
+		}
+	}
+
+	static op_t negate(op_t op) {
+		switch (op) {
+			case op_t::EQ: return op_t::NE;
+			case op_t::NE: return op_t::EQ;
+			case op_t::LT: return op_t::GE;
+			case op_t::LE: return op_t::GT;
+			case op_t::GE: return op_t::LT;
+			default: return op_t::LE; // op_t::GT
+		}
+	}
+
+	range_analysis::range_analysis(const ir& code)
+	: code_(code)
+	{}
+
+	// goes over the blocks in order until nothing changes; a phi growing more
+	// than widen_after times grows to the end of int at once, so loops take a
+	// few rounds
+	void range_analysis::run() {
+		std::vector<block_t> order = code_.order();
+		find_facts(order);
+		size_t n = code_.instrs_.size();
+		ranges_.assign(n, empty_range);
+		updates_.assign(n, 0);
+		for (value_t v = 0; v < n; ++v) {
+			if (code_.instrs_[v].op_ == op_t::CONST) {
+				int val = code_.instrs_[v].val_;
+				ranges_[v] = {val, val, false};
+			}
+		}
+
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (auto b : order) {
+				const ir::block& blk = code_.blocks_[b];
+				for (int part = 0; part < 2; ++part) {
+					for (auto v : part == 0 ? blk.phis_ : blk.code_) {
+						range old = ranges_[v];
+						range now = join(old, eval(v));
+						if (same(now, old)) {
+							continue;
+						} else if (part == 0 && !old.empty() && ++updates_[v] > widen_after) {
+							if (now.lo < old.lo) {
+								now.lo = INT_MIN;
+							}
+							if (now.hi > old.hi) {
+								now.hi = INT_MAX;
+							}
+						}
+						ranges_[v] = now;
+						changed = true;
+					}
+				}
+			}
+		}
+	}
+
+	range range_analysis::of(value_t v) const {
+		return v < ranges_.size() ? ranges_[v] : full_range;
+	}
+
+	range range_analysis::at(value_t v, block_t b) const {
+		range r = of(v);
+		for (auto& f : facts_[b]) {
+			r = refine(r, v, f);
+		}
+		return r;
+	}
+
+	// values made after the analysis are boolean by their operation only
+	bool range_analysis::is_boolean(value_t v) const {
+		if (v >= ranges_.size()) {
+			op_t op = code_.instrs_[v].op_;
+			return is_comparison(op) || op == op_t::NOT || op == op_t::AND || \
+				op == op_t::OR;
+		}
+		const range& r = ranges_[v];
+		return !r.empty() && r.lo >= 0 && r.hi <= 1;
+	}
+
+	// INT_MIN / -1 overflows
+	bool range_analysis::is_safe_divisor(value_t lhs, value_t rhs, block_t b) const {
+		range by = at(rhs, b);
+		return by.is_nonzero() && (!by.has(-1) || !at(lhs, b).has(INT_MIN));
+	}
+
+	// a block entered only from a branch knows which way it went, and so does
+	// every block it dominates
+	void range_analysis::find_facts(const std::vector<block_t>& order) {
+		size_t blocks = code_.blocks_.size();
+		std::vector<size_t> index(blocks, SIZE_MAX); // in order
+		for (size_t i = 0; i < order.size(); ++i) {
+			index[order[i]] = i;
+		}
+		std::vector<block_t> idoms(blocks, ir::none);
+		if (!order.empty()) {
+			idoms[order[0]] = order[0];
+		}
+		// Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm"
+		bool changed = true;
+		while (changed) {
+			changed = false;
+			for (size_t i = 1; i < order.size(); ++i) {
+				block_t idom = ir::none;
+				for (auto p : code_.blocks_[order[i]].preds_) {
+					if (idoms[p] == ir::none) {
+						continue;
+					} else if (idom == ir::none) {
+						idom = p;
+						continue;
+					}
+					block_t other = p;
+					while (idom != other) {
+						while (index[idom] > index[other]) {
+							idom = idoms[idom];
+						}
+						while (index[other] > index[idom]) {
+							other = idoms[other];
+						}
+					}
+				}
+				if (idoms[order[i]] != idom) {
+					idoms[order[i]] = idom;
+					changed = true;
+				}
+			}
+		}
+
+		facts_.assign(blocks, {});
+		for (auto b : order) {
+			block_t cur = b;
+			for (
+				size_t depth = 0;
+				cur != order[0] && depth < max_depth && facts_[b].size() < max_facts;
+				++depth
+			) {
+				const std::vector<block_t>& preds = code_.blocks_[cur].preds_;
+				if (preds.size() == 1) {
+					const ir::block& from = code_.blocks_[preds[0]];
+					if (from.term_ == ir::term_t::BR && from.succ_[0] != from.succ_[1]) {
+						facts_[b].push_back({from.cond_, from.succ_[0] == cur});
+					}
+				}
+				cur = idoms[cur];
+			}
+		}
+	}
+
+	// narrows r, the range of v, by what f tells about v
+	range range_analysis::refine(range r, value_t v, const fact& f) const {
+		if (f.cond == v) {
+			if (f.holds) {
+				r.nonzero = true;
+			} else {
+				r.lo = std::max(r.lo, 0);
+				r.hi = std::min(r.hi, 0);
+			}
+			return r;
+		}
+		const ir::instr& cond = code_.instrs_[f.cond];
+		if (!is_comparison(cond.op_) || cond.args_[0] == cond.args_[1]) {
+			return r;
+		}
+		op_t op = cond.op_;
+		value_t other = cond.args_[1];
+		if (cond.args_[0] != v) {
+			if (cond.args_[1] != v) {
+				return r;
+			}
+			op = mirror(op);
+			other = cond.args_[0];
+		}
+		if (!f.holds) {
+			op = negate(op);
+		}
+		range by = of(other);
+		if (by.empty()) {
+			return r;
+		}
+		switch (op) {
+			case op_t::LT:
+				if (by.hi == INT_MIN) {
+					return empty_range;
+				}
+				r.hi = std::min(r.hi, by.hi - 1);
+				break;
+			case op_t::LE:
+				r.hi = std::min(r.hi, by.hi);
+				break;
+			case op_t::GT:
+				if (by.lo == INT_MAX) {
+					return empty_range;
+				}
+				r.lo = std::max(r.lo, by.lo + 1);
+				break;
+			case op_t::GE:
+				r.lo = std::max(r.lo, by.lo);
+				break;
+			case op_t::EQ:
+				r.lo = std::max(r.lo, by.lo);
+				r.hi = std::min(r.hi, by.hi);
+				r.nonzero = r.nonzero || by.is_nonzero();
+				break;
+			default: // op_t::NE
+				if (by.lo != by.hi) {
+					break;
+				} else if (by.lo == 0) {
+					r.nonzero = true;
+				}
+				if (r.lo == by.lo && r.lo < INT_MAX) {
+					++r.lo;
+				} else if (r.hi == by.lo && r.hi > INT_MIN) {
+					--r.hi;
+				}
+				break;
+		}
+		return r;
+	}
+
+	range range_analysis::eval(value_t v) const {
+		const ir::instr& in = code_.instrs_[v];
+		block_t b = in.block_;
+		switch (in.op_) {
+			case op_t::CONST:
+				return {in.val_, in.val_, false};
+			case op_t::PHI: { // the argument is read on the edge
+				range r = empty_range;
+				const ir::block& blk = code_.blocks_[b];
+				for (size_t i = 0; i < in.args_.size(); ++i) {
+					block_t p = blk.preds_[i];
+					range arg = at(in.args_[i], p);
+					const ir::block& from = code_.blocks_[p];
+					if (from.term_ == ir::term_t::BR) {
+						arg = refine(arg, in.args_[i], {from.cond_, from.succ_[0] == b});
+					}
+					r = join(r, arg);
+				}
+				return r;
+			}
+			case op_t::SCAN:
+				return full_range;
+			case op_t::PRINT: case op_t::NOP:
+				return empty_range;
+			default:
+				break;
+		}
+
+		range x = at(in.args_[0], b);
+		if (x.empty()) {
+			return empty_range;
+		}
+		if (in.op_ == op_t::NOT) {
+			return truth(x.lo == 0 && x.hi == 0, x.is_nonzero());
+		} else if (in.op_ == op_t::NEG) {
+			if (x.lo == INT_MIN) {
+				return {INT_MIN, INT_MAX, x.is_nonzero()};
+			}
+			return {-x.hi, -x.lo, x.is_nonzero()};
+		}
+		range y = at(in.args_[1], b);
+		if (y.empty()) {
+			return empty_range;
+		}
+		int64_t xlo = x.lo, xhi = x.hi, ylo = y.lo, yhi = y.hi;
+		switch (in.op_) {
+			case op_t::ADD:
+				return make_range(xlo + ylo, xhi + yhi);
+			case op_t::SUB:
+				return make_range(xlo - yhi, xhi - ylo);
+			case op_t::MUL: {
+				int64_t c[] = {xlo * ylo, xlo * yhi, xhi * ylo, xhi * yhi};
+				return make_range(*std::min_element(c, c + 4), *std::max_element(c, c + 4));
+			}
+			case op_t::DIV: case op_t::DIVN:
+				return eval_div(x, y);
+			case op_t::REM: case op_t::REMN:
+				return eval_rem(x, y);
+			case op_t::EQ:
+				return truth(
+					x.lo == x.hi && y.lo == y.hi && x.lo == y.lo, x.hi < y.lo || y.hi < x.lo
+				);
+			case op_t::NE:
+				return truth(
+					x.hi < y.lo || y.hi < x.lo, x.lo == x.hi && y.lo == y.hi && x.lo == y.lo
+				);
+			case op_t::LT:
+				return truth(x.hi < y.lo, x.lo >= y.hi);
+			case op_t::LE:
+				return truth(x.hi <= y.lo, x.lo > y.hi);
+			case op_t::GE:
+				return truth(x.lo >= y.hi, x.hi < y.lo);
+			case op_t::GT:
+				return truth(x.lo > y.hi, x.hi <= y.lo);
+			case op_t::AND:
+				return truth(
+					x.is_nonzero() && y.is_nonzero(),
+					(x.lo == 0 && x.hi == 0) || (y.lo == 0 && y.hi == 0)
+				);
+			case op_t::OR:
+				return truth(
+					x.is_nonzero() || y.is_nonzero(),
+					x.lo == 0 && x.hi == 0 && y.lo == 0 && y.hi == 0
+				);
+			default:
+				return full_range;
+		}
+	}
+
+	// the quotient is monotonic in either operand while the divisor keeps its
+	// sign, so it is bounded by the corners of the positive and the negative
+	// parts of the divisor; 0 stops the program and gives nothing
+	range range_analysis::eval_div(const range& lhs, const range& rhs) const {
+		range r = empty_range;
+		int64_t parts[2][2] = {
+			{std::max(rhs.lo, 1), rhs.hi}, {rhs.lo, std::min(rhs.hi, -1)}
+		};
+		for (auto& part : parts) {
+			if (part[0] > part[1]) {
+				continue;
+			}
+			int64_t c[] = {
+				lhs.lo / part[0], lhs.lo / part[1], lhs.hi / part[0], lhs.hi / part[1]
+			};
+			r = join(r, make_range(*std::min_element(c, c + 4), *std::max_element(c, c + 4)));
+		}
+		return r;
+	}
+
+	// the remainder has the sign of the dividend and is less than the divisor
+	// in magnitude
+	range range_analysis::eval_rem(const range& lhs, const range& rhs) const {
+		int64_t most = 0;
+		if (rhs.hi >= 1) {
+			most = rhs.hi;
+		}
+		if (rhs.lo <= -1) {
+			most = std::max(most, -static_cast<int64_t>(rhs.lo));
+		}
+		if (most == 0) {
+			return empty_range;
+		}
+		int64_t lo = lhs.lo >= 0 ? 0 : std::max<int64_t>(lhs.lo, 1 - most);
+		int64_t hi = lhs.hi <= 0 ? 0 : std::min<int64_t>(lhs.hi, most - 1);
+		return make_range(lo, hi);
+	}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "ir.h"
+
+namespace cplr {
+
+	// what is known about the values of a program in SSA form: the interval
+	// of integers each value lies in, narrowed where it is read by the
+	// conditions of the branches leading there, so a value is boolean when
+	// it is 0 or 1 and a divisor is safe when it is never 0
+	class range_analysis final {
+	public:
+		using value_t = ir::value_t;
+		using block_t = ir::block_t;
+
+		struct range {
+			int lo;
+			int hi; // lo > hi when the value is never set
+			bool nonzero; // even when lo <= 0 <= hi
+
+			bool empty() const;
+			bool has(int val) const;
+			bool is_nonzero() const;
+		};
+
+		explicit range_analysis(const ir& code);
+		void run();
+		range of(value_t v) const; // where it is set
+		range at(value_t v, block_t b) const; // where it is read in b
+		bool is_boolean(value_t v) const;
+		bool is_safe_divisor(value_t lhs, value_t rhs, block_t b) const;
+
+	private:
+		struct fact { // a branch known to be taken this way on entry
+			value_t cond;
+			bool holds;
+		};
+
+		void find_facts(const std::vector<block_t>& order);
+		range refine(range r, value_t v, const fact& f) const;
+		range eval(value_t v) const;
+		range eval_div(const range& lhs, const range& rhs) const;
+		range eval_rem(const range& lhs, const range& rhs) const;
+
+		const ir& code_;
+		std::vector<range> ranges_; // by value
+		std::vector<unsigned char> updates_; // by value, phis are widened
+		std::vector<std::vector<fact>> facts_; // by block
+	};
+
+}
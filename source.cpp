@@ -0,0 +1,110 @@
+#include "source.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cplr {
+
+	source::source()
+	: data_(nullptr)
+	, size_(0)
+	, mapped_(false)
+	{}
+
+	source::~source() {
+		close();
+	}
+
+	int source::open(const char *path) {
+		close();
+		bool is_stdin = strcmp(path, "-") == 0;
+		int fd = is_stdin ? STDIN_FILENO : ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return -1;
+		}
+
+		struct stat st;
+		int ret = 0;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *addr = mmap(
+				nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0
+			);
+			if (addr != MAP_FAILED) {
+				madvise(addr, st.st_size, MADV_SEQUENTIAL); // only a hint
+				data_ = static_cast<const char *>(addr);
+				size_ = st.st_size;
+				mapped_ = true;
+			} else {
+				ret = read_all(fd);
+			}
+		} else {
+			ret = read_all(fd);
+		}
+		if (!is_stdin) {
+			::close(fd);
+		}
+
+		return ret;
+	}
+
+	// pipes don't know their size, so the buffer grows until eof
+	int source::read_all(int fd) {
+		buffer_.resize(1 << 16);
+		size_t used = 0;
+		while (1) {
+			if (used == buffer_.size()) {
+				buffer_.resize(buffer_.size() * 2);
+			}
+			ssize_t got = read(fd, buffer_.data() + used, buffer_.size() - used);
+			if (got < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				buffer_.clear();
+				return -1;
+			}
+			if (got == 0) {
+				break;
+			}
+			used += got;
+		}
+		buffer_.resize(used);
+		data_ = buffer_.data();
+		size_ = used;
+
+		return 0;
+	}
+
+	void source::close() {
+		if (mapped_) {
+			munmap(const_cast<char *>(data_), size_);
+		}
+		buffer_.clear();
+		buffer_.shrink_to_fit();
+		data_ = nullptr;
+		size_ = 0;
+		mapped_ = false;
+	}
+
+	const char * source::begin() const {
+		return data_;
+	}
+
+	const char * source::end() const {
+		return data_ + size_;
+	}
+
+	size_t source::size() const {
+		return size_;
+	}
+
+	bool source::mapped() const {
+		return mapped_;
+	}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace cplr {
+
+	// text of a program: a regular file is mapped into memory read-only and
+	// the lexer reads the mapping in place, anything else (pipes, terminals,
+	// stdin given as -) is read into a buffer
+	class source final {
+	public:
+		source();
+		~source();
+		source(const source&) = delete;
+		source& operator=(const source&) = delete;
+
+		int open(const char *path); // 0 on success, -1 if it can't be read
+		void close();
+		const char * begin() const;
+		const char * end() const;
+		size_t size() const;
+		bool mapped() const;
+
+	private:
+		int read_all(int fd);
+
+		const char *data_;
+		size_t size_;
+		bool mapped_;
+		std::vector<char> buffer_; // used when the file can't be mapped
+	};
+
+}
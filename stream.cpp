@@ -0,0 +1,207 @@
+#include "stream.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cplr {
+
+	//--------chunk_ring::iterator--------
+
+	chunk_ring::iterator::iterator()
+	: ring_(nullptr)
+	, pos_(0)
+	{}
+
+	chunk_ring::iterator::iterator(chunk_ring *ring, size_t pos)
+	: ring_(ring)
+	, pos_(pos)
+	{}
+
+	chunk_ring::iterator::reference chunk_ring::iterator::operator*() const {
+		return ring_->at(pos_);
+	}
+
+	chunk_ring::iterator& chunk_ring::iterator::operator++() {
+		++pos_;
+		return *this;
+	}
+
+	chunk_ring::iterator chunk_ring::iterator::operator++(int) {
+		iterator old = *this;
+		++pos_;
+		return old;
+	}
+
+	// the end of input is only known once it is read up to, so an iterator
+	// equals to end when nothing is left after it
+	bool chunk_ring::iterator::operator==(const iterator& other) const {
+		if (ring_ == nullptr || other.ring_ == nullptr) {
+			return at_eof() == other.at_eof();
+		}
+		return pos_ == other.pos_;
+	}
+
+	bool chunk_ring::iterator::operator!=(const iterator& other) const {
+		return !(*this == other);
+	}
+
+	size_t chunk_ring::iterator::pos() const {
+		return pos_;
+	}
+
+	bool chunk_ring::iterator::at_eof() const {
+		return ring_ == nullptr || !ring_->load_to(pos_);
+	}
+
+	//--------chunk_ring--------
+
+	chunk_ring::chunk_ring(size_t chunk_size)
+	: fd_(-1)
+	, own_fd_(false)
+	, eof_(false)
+	, failed_(false)
+	, chunk_size_(chunk_size)
+	, front_pos_(0)
+	, loaded_end_(0)
+	{}
+
+	chunk_ring::~chunk_ring() {
+		close();
+	}
+
+	int chunk_ring::open(const char *path) {
+		close();
+		own_fd_ = strcmp(path, "-") != 0;
+		fd_ = own_fd_ ? ::open(path, O_RDONLY) : STDIN_FILENO;
+		if (fd_ < 0) {
+			own_fd_ = false;
+			return -1;
+		}
+		load_to(0); // a directory and the like fail on the first read
+		return failed_ ? -1 : 0;
+	}
+
+	void chunk_ring::close() {
+		if (own_fd_) {
+			::close(fd_);
+		}
+		fd_ = -1;
+		own_fd_ = false;
+		eof_ = false;
+		failed_ = false;
+		chunks_.clear();
+		spare_.clear();
+		front_pos_ = 0;
+		loaded_end_ = 0;
+	}
+
+	chunk_ring::iterator chunk_ring::begin() {
+		return iterator(this, front_pos_);
+	}
+
+	chunk_ring::iterator chunk_ring::end() {
+		return iterator();
+	}
+
+	void chunk_ring::release(size_t pos) {
+		while (!chunks_.empty() && front_pos_ + chunk_size_ <= pos) {
+			if (spare_.empty()) {
+				spare_.push_back(std::move(chunks_.front()));
+			}
+			chunks_.pop_front();
+			front_pos_ += chunk_size_;
+		}
+	}
+
+	size_t chunk_ring::footprint() const {
+		return (chunks_.size() + spare_.size()) * chunk_size_;
+	}
+
+	// every chunk but the last one is filled up, so a position is found in
+	// the ring by division; a token longer than the ring makes it grow
+	bool chunk_ring::load_to(size_t pos) {
+		while (pos >= loaded_end_ && !eof_) {
+			std::unique_ptr<char[]> chunk;
+			if (!spare_.empty()) {
+				chunk = std::move(spare_.back());
+				spare_.pop_back();
+			} else {
+				chunk.reset(new char[chunk_size_]);
+			}
+			size_t used = 0;
+			while (used < chunk_size_) {
+				ssize_t got = read(fd_, chunk.get() + used, chunk_size_ - used);
+				if (got < 0 && errno == EINTR) {
+					continue;
+				}
+				if (got <= 0) { // errors end the input as well
+					failed_ = got < 0;
+					eof_ = true;
+					break;
+				}
+				used += got;
+			}
+			if (used == 0) {
+				spare_.push_back(std::move(chunk));
+				break;
+			}
+			if (chunks_.empty()) {
+				front_pos_ = loaded_end_;
+			}
+			chunks_.push_back(std::move(chunk));
+			loaded_end_ += used;
+		}
+		return pos < loaded_end_;
+	}
+
+	const char& chunk_ring::at(size_t pos) {
+		load_to(pos);
+		size_t rel = pos - front_pos_;
+		return chunks_[rel / chunk_size_][rel % chunk_size_];
+	}
+
+	//--------token_stream--------
+
+	token_stream::token_stream(symbol_table& names, size_t chunk_size)
+	: ring_(chunk_size)
+	, names_(names)
+	{}
+
+	int token_stream::open(const char *path) {
+		window_.clear();
+		if (ring_.open(path) != 0) {
+			return -1;
+		}
+		cur_ = ring_.begin();
+		return 0;
+	}
+
+	bool token_stream::pull() {
+		chunk_ring::iterator end = ring_.end();
+		token tk;
+		skip_spaces(cur_, end);
+		if (cur_ == end) {
+			return false;
+		}
+		size_t offset = cur_.pos();
+		ring_.release(offset);
+		read_token(cur_, end, names_, tk);
+		if (window_.size() >= window_size) {
+			window_.drop_before(window_.end() - keep_size);
+		}
+		window_.push(tk, offset);
+		return true;
+	}
+
+	const token_buffer& token_stream::window() const {
+		return window_;
+	}
+
+	size_t token_stream::footprint() const {
+		return ring_.footprint() + window_.footprint();
+	}
+
+}
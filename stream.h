@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "lexer.h"
+#include "symbols.h"
+
+namespace cplr {
+
+	// input read by fixed-size chunks as it is walked through; chunks which
+	// lie wholly before the released position are recycled, so only the
+	// token being read and the chunk after it stay in memory
+	class chunk_ring final {
+	public:
+		class iterator final { // position in the input, reads chunks on demand
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = char;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const char *;
+			using reference = const char&;
+
+			iterator();
+			iterator(chunk_ring *ring, size_t pos);
+			reference operator*() const;
+			iterator& operator++();
+			iterator operator++(int);
+			bool operator==(const iterator& other) const;
+			bool operator!=(const iterator& other) const;
+			size_t pos() const; // bytes from the start of the input
+
+		private:
+			bool at_eof() const;
+
+			chunk_ring *ring_; // nullptr for the end of input
+			size_t pos_;
+		};
+
+		explicit chunk_ring(size_t chunk_size = 1 << 16);
+		~chunk_ring();
+		chunk_ring(const chunk_ring&) = delete;
+		chunk_ring& operator=(const chunk_ring&) = delete;
+
+		int open(const char *path); // 0 on success, - is stdin
+		void close();
+		iterator begin();
+		iterator end();
+		void release(size_t pos); // bytes before pos won't be read again
+		size_t footprint() const; // bytes taken by the chunks
+
+	private:
+		bool load_to(size_t pos); // false if pos is past the end of input
+		const char& at(size_t pos);
+
+		int fd_;
+		bool own_fd_;
+		bool eof_;
+		bool failed_; // reading failed, not just ended
+		size_t chunk_size_;
+		std::deque<std::unique_ptr<char[]>> chunks_; // loaded, oldest first
+		std::vector<std::unique_ptr<char[]>> spare_; // recycled
+		size_t front_pos_; // where the oldest loaded chunk starts
+		size_t loaded_end_; // where the newest loaded chunk ends
+	};
+
+	// tokens of a program pulled one by one from chunk_ring: the parser asks
+	// for the next token when it needs one and only the last tokens are kept
+	class token_stream final : public token_source {
+	public:
+		explicit token_stream(symbol_table& names, size_t chunk_size = 1 << 16);
+
+		int open(const char *path);
+		bool pull() override; // lexes the next token into the window
+		const token_buffer& window() const override;
+		size_t footprint() const; // bytes taken by the chunks and the window
+
+	private:
+		static const size_t window_size = 1 << 12; // tokens
+		static const size_t keep_size = 64; // tokens the parser may look back
+
+		chunk_ring ring_;
+		chunk_ring::iterator cur_;
+		symbol_table& names_;
+		token_buffer window_;
+	};
+
+}
@@ -0,0 +1,102 @@
+#include "symbols.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cplr {
+
+	static const size_t min_block_size = 1 << 16;
+
+	symbol_table::symbol_table()
+	: block_used_(0)
+	, block_size_(0)
+	, arena_size_(0)
+	{
+		clear();
+	}
+
+	void symbol_table::clear() {
+		slots_.assign(64, 0);
+		names_.clear();
+		hashes_.clear();
+		blocks_.clear();
+		block_used_ = 0;
+		block_size_ = 0;
+		arena_size_ = 0;
+	}
+
+	size_t symbol_table::size() const {
+		return names_.size();
+	}
+
+	uint32_t symbol_table::hash(std::string_view name) { // FNV-1a
+		uint32_t h = 2166136261u;
+		for (char c : name) {
+			h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+		}
+		return h;
+	}
+
+	size_t symbol_table::intern(std::string_view name) {
+		uint32_t h = hash(name);
+		size_t mask = slots_.size() - 1;
+		size_t i = h & mask;
+		while (slots_[i] != 0) {
+			size_t id = slots_[i] - 1;
+			if (hashes_[id] == h && names_[id] == name) {
+				return id;
+			}
+			i = (i + 1) & mask;
+		}
+
+		size_t id = names_.size();
+		names_.emplace_back(store(name), name.size());
+		hashes_.push_back(h);
+		slots_[i] = static_cast<uint32_t>(id + 1);
+		if (names_.size() * 2 > slots_.size()) { // load factor stays under 1/2
+			rehash(slots_.size() * 2);
+		}
+		return id;
+	}
+
+	size_t symbol_table::intern(const char *first, const char *last) {
+		return intern(std::string_view(first, last - first));
+	}
+
+	std::string_view symbol_table::name(size_t id) const {
+		return names_[id];
+	}
+
+	size_t symbol_table::footprint() const {
+		return slots_.capacity() * sizeof(uint32_t) + \
+			names_.capacity() * sizeof(std::string_view) + \
+			hashes_.capacity() * sizeof(uint32_t) + arena_size_;
+	}
+
+	const char * symbol_table::store(std::string_view name) {
+		if (blocks_.empty() || block_used_ + name.size() > block_size_) {
+			// the rest of the current block is given up, names are short
+			block_size_ = std::max(min_block_size, name.size());
+			blocks_.emplace_back(new char[block_size_]);
+			arena_size_ += block_size_;
+			block_used_ = 0;
+		}
+		char *dst = blocks_.back().get() + block_used_;
+		memcpy(dst, name.data(), name.size());
+		block_used_ += name.size();
+		return dst;
+	}
+
+	void symbol_table::rehash(size_t capacity) {
+		slots_.assign(capacity, 0);
+		size_t mask = capacity - 1;
+		for (size_t id = 0; id < names_.size(); ++id) {
+			size_t i = hashes_[id] & mask;
+			while (slots_[i] != 0) {
+				i = (i + 1) & mask;
+			}
+			slots_[i] = static_cast<uint32_t>(id + 1);
+		}
+	}
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cplr {
+
+	// interned identifiers: ids are dense and given in the order of the first
+	// appearance, names are kept in an arena of blocks which never move, so
+	// views to them stay valid until clear
+	class symbol_table final {
+	public:
+		symbol_table();
+
+		void clear();
+		size_t size() const;
+		size_t intern(std::string_view name); // id of name, new if not seen
+		size_t intern(const char *first, const char *last);
+		template <typename ForwardIterator>
+		size_t intern(ForwardIterator first, ForwardIterator last);
+		std::string_view name(size_t id) const;
+		size_t footprint() const; // bytes taken by the table and the names
+
+	private:
+		static uint32_t hash(std::string_view name);
+		const char * store(std::string_view name);
+		void rehash(size_t capacity);
+
+		std::vector<uint32_t> slots_; // id + 1, 0 is empty; open addressing
+		std::vector<std::string_view> names_; // by id
+		std::vector<uint32_t> hashes_; // by id, to rehash and to compare fast
+		std::vector<std::unique_ptr<char[]>> blocks_;
+		size_t block_used_;
+		size_t block_size_;
+		size_t arena_size_; // bytes in all the blocks
+		std::string scratch_; // for names not in contiguous memory
+	};
+
+	template <typename ForwardIterator>
+	size_t symbol_table::intern(ForwardIterator first, ForwardIterator last) {
+		scratch_.assign(first, last);
+		return intern(std::string_view(scratch_));
+	}
+
+}
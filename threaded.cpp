@@ -0,0 +1,456 @@
+#include "threaded.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "arith.h"
+
+namespace cplr {
+
+	threaded_vm::threaded_vm(input& in, output& out)
+	: in_(in)
+	, out_(out)
+	, stack_size_(0)
+	, id_count_(0)
+	, instrs_(0)
+	{
+		std::fill(made_, made_ + END, 0);
+		std::fill(runs_, runs_ + END, 0);
+	}
+
+	// a jump lands only on the first instruction of a cell, so whatever a
+	// superinstruction takes after its first one must not be jumped to
+	void threaded_vm::compile(const bytecode& bc) {
+		const std::vector<instr>& code = bc.code_;
+		targets_.assign(code.size() + 1, 0);
+		for (auto& in : code) {
+			if (is_jump(in.op)) {
+				targets_[in.arg] = 1;
+			}
+		}
+		std::fill(made_, made_ + END, 0);
+		cells_.clear();
+		std::vector<int> at(code.size() + 1, 0); // by instruction, its cell
+		for (size_t i = 0; i < code.size();) {
+			at[i] = static_cast<int>(cells_.size());
+			cell c;
+			i += fuse(bc, i, c);
+			cells_.push_back(c);
+			++made_[c.op];
+		}
+		at[code.size()] = static_cast<int>(cells_.size());
+		for (auto& c : cells_) {
+			if (c.op >= JEQ_VV) {
+				c.c = at[c.c];
+			} else if (c.op < INC && is_jump(static_cast<opcode>(c.op))) {
+				c.a = at[c.a];
+			}
+		}
+		divisors_ = bc.divisors_;
+		stack_size_ = bc.stack_size_;
+		id_count_ = bc.id_count_;
+		instrs_ = code.size();
+	}
+
+	// the cell made of the instructions from at, returns how many it takes
+	size_t threaded_vm::fuse(const bytecode& bc, size_t at, cell& to) const {
+		const std::vector<instr>& code = bc.code_;
+		auto is = [&](size_t i, opcode op) {
+			return i < code.size() && code[i].op == op && !targets_[i];
+		};
+		auto is_arith = [&](size_t i) {
+			return is(i, opcode::ADD) || is(i, opcode::SUB) || is(i, opcode::MUL);
+		};
+		const instr& in = code[at];
+		to = {nullptr, static_cast<unsigned char>(in.op), in.arg, 0, 0};
+		if (in.op == opcode::PUSH && is(at + 1, opcode::STORE)) {
+			to = {nullptr, SET, code[at + 1].arg, 0, in.arg};
+			return 2;
+		} else if (in.op != opcode::LOAD) {
+			return 1;
+		}
+
+		if (
+			is(at + 1, opcode::PUSH) && !is(at + 2, opcode::MUL) && is_arith(at + 2) && \
+			is(at + 3, opcode::STORE)
+		) {
+			int k = code[at + 1].arg, x = code[at + 3].arg;
+			if (code[at + 2].op == opcode::SUB) {
+				k = wrap_neg(k); // x - k is x + -k even for INT_MIN
+			}
+			to = {nullptr, x == in.arg ? INC : ADDK, x, in.arg, k};
+			return 4;
+		} else if (is(at + 1, opcode::LOAD) && is_arith(at + 2) && is(at + 3, opcode::STORE)) {
+			opcode op = code[at + 2].op;
+			unsigned char super = op == opcode::ADD ? ADD3 : op == opcode::SUB ? SUB3 : MUL3;
+			to = {nullptr, super, code[at + 3].arg, in.arg, code[at + 1].arg};
+			return 4;
+		} else if (
+			(is(at + 1, opcode::LOAD) || is(at + 1, opcode::PUSH)) && \
+			at + 2 < code.size() && !targets_[at + 2] && \
+			code[at + 2].op >= opcode::JEQ
+		) {
+			int cc = static_cast<int>(code[at + 2].op) - static_cast<int>(opcode::JEQ);
+			int first = code[at + 1].op == opcode::PUSH ? JEQ_VK : JEQ_VV;
+			to = {
+				nullptr, static_cast<unsigned char>(first + cc),
+				in.arg, code[at + 1].arg, code[at + 2].arg
+			};
+			return 3;
+		} else if (is(at + 1, opcode::STORE)) {
+			to = {nullptr, MOVE, code[at + 1].arg, in.arg, 0};
+			return 2;
+		}
+		return 1;
+	}
+
+	int threaded_vm::run(bool counting) {
+		vars_.assign(id_count_, 0);
+		live_.assign(id_count_, 0);
+		stack_.assign(stack_size_ + 1, 0);
+		errors.clear();
+		std::fill(runs_, runs_ + END, 0);
+		return counting ? execute<true>() : execute<false>();
+	}
+
+	// every piece of code ends by jumping to the next cell's; counting is
+	// known at compile time, so the code run uncounted has no trace of it
+	template <bool counting>
+	int threaded_vm::execute() {
+		static const void *const gotos[] = {
+			&&do_halt, &&do_push, &&do_pop, &&do_dup, &&do_load, &&do_loadc,
+			&&do_store, &&do_define, &&do_decl, &&do_kill, &&do_undef, &&do_scan,
+			&&do_print, &&do_not, &&do_neg, &&do_eq, &&do_ne, &&do_lt, &&do_le,
+			&&do_ge, &&do_gt, &&do_add, &&do_sub, &&do_mul, &&do_div, &&do_rem,
+			&&do_divn, &&do_remn, &&do_and, &&do_or, &&do_mulk, &&do_shlk,
+			&&do_divk, &&do_remk, &&do_jmp, &&do_jz, &&do_jnz, &&do_jeq, &&do_jne,
+			&&do_jlt, &&do_jle, &&do_jge, &&do_jgt,
+			&&do_inc, &&do_addk, &&do_move, &&do_set, &&do_add3, &&do_sub3,
+			&&do_mul3, &&do_jeq_vv, &&do_jne_vv, &&do_jlt_vv, &&do_jle_vv,
+			&&do_jge_vv, &&do_jgt_vv, &&do_jeq_vk, &&do_jne_vk, &&do_jlt_vk,
+			&&do_jle_vk, &&do_jge_vk, &&do_jgt_vk
+		};
+		static_assert(
+			sizeof(gotos) / sizeof(*gotos) == END, "code for every opcode and super_t"
+		);
+		for (auto& c : cells_) {
+			c.go = gotos[c.op];
+		}
+
+		cell *cells = cells_.data();
+		cell *pc = cells;
+		int *sp = stack_.data(); // points past the top of the stack
+		int *vars = vars_.data();
+		unsigned char *live = live_.data();
+		const divisor *divisors = divisors_.data();
+		uint64_t *runs = runs_;
+		goto *pc->go;
+
+	do_halt:
+		return 0;
+	do_push:
+		*sp++ = pc->a;
+		goto *(++pc)->go;
+	do_pop:
+		--sp;
+		goto *(++pc)->go;
+	do_dup:
+		*sp = sp[-1];
+		++sp;
+		goto *(++pc)->go;
+	do_load:
+		*sp++ = vars[pc->a];
+		goto *(++pc)->go;
+	do_loadc:
+		if (!live[pc->a]) {
+			goto undefined;
+		}
+		*sp++ = vars[pc->a];
+		goto *(++pc)->go;
+	do_store:
+		vars[pc->a] = *--sp;
+		goto *(++pc)->go;
+	do_define:
+		vars[pc->a] = 0;
+		live[pc->a] = 1;
+		goto *(++pc)->go;
+	do_decl:
+		if (!live[pc->a]) {
+			vars[pc->a] = 0;
+			live[pc->a] = 1;
+		}
+		goto *(++pc)->go;
+	do_kill:
+		live[pc->a] = 0;
+		goto *(++pc)->go;
+	do_undef:
+		goto undefined;
+	do_scan:
+		*sp++ = in_.read_int();
+		goto *(++pc)->go;
+	do_print:
+		out_.write_int(*--sp);
+		goto *(++pc)->go;
+	do_not:
+		sp[-1] = !sp[-1];
+		goto *(++pc)->go;
+	do_neg:
+		sp[-1] = wrap_neg(sp[-1]);
+		goto *(++pc)->go;
+	do_eq:
+		--sp;
+		sp[-1] = sp[-1] == *sp;
+		goto *(++pc)->go;
+	do_ne:
+		--sp;
+		sp[-1] = sp[-1] != *sp;
+		goto *(++pc)->go;
+	do_lt:
+		--sp;
+		sp[-1] = sp[-1] < *sp;
+		goto *(++pc)->go;
+	do_le:
+		--sp;
+		sp[-1] = sp[-1] <= *sp;
+		goto *(++pc)->go;
+	do_ge:
+		--sp;
+		sp[-1] = sp[-1] >= *sp;
+		goto *(++pc)->go;
+	do_gt:
+		--sp;
+		sp[-1] = sp[-1] > *sp;
+		goto *(++pc)->go;
+	do_add:
+		--sp;
+		sp[-1] = wrap_add(sp[-1], *sp);
+		goto *(++pc)->go;
+	do_sub:
+		--sp;
+		sp[-1] = wrap_sub(sp[-1], *sp);
+		goto *(++pc)->go;
+	do_mul:
+		--sp;
+		sp[-1] = wrap_mul(sp[-1], *sp);
+		goto *(++pc)->go;
+	do_div:
+		--sp;
+		if (*sp == 0) {
+			goto division;
+		}
+		sp[-1] = wrap_div(sp[-1], *sp);
+		goto *(++pc)->go;
+	do_rem:
+		--sp;
+		if (*sp == 0) {
+			goto division;
+		}
+		sp[-1] = wrap_rem(sp[-1], *sp);
+		goto *(++pc)->go;
+	do_divn:
+		--sp;
+		sp[-1] = sp[-1] / *sp;
+		goto *(++pc)->go;
+	do_remn:
+		--sp;
+		sp[-1] = sp[-1] % *sp;
+		goto *(++pc)->go;
+	do_and:
+		--sp;
+		sp[-1] &= *sp;
+		goto *(++pc)->go;
+	do_or:
+		--sp;
+		sp[-1] |= *sp;
+		goto *(++pc)->go;
+	do_mulk:
+		sp[-1] = wrap_mul(sp[-1], pc->a);
+		goto *(++pc)->go;
+	do_shlk:
+		sp[-1] = static_cast<int>(static_cast<unsigned>(sp[-1]) << pc->a);
+		goto *(++pc)->go;
+	do_divk:
+		sp[-1] = div_by(divisors[pc->a], sp[-1]);
+		goto *(++pc)->go;
+	do_remk:
+		sp[-1] = rem_by(divisors[pc->a], sp[-1]);
+		goto *(++pc)->go;
+	do_jmp:
+		pc = cells + pc->a;
+		goto *pc->go;
+	do_jz:
+		pc = *--sp == 0 ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jnz:
+		pc = *--sp != 0 ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jeq:
+		sp -= 2;
+		pc = sp[0] == sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jne:
+		sp -= 2;
+		pc = sp[0] != sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jlt:
+		sp -= 2;
+		pc = sp[0] < sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jle:
+		sp -= 2;
+		pc = sp[0] <= sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jge:
+		sp -= 2;
+		pc = sp[0] >= sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+	do_jgt:
+		sp -= 2;
+		pc = sp[0] > sp[1] ? cells + pc->a : pc + 1;
+		goto *pc->go;
+
+	// superinstructions
+	do_inc:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = wrap_add(vars[pc->a], pc->c);
+		goto *(++pc)->go;
+	do_addk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = wrap_add(vars[pc->b], pc->c);
+		goto *(++pc)->go;
+	do_move:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = vars[pc->b];
+		goto *(++pc)->go;
+	do_set:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = pc->c;
+		goto *(++pc)->go;
+	do_add3:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = wrap_add(vars[pc->b], vars[pc->c]);
+		goto *(++pc)->go;
+	do_sub3:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = wrap_sub(vars[pc->b], vars[pc->c]);
+		goto *(++pc)->go;
+	do_mul3:
+		if (counting) {
+			++runs[pc->op];
+		}
+		vars[pc->a] = wrap_mul(vars[pc->b], vars[pc->c]);
+		goto *(++pc)->go;
+	do_jeq_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] == vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jne_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] != vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jlt_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] < vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jle_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] <= vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jge_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] >= vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jgt_vv:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] > vars[pc->b] ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jeq_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] == pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jne_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] != pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jlt_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] < pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jle_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] <= pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jge_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] >= pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+	do_jgt_vk:
+		if (counting) {
+			++runs[pc->op];
+		}
+		pc = vars[pc->a] > pc->b ? cells + pc->c : pc + 1;
+		goto *pc->go;
+
+	undefined:
+		errors += "Undefined identifier\n";
+		out_.flush();
+		std::cerr << errors;
+		return -2;
+	division:
+		errors += "Division by zero\n";
+		out_.flush();
+		std::cerr << errors;
+		return -2;
+	}
+
+	void threaded_vm::report(std::ostream& os) const {
+		static const char *super_names[] = {
+			"inc", "addk", "move", "set", "add3", "sub3", "mul3",
+			"jeq.vv", "jne.vv", "jlt.vv", "jle.vv", "jge.vv", "jgt.vv",
+			"jeq.vk", "jne.vk", "jlt.vk", "jle.vk", "jge.vk", "jgt.vk"
+		};
+		static_assert(sizeof(super_names) / sizeof(*super_names) == END - INC, "");
+		os << "threaded: " << instrs_ << " instructions in " << cells_.size() << " cells\n";
+		for (size_t op = INC; op < END; ++op) {
+			if (made_[op] != 0) {
+				os << "super: " << super_names[op - INC] << ' ' << made_[op] \
+					<< " made, run " << runs_[op] << " times\n";
+			}
+		}
+	}
+
+}
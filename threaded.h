@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "compiler.h"
+#include "io.h"
+
+namespace cplr {
+
+	// runs bytecode by direct threading: every instruction becomes a cell
+	// holding the address of the code doing it (GCC labels as values), which
+	// jumps straight to the next one instead of going back to a switch, and
+	// the sequences statements are mostly made of are fused into one cell:
+	// x = x + k, x = y + k, x = y, x = k, x = y op z and branches comparing an
+	// identifier with another one or a constant
+	class threaded_vm final {
+	public:
+		threaded_vm(input& in, output& out); // read by SCAN and written by PRINT
+		void compile(const bytecode& bc);
+		int run(bool counting = false); // as vm::run, counting superinstructions
+		void report(std::ostream& os) const; // superinstructions made and run
+
+	private:
+		enum super_t : unsigned char { // numbered after the opcodes
+			INC = static_cast<unsigned char>(opcode::JGT) + 1, // a = a + c
+			ADDK, // a = b + c
+			MOVE, // a = b
+			SET, // a = c
+			ADD3, // a = b + c, identifiers all
+			SUB3,
+			MUL3,
+			JEQ_VV, // jump to c if a == b
+			JNE_VV,
+			JLT_VV,
+			JLE_VV,
+			JGE_VV,
+			JGT_VV,
+			JEQ_VK, // jump to c if a == the constant b
+			JNE_VK,
+			JLT_VK,
+			JLE_VK,
+			JGE_VK,
+			JGT_VK,
+			END
+		};
+
+		struct cell {
+			const void *go; // set by execute
+			unsigned char op; // opcode or super_t
+			int a;
+			int b;
+			int c;
+		};
+
+		size_t fuse(const bytecode& bc, size_t at, cell& to) const;
+		template <bool counting> int execute();
+
+		input& in_;
+		output& out_;
+		std::vector<cell> cells_;
+		std::vector<unsigned char> targets_; // by instruction, jumped to
+		std::vector<divisor> divisors_;
+		std::vector<int> stack_;
+		std::vector<int> vars_;
+		std::vector<unsigned char> live_;
+		size_t stack_size_;
+		size_t id_count_;
+		size_t instrs_; // of the bytecode
+		uint64_t made_[END]; // by op, cells
+		uint64_t runs_[END]; // times run, when counted
+		std::string errors;
+	};
+
+}
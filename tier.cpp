@@ -0,0 +1,90 @@
+#include "tier.h"
+
+#include <chrono>
+
+namespace cplr {
+
+	static double ms_since(std::chrono::steady_clock::time_point since) {
+		return std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - since
+		).count();
+	}
+
+	tiering::tiering(parser& prsr, input& in, output& out, uint32_t hot_after)
+	: prsr_(prsr)
+	, in_(in)
+	, out_(out)
+	, hot_after_(hot_after)
+	, vm_(in, out)
+	, run_ms_(0)
+	, compile_ms_(0)
+	, tier_ms_{0, 0, 0}
+	{}
+
+	int tiering::run() {
+		auto since = std::chrono::steady_clock::now();
+		int result = prsr_.run(in_, out_, this);
+		run_ms_ = ms_since(since);
+		return result;
+	}
+
+	void tiering::report(std::ostream& os) const {
+		static const char *tier_names[] = {"walk", "vm", "jit"};
+		for (auto& it : events_) {
+			bool is_do = prsr_.get_ast()[it.nd].type_ == node_t::DO;
+			os << "tier-up: " << (is_do ? "do" : "while") << " at node " << it.nd \
+				<< " after " << hot_after_ << " iterations to " \
+				<< tier_names[static_cast<size_t>(it.tier)] << ", " << it.size \
+				<< (it.tier == tier_t::JIT ? " bytes" : " instructions") \
+				<< " in " << it.ms << " ms\n";
+		}
+		double walk_ms = run_ms_ - compile_ms_ - tier_ms_[1] - tier_ms_[2];
+		os << "tiers: walk " << walk_ms << " ms, vm " << tier_ms_[1] << " ms, jit " \
+			<< tier_ms_[2] << " ms, compile " << compile_ms_ << " ms\n";
+	}
+
+	uint32_t tiering::hot_after() const {
+		return hot_after_;
+	}
+
+	// the loop is compiled the first time it is found hot, later entries to
+	// it go to its tier at once
+	int tiering::run_loop(
+		ast::idx_t nd, std::vector<int>& frame, std::vector<unsigned char>& live
+	) {
+		auto it = loops_.find(nd);
+		if (it == loops_.end()) {
+			auto since = std::chrono::steady_clock::now();
+			loop& lp = loops_[nd];
+			lp.tier = tier_t::WALK;
+			if (compiler(prsr_).compile_loop(nd, lp.bc) == 0) {
+				lp.native.reset(new jit(in_, out_));
+				if (lp.native->compile(lp.bc) == 0) {
+					lp.tier = tier_t::JIT;
+				} else {
+					lp.native.reset();
+					lp.tier = tier_t::VM;
+				}
+			}
+			double ms = ms_since(since);
+			compile_ms_ += ms;
+			if (lp.tier != tier_t::WALK) {
+				size_t size = lp.tier == tier_t::JIT ? \
+					lp.native->code_size() : lp.bc.code_.size();
+				events_.push_back({nd, lp.tier, size, ms});
+			}
+			it = loops_.find(nd);
+		}
+
+		loop& lp = it->second;
+		if (lp.tier == tier_t::WALK) {
+			return 1;
+		}
+		auto since = std::chrono::steady_clock::now();
+		int result = lp.tier == tier_t::JIT ? \
+			lp.native->run(frame, live) : vm_.run_on(lp.bc, frame, live);
+		tier_ms_[static_cast<size_t>(lp.tier)] += ms_since(since);
+		return result == 0 ? 0 : -2;
+	}
+
+}
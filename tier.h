@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "ast.h"
+#include "compiler.h"
+#include "io.h"
+#include "jit.h"
+#include "parser.h"
+#include "vm.h"
+
+namespace cplr {
+
+	// runs a program in the tree walker, so it starts at once, and moves a
+	// loop which has run hot_after iterations there into machine code, see
+	// jit, right in the middle of it: the loop is compiled alone and the
+	// identifiers of the walker are copied in, and back out once the loop is
+	// over. A loop whose machine code can't be made falls back to the stack
+	// machine, and one which can't be compiled at all stays in the walker
+	class tiering final : public loop_tier {
+	public:
+		tiering(parser& prsr, input& in, output& out, uint32_t hot_after);
+		int run(); // as parser::run
+		void report(std::ostream& os) const; // tier-ups and time by tier
+
+		uint32_t hot_after() const override;
+		int run_loop(
+			ast::idx_t nd, std::vector<int>& frame, std::vector<unsigned char>& live
+		) override;
+
+	private:
+		enum class tier_t : unsigned char { WALK, VM, JIT };
+
+		struct loop {
+			tier_t tier;
+			bytecode bc;
+			std::unique_ptr<jit> native;
+		};
+
+		struct event { // a loop moved to a faster tier
+			ast::idx_t nd;
+			tier_t tier;
+			size_t size; // bytes of machine code or instructions of bytecode
+			double ms; // taken by compiling
+		};
+
+		parser& prsr_;
+		input& in_;
+		output& out_;
+		uint32_t hot_after_;
+		vm vm_;
+		std::unordered_map<ast::idx_t, loop> loops_;
+		std::vector<event> events_;
+		double run_ms_; // all of it
+		double compile_ms_;
+		double tier_ms_[3]; // by tier_t, the walker is told by the rest
+	};
+
+}
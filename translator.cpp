@@ -0,0 +1,709 @@
+#include "translator.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace cplr {
+
+	//--------runtime--------
+	//
+	//	What the translation starts with: ? parses decimal text like
+	//	input::read_int does, print writes through a buffer of its own which
+	//	is flushed before waiting for input, on errors and at exit, and the
+	//	integers wrap around as arith.h has it. IN_BITS and OUT_BITS pick the
+	//	raw native-endian formats of --binary-in and --binary-out.
+
+	static const char runtime[] = R"(#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char in_buf[1 << 16];
+static const char *in_pos = in_buf, *in_end = in_buf;
+static int in_eof, in_failed;
+static char out_buf[1 << 16];
+static size_t out_used;
+
+static inline void flush_(void) {
+	const char *pos = out_buf;
+	while (out_used > 0) {
+		ssize_t put = write(1, pos, out_used);
+		if (put < 0 && errno == EINTR)
+			continue;
+		if (put <= 0)
+			break;
+		pos += put;
+		out_used -= put;
+	}
+	out_used = 0;
+}
+
+static inline void fail_(const char *error) { /* main exits with 0 after it too */
+	flush_();
+	fputs(error, stderr);
+	exit(0);
+}
+
+static inline int undef_(void) {
+	fail_("Undefined identifier\n");
+	return 0;
+}
+
+static inline int refill_(void) {
+	if (in_eof)
+		return 0;
+	flush_();
+	for (;;) {
+		ssize_t got = read(0, in_buf, sizeof in_buf);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0) {
+			in_eof = 1;
+			return 0;
+		}
+		in_pos = in_buf;
+		in_end = in_buf + got;
+		return 1;
+	}
+}
+
+static inline int scan_(void) {
+	if (in_failed)
+		return 0;
+#if IN_BITS == 0
+	for (;;) {
+		if (in_pos == in_end && !refill_()) {
+			in_failed = 1;
+			return 0;
+		}
+		if (*in_pos != ' ' && (*in_pos < '\t' || *in_pos > '\r'))
+			break;
+		++in_pos;
+	}
+	int neg = 0;
+	if (*in_pos == '-' || *in_pos == '+') {
+		neg = *in_pos == '-';
+		++in_pos;
+	}
+	const uint64_t limit = (uint64_t)INT_MAX + 1;
+	uint64_t acc = 0;
+	size_t digits = 0;
+	while ((in_pos != in_end || refill_()) && *in_pos >= '0' && *in_pos <= '9') {
+		acc = acc * 10 + (*in_pos++ - '0');
+		if (acc > limit)
+			acc = limit + 1;
+		++digits;
+	}
+	if (digits == 0) {
+		in_failed = 1;
+		return 0;
+	}
+	if (acc > limit || (!neg && acc == limit)) {
+		in_failed = 1;
+		return neg ? INT_MIN : INT_MAX;
+	}
+	return neg ? (int)(0 - acc) : (int)acc;
+#else
+	unsigned char raw[IN_BITS / 8];
+	for (size_t i = 0; i < sizeof raw; ++i) {
+		if (in_pos == in_end && !refill_()) {
+			in_failed = 1;
+			return 0;
+		}
+		raw[i] = *in_pos++;
+	}
+#if IN_BITS == 32
+	int32_t value;
+	memcpy(&value, raw, sizeof value);
+	return value;
+#else
+	int64_t value;
+	memcpy(&value, raw, sizeof value);
+	return (int)(uint64_t)value;
+#endif
+#endif
+}
+
+static inline void print_(int value) {
+	if (sizeof out_buf - out_used < 12)
+		flush_();
+#if OUT_BITS == 0
+	char scratch[12], *end = scratch + sizeof scratch, *cur = end;
+	uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+	*--cur = '\n';
+	do {
+		*--cur = (char)('0' + mag % 10);
+		mag /= 10;
+	} while (mag != 0);
+	if (value < 0)
+		*--cur = '-';
+	memcpy(out_buf + out_used, cur, end - cur);
+	out_used += end - cur;
+#elif OUT_BITS == 32
+	int32_t raw = value;
+	memcpy(out_buf + out_used, &raw, sizeof raw);
+	out_used += sizeof raw;
+#else
+	int64_t raw = value;
+	memcpy(out_buf + out_used, &raw, sizeof raw);
+	out_used += sizeof raw;
+#endif
+}
+
+static inline int add_(int lhs, int rhs) {
+	return (int)((unsigned)lhs + (unsigned)rhs);
+}
+
+static inline int sub_(int lhs, int rhs) {
+	return (int)((unsigned)lhs - (unsigned)rhs);
+}
+
+static inline int mul_(int lhs, int rhs) {
+	return (int)((unsigned)lhs * (unsigned)rhs);
+}
+
+static inline int neg_(int rhs) {
+	return (int)(0u - (unsigned)rhs);
+}
+
+static inline int div_(int lhs, int rhs) { /* rhs != 0 */
+	return lhs == INT_MIN && rhs == -1 ? INT_MIN : lhs / rhs;
+}
+
+static inline int rem_(int lhs, int rhs) {
+	return rhs == -1 ? 0 : lhs % rhs;
+}
+
+static inline int divz_(int lhs, int rhs) {
+	if (rhs == 0)
+		fail_("Division by zero\n");
+	return div_(lhs, rhs);
+}
+
+static inline int remz_(int lhs, int rhs) {
+	if (rhs == 0)
+		fail_("Division by zero\n");
+	return rem_(lhs, rhs);
+}
+)";
+
+	// a condition in parentheses of its own doesn't take another pair, the
+	// values translate_expr makes which start with ( are in one pair
+	static std::string condition(const std::string& value) {
+		return value[0] == '(' ? value.substr(1, value.size() - 2) : value;
+	}
+
+	// expressions nested deeper than this are not translated, as the
+	// optimizer has it; a long chain of operations costs no depth, see
+	// translate_binary
+	static const size_t max_depth = 4096;
+
+	// operations of a chain put into one C expression at most, beyond that
+	// the system compiler takes a long time or runs out of stack itself
+	static const size_t max_run = 64;
+
+	static int format_bits(input::format_t format) {
+		if (format == input::format_t::I32) {
+			return 32;
+		}
+		return format == input::format_t::I64 ? 64 : 0;
+	}
+
+	//--------c_translator--------
+	//
+	//	An expression becomes one C expression as long as the order of its
+	//	operands doesn't matter. When the right operand has side effects or
+	//	may fail, the left one is put into a temporary first, and anything
+	//	an operand has to do before its value is known, like an assignment or
+	//	&& with such a right operand, is written out as statements before the
+	//	statement using it. The system compiler takes the temporaries away.
+	//	Every value is appended to the string of the statement it goes into,
+	//	so a long expression is written in time linear in its length.
+
+	c_translator::c_translator(const parser& prsr, const symbol_table *names)
+	: prsr_(prsr)
+	, tree_(prsr.get_ast())
+	, names_(names)
+	, in_format_(input::format_t::TEXT)
+	, out_format_(output::format_t::TEXT)
+	, os_(nullptr)
+	, indent_(0)
+	, temps_(0)
+	, depth_(0)
+	, too_deep_(false)
+	{}
+
+	void c_translator::set_formats(input::format_t in, output::format_t out) {
+		in_format_ = in;
+		out_format_ = out;
+	}
+
+	int c_translator::translate(std::ostream& os) {
+		if (prsr_.get_err_ctr() > 0) {
+			return -1;
+		}
+		os_ = &os;
+		indent_ = 1;
+		temps_ = 0;
+		depth_ = 0;
+		too_deep_ = false;
+		checked_.assign(tree_.frame_size(), 0);
+		pure_.assign(tree_.size(), -1);
+		find_checked(tree_.root());
+
+		os << "/* translated from paraCL */\n\n";
+		os << "#define IN_BITS " << format_bits(in_format_) << '\n';
+		os << "#define OUT_BITS " << format_bits(out_format_) << "\n\n";
+		os << runtime << "\nint main(void) {\n";
+		for (size_t id = 0; id < tree_.frame_size(); ++id) {
+			line() << "int v" << id << " = 0;";
+			if (names_ != nullptr && id < names_->size()) {
+				os << " /* " << names_->name(id) << " */";
+			}
+			os << '\n';
+			if (checked_[id]) {
+				line() << "unsigned char l" << id << " = 0;\n";
+			}
+		}
+		translate_stmt(tree_.root());
+		line() << "flush_();\n";
+		line() << "return 0;\n";
+		os << "}\n";
+		os_ = nullptr;
+		if (too_deep_) {
+			std::cerr << "Expression nested too deeply to be translated\n";
+			return -1;
+		}
+		return 0;
+	}
+
+	std::ostream& c_translator::line() {
+		for (size_t i = 0; i < indent_; ++i) {
+			*os_ << '\t';
+		}
+		return *os_;
+	}
+
+	// identifiers read with LOADC or DECL by compiler, and the ones whiles
+	// kill, need their flags
+	void c_translator::find_checked(idx_t nd) {
+		const ast::node& node = tree_[nd];
+		switch (node.type_) {
+			case node_t::SCOPE: {
+				const idx_t *it = tree_.list(node.first_);
+				for (idx_t i = 0; i < node.count_; ++i) {
+					find_checked(it[i]);
+				}
+				break;
+			}
+			case node_t::IF:
+				find_checked(node.cond_);
+				find_checked(node.body_);
+				find_checked(node.else_);
+				break;
+			case node_t::WHILE: {
+				const idx_t *tracked = tree_.list(node.tracked_);
+				for (int i = 0; i < node.val_; ++i) {
+					checked_[tracked[i]] = 1;
+				}
+				find_checked(node.cond_);
+				find_checked(node.body_);
+				break;
+			}
+			case node_t::DO:
+				find_checked(node.cond_);
+				find_checked(node.body_);
+				break;
+			case node_t::PRINT: case node_t::UNARY_OPERATION:
+				find_checked(node.rhs_);
+				break;
+			case node_t::BINARY_OPERATION:
+				find_checked(node.lhs_);
+				find_checked(node.rhs_);
+				break;
+			case node_t::IDENTIFIER:
+				if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+					checked_[node.val_] = 1;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	bool c_translator::is_pure(idx_t nd) {
+		if (pure_[nd] >= 0) {
+			return pure_[nd] != 0;
+		}
+		const ast::node& node = tree_[nd];
+		bool pure = true; // literals
+		if (node.type_ == node_t::IDENTIFIER) {
+			pure = tree_.bind(nd) == ast::bind_t::DEFINED;
+		} else if (node.type_ == node_t::SCAN) {
+			pure = false;
+		} else if (node.type_ == node_t::UNARY_OPERATION) {
+			pure = is_pure(node.rhs_);
+		} else if (node.type_ == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			if (op == binOp_t::ASSIGNMENT) {
+				pure = false;
+			} else if (op == binOp_t::DIVISION || op == binOp_t::REMAINDER) {
+				const ast::node& by = tree_[node.rhs_];
+				pure = by.type_ == node_t::INTEGER_LITERAL && by.val_ != 0 && \
+					is_pure(node.lhs_);
+			} else {
+				pure = is_pure(node.lhs_) && is_pure(node.rhs_);
+			}
+		}
+		pure_[nd] = pure;
+		return pure;
+	}
+
+	void c_translator::translate_stmt(idx_t nd) {
+		node_t type = tree_[nd].type_;
+		if (type == node_t::SCOPE) {
+			const idx_t *it = tree_.list(tree_[nd].first_);
+			for (idx_t i = 0, ie = tree_[nd].count_; i < ie; ++i) {
+				translate_stmt(it[i]);
+			}
+		} else if (type == node_t::IF) {
+			std::string cond;
+			translate_expr(tree_[nd].cond_, cond);
+			line() << "if (" << condition(cond) << ") {\n";
+			++indent_;
+			translate_stmt(tree_[nd].body_);
+			--indent_;
+			if (tree_[tree_[nd].else_].type_ != node_t::EMPTY) {
+				line() << "} else {\n";
+				++indent_;
+				translate_stmt(tree_[nd].else_);
+				--indent_;
+			}
+			line() << "}\n";
+		} else if (type == node_t::WHILE) {
+			translate_while(nd);
+		} else if (type == node_t::DO) {
+			translate_do(nd);
+		} else if (type != node_t::EMPTY) {
+			translate_prnt(nd);
+		}
+	}
+
+	// a condition which has to write statements, or to kill the tracked
+	// identifiers after it is checked, is checked inside the loop
+	void c_translator::translate_while(idx_t nd) {
+		const idx_t *tracked = tree_.list(tree_[nd].tracked_);
+		int tracked_cnt = tree_[nd].val_;
+		idx_t cond = tree_[nd].cond_;
+		for (int i = 0; i < tracked_cnt; ++i) {
+			line() << 'l' << tracked[i] << " = 0;\n";
+		}
+		std::string value;
+		if (tracked_cnt == 0 && is_pure(cond)) {
+			translate_expr(cond, value);
+			line() << "while (" << condition(value) << ") {\n";
+			++indent_;
+		} else {
+			line() << "for (;;) {\n";
+			++indent_;
+			translate_expr(cond, value);
+			if (tracked_cnt > 0) {
+				std::string temp;
+				to_temp(value, temp);
+				value.swap(temp);
+			}
+			for (int i = 0; i < tracked_cnt; ++i) {
+				line() << 'l' << tracked[i] << " = 0;\n";
+			}
+			line() << "if (!" << value << ")\n";
+			line() << "\tbreak;\n";
+		}
+		translate_stmt(tree_[nd].body_);
+		--indent_;
+		line() << "}\n";
+	}
+
+	void c_translator::translate_do(idx_t nd) {
+		idx_t cond = tree_[nd].cond_;
+		bool pure = is_pure(cond);
+		line() << (pure ? "do {\n" : "for (;;) {\n");
+		++indent_;
+		translate_stmt(tree_[nd].body_);
+		std::string value;
+		translate_expr(cond, value);
+		if (!pure) {
+			line() << "if (!" << value << ")\n";
+			line() << "\tbreak;\n";
+		}
+		--indent_;
+		if (pure) {
+			line() << "} while (" << condition(value) << ");\n";
+		} else {
+			line() << "}\n";
+		}
+	}
+
+	void c_translator::translate_prnt(idx_t nd) {
+		std::string value;
+		if (tree_[nd].type_ == node_t::PRINT) {
+			translate_right(tree_[nd].rhs_, value);
+			line() << "print_(" << value << ");\n";
+		} else if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			translate_lval(nd);
+		} else if (tree_.is_assignment(nd)) {
+			translate_lval(tree_[nd].lhs_);
+			translate_expr(tree_[nd].rhs_, value);
+			line() << 'v' << tree_[tree_[nd].lhs_].val_ << " = " << value << ";\n";
+		} else if (!is_pure(nd)) {
+			translate_expr(nd, value);
+			line() << "(void)" << value << ";\n";
+		}
+	}
+
+	void c_translator::translate_right(idx_t nd, std::string& dst) {
+		if (tree_[nd].type_ == node_t::IDENTIFIER) {
+			translate_lval(nd);
+			dst += 'v' + std::to_string(tree_[nd].val_);
+		} else if (tree_.is_assignment(nd)) {
+			std::string value;
+			std::string var = 'v' + std::to_string(tree_[tree_[nd].lhs_].val_);
+			translate_lval(tree_[nd].lhs_);
+			translate_expr(tree_[nd].rhs_, value);
+			line() << var << " = " << value << ";\n";
+			dst += var;
+		} else {
+			translate_expr(nd, dst);
+		}
+	}
+
+	void c_translator::translate_lval(idx_t nd) {
+		int id = tree_[nd].val_;
+		if (tree_.bind(nd) == ast::bind_t::UNDEFINED) {
+			line() << 'v' << id << " = 0;";
+			if (checked_[id]) {
+				*os_ << " l" << id << " = 1;";
+			}
+			*os_ << '\n';
+		} else if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+			line() << "if (!l" << id << ") {\n";
+			line() << "\tv" << id << " = 0;\n";
+			line() << "\tl" << id << " = 1;\n";
+			line() << "}\n";
+		}
+	}
+
+	// the value is appended to dst as a primary expression, a call or one in
+	// parentheses, so ! can be put before it
+	void c_translator::translate_expr(idx_t nd, std::string& dst) {
+		const ast::node& node = tree_[nd];
+		if (
+			(node.type_ == node_t::UNARY_OPERATION || node.type_ == node_t::BINARY_OPERATION) && \
+			depth_ == max_depth
+		) {
+			too_deep_ = true;
+			dst += '0';
+		} else if (node.type_ == node_t::UNARY_OPERATION) {
+			bool is_not = tree_.unop(nd) == unOp_t::LOGICAL_NEGATION;
+			dst += is_not ? "!" : "neg_(";
+			++depth_;
+			translate_expr(node.rhs_, dst);
+			--depth_;
+			if (!is_not) {
+				dst += ')';
+			}
+		} else if (node.type_ == node_t::BINARY_OPERATION) {
+			binOp_t op = tree_.binop(nd);
+			++depth_;
+			if (op == binOp_t::OR || op == binOp_t::AND) {
+				translate_logical(nd, dst);
+			} else if (op == binOp_t::ASSIGNMENT) { // to a temporary, see optimizer
+				translate_right(nd, dst);
+			} else {
+				translate_binary(nd, dst);
+			}
+			--depth_;
+		} else if (node.type_ == node_t::IDENTIFIER) {
+			std::string var = 'v' + std::to_string(node.val_);
+			if (tree_.bind(nd) == ast::bind_t::DEFINED) {
+				dst += var;
+			} else if (tree_.bind(nd) == ast::bind_t::UNKNOWN) {
+				dst += "(l" + std::to_string(node.val_) + " ? " + var + " : undef_())";
+			} else {
+				dst += "undef_()";
+			}
+		} else if (node.type_ == node_t::INTEGER_LITERAL) {
+			dst += node.val_ == INT_MIN ? "INT_MIN" : std::to_string(node.val_);
+		} else if (node.type_ == node_t::SCAN) {
+			dst += "scan_()";
+		} else { // BOOL_TRUE or BOOL_FALSE
+			dst += node.type_ == node_t::BOOL_TRUE ? '1' : '0';
+		}
+	}
+
+	// a right operand which has to write statements does it only when it is
+	// evaluated
+	void c_translator::translate_logical(idx_t nd, std::string& dst) {
+		bool is_and = tree_.binop(nd) == binOp_t::AND;
+		idx_t rhs = tree_[nd].rhs_;
+		if (is_pure(rhs)) {
+			dst += '(';
+			translate_expr(tree_[nd].lhs_, dst);
+			dst += is_and ? " && " : " || ";
+			translate_expr(rhs, dst);
+			dst += ')';
+			return;
+		}
+		std::string lhs;
+		translate_expr(tree_[nd].lhs_, lhs);
+		std::string temp = 't' + std::to_string(temps_++);
+		line() << "int " << temp << " = " << lhs << " != 0;\n";
+		line() << "if (" << (is_and ? "" : "!") << temp << ") {\n";
+		++indent_;
+		std::string value;
+		translate_expr(rhs, value);
+		line() << temp << " = " << value << " != 0;\n";
+		--indent_;
+		line() << "}\n";
+		dst += temp;
+	}
+
+	// a chain of operations on the left of each other, as a long sum, is
+	// done from its innermost operation out without going deeper: all the
+	// calls or parentheses of a run of them which doesn't spill are opened
+	// at once, then the value on the left and the right operands go in, and
+	// a run longer than max_run is put into a temporary as well
+	void c_translator::translate_binary(idx_t nd, std::string& dst) {
+		static const char *compares[] = {" == ", " != ", " < ", " <= ", " >= ", " > "};
+		std::vector<idx_t> chain; // from nd in
+		for (idx_t cur = nd; is_chained(cur); cur = tree_[cur].lhs_) {
+			chain.push_back(cur);
+		}
+		idx_t first = tree_[chain.back()].lhs_;
+		std::string part, temp; // the run before this one is in temp
+		if (spills(chain.back())) {
+			translate_expr(first, part);
+			to_temp(part, temp);
+			part.clear();
+		}
+		for (size_t end = chain.size(); end > 0;) {
+			size_t begin = end - 1;
+			while (begin > 0 && end - begin < max_run && !spills(chain[begin - 1])) {
+				--begin;
+			}
+			std::string& out = begin == 0 ? dst : part;
+			for (size_t i = begin; i < end; ++i) {
+				binOp_t op = tree_.binop(chain[i]);
+				bool safe = tree_[tree_[chain[i]].rhs_].type_ == node_t::INTEGER_LITERAL && \
+					tree_[tree_[chain[i]].rhs_].val_ != 0;
+				switch (op) {
+					case binOp_t::ADDITION: out += "add_("; break;
+					case binOp_t::SUBSTRACTION: out += "sub_("; break;
+					case binOp_t::MULTIPLICATION: out += "mul_("; break;
+					case binOp_t::DIVISION: out += safe ? "div_(" : "divz_("; break;
+					case binOp_t::REMAINDER: out += safe ? "rem_(" : "remz_("; break;
+					default: out += '('; break; // comparisons
+				}
+			}
+			if (temp.empty()) {
+				translate_expr(first, out);
+			} else {
+				out += temp;
+			}
+			for (size_t i = end; i-- > begin;) {
+				binOp_t op = tree_.binop(chain[i]);
+				if (op >= binOp_t::EQUAL && op <= binOp_t::GREATER) {
+					out += compares[static_cast<size_t>(op) - static_cast<size_t>(binOp_t::EQUAL)];
+				} else {
+					out += ", ";
+				}
+				translate_expr(tree_[chain[i]].rhs_, out);
+				out += ')';
+			}
+			if (begin > 0) {
+				temp.clear();
+				to_temp(part, temp);
+				part.clear();
+			}
+			end = begin;
+		}
+	}
+
+	bool c_translator::is_chained(idx_t nd) const {
+		if (tree_[nd].type_ != node_t::BINARY_OPERATION) {
+			return false;
+		}
+		binOp_t op = tree_.binop(nd);
+		return op != binOp_t::OR && op != binOp_t::AND && op != binOp_t::ASSIGNMENT;
+	}
+
+	// a right operand with side effects, or which may fail, has the left one
+	// evaluated before it unless that is a constant
+	bool c_translator::spills(idx_t nd) {
+		node_t lhs_type = tree_[tree_[nd].lhs_].type_;
+		return !is_pure(tree_[nd].rhs_) && lhs_type != node_t::INTEGER_LITERAL && \
+			lhs_type != node_t::BOOL_TRUE && lhs_type != node_t::BOOL_FALSE;
+	}
+
+	void c_translator::to_temp(const std::string& value, std::string& dst) {
+		std::string temp = 't' + std::to_string(temps_++);
+		line() << "int " << temp << " = " << value << ";\n";
+		dst += temp;
+	}
+
+	//--------build_c--------
+
+	static bool write_all(int fd, const std::string& data) {
+		const char *pos = data.data();
+		size_t left = data.size();
+		while (left > 0) {
+			ssize_t put = write(fd, pos, left);
+			if (put < 0 && errno == EINTR) {
+				continue;
+			}
+			if (put <= 0) {
+				return false;
+			}
+			pos += put;
+			left -= put;
+		}
+		return true;
+	}
+
+	// the source goes through a temporary file in $TMPDIR, -x c tells its
+	// language; $CC is split into words by the shell, as make does, so it
+	// can be a command with arguments like ccache gcc
+	int build_c(const std::string& source, const char *exe) {
+		const char *dir = getenv("TMPDIR");
+		std::string name = dir != nullptr && *dir != '\0' ? dir : "/tmp";
+		name += "/paraclXXXXXX";
+		std::vector<char> path(name.begin(), name.end());
+		path.push_back('\0');
+		int fd = mkstemp(path.data());
+		if (fd < 0) {
+			return -1;
+		}
+		bool written = write_all(fd, source);
+		close(fd);
+		pid_t pid = written ? fork() : -1;
+		if (pid == 0) {
+			execl(
+				"/bin/sh", "sh", "-c", "exec ${CC:-cc} -O2 -x c \"$1\" -o \"$2\"",
+				"sh", path.data(), exe, static_cast<char *>(nullptr)
+			);
+			_exit(127);
+		}
+		int status = -1;
+		while (pid > 0 && waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+		unlink(path.data());
+		return pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+	}
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "io.h"
+#include "parser.h"
+#include "symbols.h"
+#include "types_decl.h"
+
+namespace cplr {
+
+	// translates the tree built by parser into one C translation unit with a
+	// small runtime doing ? and print as input and output do, so the system
+	// compiler makes a standalone executable of the program: identifiers are
+	// locals of main, and the ones checked at run time have a flag next to
+	// them, operands are evaluated left to right as parser::run does
+	class c_translator final {
+	public:
+		c_translator(const parser& prsr, const symbol_table *names = nullptr);
+		void set_formats(input::format_t in, output::format_t out);
+		int translate(std::ostream& os); // -1 if the program has errors
+
+	private:
+		using idx_t = ast::idx_t;
+
+		std::ostream& line(); // a new line of the current indent
+		void find_checked(idx_t nd);
+		bool is_pure(idx_t nd); // no side effects, can't fail
+
+		void translate_stmt(idx_t nd);
+		void translate_while(idx_t nd);
+		void translate_do(idx_t nd);
+		void translate_prnt(idx_t nd);
+		void translate_right(idx_t nd, std::string& dst);
+		void translate_lval(idx_t nd);
+		void translate_expr(idx_t nd, std::string& dst);
+		void translate_logical(idx_t nd, std::string& dst);
+		void translate_binary(idx_t nd, std::string& dst);
+		bool is_chained(idx_t nd) const; // translated by translate_binary
+		bool spills(idx_t nd); // the left operand is put into a temporary
+		void to_temp(const std::string& value, std::string& dst);
+
+		const parser& prsr_;
+		const ast& tree_;
+		const symbol_table *names_;
+		input::format_t in_format_;
+		output::format_t out_format_;
+		std::ostream *os_;
+		size_t indent_;
+		size_t temps_;
+		size_t depth_; // of expressions translated, see max_depth
+		bool too_deep_;
+		std::vector<unsigned char> checked_; // by id, its flag is read
+		std::vector<signed char> pure_; // by node, -1 is not known yet
+	};
+
+	// builds the executable exe of a translation with the compiler named by
+	// $CC, cc by default, at -O2; 0 on success
+	int build_c(const std::string& source, const char *exe);
+
+}
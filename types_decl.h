@@ -1,6 +1,6 @@
 #pragma once
 
-enum class node_t {
+enum class node_t : unsigned char {
 	EMPTY,
 	SCOPE,
 	UNKNOWN,
@@ -23,12 +23,12 @@ enum class node_t {
 	BOOL_FALSE // false
 };
 
-enum class unOp_t {
+enum class unOp_t : unsigned char {
 	LOGICAL_NEGATION, // !
 	NEGATION // -
 };
 
-enum class binOp_t {
+enum class binOp_t : unsigned char {
 	ASSIGNMENT, // =
 	OR, // ||
 	AND, // &&
@@ -41,5 +41,6 @@ enum class binOp_t {
 	ADDITION, // +
 	SUBSTRACTION, // -
 	MULTIPLICATION, // *
-	DIVISION // /
+	DIVISION, // /
+	REMAINDER // made by optimizer only, x - c * (x / c)
 };
@@ -0,0 +1,251 @@
+#include "vm.h"
+
+#include <iostream>
+
+#include "arith.h"
+
+namespace cplr {
+
+	vm::vm(input& in, output& out)
+	: in_(in)
+	, out_(out)
+	{}
+
+	int vm::run(const bytecode& bc) {
+		vars_.clear();
+		live_.clear();
+		return resume(bc);
+	}
+
+	int vm::run_on(
+		const bytecode& bc, std::vector<int>& vars, std::vector<unsigned char>& live
+	) {
+		vars_.swap(vars);
+		live_.swap(live);
+		int result = resume(bc);
+		vars_.swap(vars);
+		live_.swap(live);
+		return result;
+	}
+
+	int vm::resume(const bytecode& bc) {
+		stack_.assign(bc.stack_size_ + 1, 0);
+		if (vars_.size() < bc.id_count_) {
+			vars_.resize(bc.id_count_, 0);
+			live_.resize(bc.id_count_, 0);
+		}
+		errors.clear();
+
+		const instr *code = bc.code_.data();
+		const instr *pc = code;
+		int *sp = stack_.data(); // points past the top of the stack
+		int *vars = vars_.data();
+		unsigned char *live = live_.data();
+		const divisor *divisors = bc.divisors_.data();
+
+		while (1) {
+			switch (pc->op) {
+				case opcode::HALT:
+					return 0;
+				case opcode::PUSH:
+					*sp++ = pc->arg;
+					break;
+				case opcode::POP:
+					--sp;
+					break;
+				case opcode::DUP:
+					*sp = sp[-1];
+					++sp;
+					break;
+				case opcode::LOAD:
+					*sp++ = vars[pc->arg];
+					break;
+				case opcode::LOADC:
+					if (!live[pc->arg]) {
+						errors += "Undefined identifier\n";
+						out_.flush();
+						std::cerr << errors;
+						return -2;
+					}
+					*sp++ = vars[pc->arg];
+					break;
+				case opcode::STORE:
+					vars[pc->arg] = *--sp;
+					break;
+				case opcode::DEFINE:
+					vars[pc->arg] = 0;
+					live[pc->arg] = 1;
+					break;
+				case opcode::DECL:
+					if (!live[pc->arg]) {
+						vars[pc->arg] = 0;
+						live[pc->arg] = 1;
+					}
+					break;
+				case opcode::KILL:
+					live[pc->arg] = 0;
+					break;
+				case opcode::UNDEF:
+					errors += "Undefined identifier\n";
+					out_.flush();
+					std::cerr << errors;
+					return -2;
+				case opcode::SCAN:
+					*sp++ = in_.read_int();
+					break;
+				case opcode::PRINT:
+					out_.write_int(*--sp);
+					break;
+				case opcode::NOT:
+					sp[-1] = !sp[-1];
+					break;
+				case opcode::NEG:
+					sp[-1] = wrap_neg(sp[-1]);
+					break;
+				case opcode::EQ:
+					--sp;
+					sp[-1] = sp[-1] == *sp;
+					break;
+				case opcode::NE:
+					--sp;
+					sp[-1] = sp[-1] != *sp;
+					break;
+				case opcode::LT:
+					--sp;
+					sp[-1] = sp[-1] < *sp;
+					break;
+				case opcode::LE:
+					--sp;
+					sp[-1] = sp[-1] <= *sp;
+					break;
+				case opcode::GE:
+					--sp;
+					sp[-1] = sp[-1] >= *sp;
+					break;
+				case opcode::GT:
+					--sp;
+					sp[-1] = sp[-1] > *sp;
+					break;
+				case opcode::ADD:
+					--sp;
+					sp[-1] = wrap_add(sp[-1], *sp);
+					break;
+				case opcode::SUB:
+					--sp;
+					sp[-1] = wrap_sub(sp[-1], *sp);
+					break;
+				case opcode::MUL:
+					--sp;
+					sp[-1] = wrap_mul(sp[-1], *sp);
+					break;
+				case opcode::DIV:
+					--sp;
+					if (*sp == 0) {
+						errors += "Division by zero\n";
+						out_.flush();
+						std::cerr << errors;
+						return -2;
+					}
+					sp[-1] = wrap_div(sp[-1], *sp);
+					break;
+				case opcode::REM:
+					--sp;
+					if (*sp == 0) {
+						errors += "Division by zero\n";
+						out_.flush();
+						std::cerr << errors;
+						return -2;
+					}
+					sp[-1] = wrap_rem(sp[-1], *sp);
+					break;
+				case opcode::DIVN:
+					--sp;
+					sp[-1] = sp[-1] / *sp;
+					break;
+				case opcode::REMN:
+					--sp;
+					sp[-1] = sp[-1] % *sp;
+					break;
+				case opcode::AND:
+					--sp;
+					sp[-1] &= *sp;
+					break;
+				case opcode::OR:
+					--sp;
+					sp[-1] |= *sp;
+					break;
+				case opcode::MULK:
+					sp[-1] = wrap_mul(sp[-1], pc->arg);
+					break;
+				case opcode::SHLK:
+					sp[-1] = static_cast<int>(static_cast<unsigned>(sp[-1]) << pc->arg);
+					break;
+				case opcode::DIVK:
+					sp[-1] = div_by(divisors[pc->arg], sp[-1]);
+					break;
+				case opcode::REMK:
+					sp[-1] = rem_by(divisors[pc->arg], sp[-1]);
+					break;
+				case opcode::JMP:
+					pc = code + pc->arg;
+					continue;
+				case opcode::JZ:
+					if (*--sp == 0) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JNZ:
+					if (*--sp != 0) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JEQ:
+					sp -= 2;
+					if (sp[0] == sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JNE:
+					sp -= 2;
+					if (sp[0] != sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JLT:
+					sp -= 2;
+					if (sp[0] < sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JLE:
+					sp -= 2;
+					if (sp[0] <= sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JGE:
+					sp -= 2;
+					if (sp[0] >= sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+				case opcode::JGT:
+					sp -= 2;
+					if (sp[0] > sp[1]) {
+						pc = code + pc->arg;
+						continue;
+					}
+					break;
+			}
+			++pc;
+		}
+	}
+
+}
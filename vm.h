@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "compiler.h"
+#include "io.h"
+
+namespace cplr {
+
+	class vm final { // stack machine executing bytecode built by compiler
+	public:
+		vm(input& in, output& out); // read by SCAN and written by PRINT
+		int run(const bytecode& bc);
+		int resume(const bytecode& bc); // identifiers keep their values
+		// on the identifiers of another engine, which get them back after
+		int run_on(
+			const bytecode& bc, std::vector<int>& vars, std::vector<unsigned char>& live
+		);
+
+	private:
+		input& in_;
+		output& out_;
+		std::vector<int> stack_;
+		std::vector<int> vars_; // the frame, indexed by id
+		std::vector<unsigned char> live_; // read only by LOADC and DECL
+		std::string errors;
+	};
+
+}
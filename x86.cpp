@@ -0,0 +1,138 @@
+#include "x86.h"
+
+#include <cstring>
+
+namespace cplr {
+
+	namespace x86 {
+
+		void assembler::clear() {
+			code_.clear();
+		}
+
+		size_t assembler::size() const {
+			return code_.size();
+		}
+
+		const std::vector<unsigned char>& assembler::code() const {
+			return code_;
+		}
+
+		void assembler::byte(unsigned char b) {
+			code_.push_back(b);
+		}
+
+		void assembler::imm32(int32_t val) {
+			for (int i = 0; i < 4; ++i) {
+				byte(static_cast<unsigned char>(static_cast<uint32_t>(val) >> (8 * i)));
+			}
+		}
+
+		void assembler::rex(bool w, int reg, const operand& rm) {
+			unsigned char prefix = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0);
+			if (rm.reg & 8) {
+				prefix |= 1;
+			}
+			if (prefix != 0x40) {
+				byte(prefix);
+			}
+		}
+
+		void assembler::op_rm(unsigned char op, int reg, const operand& rm, bool w) {
+			rex(w, reg, rm);
+			byte(op);
+			modrm(reg, rm);
+		}
+
+		void assembler::op_rm2(unsigned char op, int reg, const operand& rm) {
+			rex(false, reg, rm);
+			byte(0x0F);
+			byte(op);
+			modrm(reg, rm);
+		}
+
+		// reg is a register or the digit extending the opcode; memory always
+		// takes a displacement, so rbp and r13 need no special case either
+		void assembler::modrm(int reg, const operand& rm) {
+			unsigned char r = static_cast<unsigned char>((reg & 7) << 3);
+			unsigned char base = static_cast<unsigned char>(rm.reg & 7);
+			if (!rm.mem) {
+				byte(0xC0 | r | base);
+			} else if (rm.disp >= -128 && rm.disp <= 127) {
+				byte(0x40 | r | base);
+				byte(static_cast<unsigned char>(rm.disp));
+			} else {
+				byte(0x80 | r | base);
+				imm32(rm.disp);
+			}
+		}
+
+		void assembler::mov(const operand& dst, const operand& src) {
+			if (dst.mem && src.mem) {
+				op_rm(0x8B, RAX, src);
+				op_rm(0x89, RAX, dst);
+			} else if (!dst.mem) {
+				if (src.mem || src.reg != dst.reg) {
+					op_rm(0x8B, dst.reg, src);
+				}
+			} else {
+				op_rm(0x89, src.reg, dst);
+			}
+		}
+
+		void assembler::mov_imm(const operand& dst, int32_t val) {
+			if (dst.mem) {
+				op_rm(0xC7, 0, dst);
+			} else {
+				rex(false, 0, dst);
+				byte(static_cast<unsigned char>(0xB8 + (dst.reg & 7)));
+			}
+			imm32(val);
+		}
+
+		void assembler::push_reg(int reg, bool pop) {
+			if (reg & 8) {
+				byte(0x41);
+			}
+			byte(static_cast<unsigned char>((pop ? 0x58 : 0x50) + (reg & 7)));
+		}
+
+		// setcc al, then movzx dst, al
+		void assembler::set_cc(int cc, int dst) {
+			byte(0x0F);
+			byte(static_cast<unsigned char>(0x90 + cc));
+			byte(0xC0);
+			op_rm2(0xB6, dst, {false, RAX, 0});
+		}
+
+		size_t assembler::jump(int cc) {
+			if (cc == ALWAYS) {
+				byte(0xE9);
+			} else {
+				byte(0x0F);
+				byte(static_cast<unsigned char>(0x80 + cc));
+			}
+			size_t at = code_.size();
+			imm32(0);
+			return at;
+		}
+
+		size_t assembler::call() {
+			byte(0xE8);
+			size_t at = code_.size();
+			imm32(0);
+			return at;
+		}
+
+		void assembler::bind(size_t at) {
+			patch(at, code_.size());
+		}
+
+		void assembler::patch(size_t at, size_t target) {
+			int32_t rel = static_cast<int32_t>(target - (at + 4));
+			std::memcpy(&code_[at], &rel, 4);
+		}
+
+	}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cplr {
+
+	namespace x86 {
+
+		enum reg_t : int {
+			RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+			R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+		};
+
+		enum cc_t : int { // conditions of jcc and setcc
+			ALWAYS = -1, B = 0x2, AE = 0x3, E = 0x4, NE = 0x5, BE = 0x6, A = 0x7,
+			S = 0x8, NS = 0x9, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF
+		};
+
+		struct operand { // a register or [reg + disp]
+			bool mem;
+			int reg;
+			int32_t disp;
+		};
+
+		// encodes x86-64 instructions into a buffer, for jit and elf_image;
+		// memory is based on a register other than rsp and r12, which would
+		// need a SIB byte
+		class assembler final {
+		public:
+			void clear();
+			size_t size() const;
+			const std::vector<unsigned char>& code() const;
+
+			void byte(unsigned char b);
+			void imm32(int32_t val);
+			void op_rm(unsigned char op, int reg, const operand& rm, bool w = false);
+			void op_rm2(unsigned char op, int reg, const operand& rm); // 0F op
+			void mov(const operand& dst, const operand& src);
+			void mov_imm(const operand& dst, int32_t val);
+			void push_reg(int reg, bool pop);
+			void set_cc(int cc, int dst);
+			size_t jump(int cc); // -1 is always, returns where to patch
+			size_t call(); // rel32, returns where to patch
+			void bind(size_t at); // the jump or call at lands here
+			void patch(size_t at, size_t target); // or at target
+
+		private:
+			void rex(bool w, int reg, const operand& rm);
+			void modrm(int reg, const operand& rm);
+
+			std::vector<unsigned char> code_;
+		};
+
+	}
+
+}